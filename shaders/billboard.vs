@@ -2,11 +2,12 @@
 
 layout (location = 0) in vec3 vPosition;
 
+// per-sprite (instanced) attributes
+layout (location = 1) in vec3 vOffset;
+layout (location = 2) in vec4 vColor;
+layout (location = 3) in vec2 vSizeRot;
+
 uniform vec3 CameraPos;
-uniform float Size;
-uniform float Rot;
-uniform vec3 Offset;
-uniform vec4 Color;
 uniform mat4 MVP;
 
 out vec4 color;
@@ -14,10 +15,13 @@ out vec2 uv;
 
 void main()
 {
-  color = Color;
+  color = vColor;
   uv = vPosition.xy;
 
-  vec3 z = normalize(CameraPos - Offset);
+  float Size = vSizeRot.x;
+  float Rot = vSizeRot.y;
+
+  vec3 z = normalize(CameraPos - vOffset);
   vec3 x = normalize(cross(vec3(0,1,0), z));
   vec3 y = normalize(cross(z, x));
   mat3 R = mat3(x, y, z);
@@ -27,6 +31,6 @@ void main()
   z = vec3(0,0,1);
   mat3 M = mat3(x, y, z);
 
-  vec3 eyePos = M * R * Size * (vPosition - vec3(0.5, 0.5, 0.0)) + Offset;
+  vec3 eyePos = M * R * Size * (vPosition - vec3(0.5, 0.5, 0.0)) + vOffset;
   gl_Position = MVP * vec4(eyePos, 1.0); 
 }
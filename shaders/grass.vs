@@ -0,0 +1,56 @@
+#version 400
+
+// Instanced grass blades (see GrassField), used with spotlight.fs
+layout (location = 0) in vec2 vCorner;     // x across, y up the blade
+layout (location = 1) in vec4 vPosRank;    // base position, random rank
+layout (location = 2) in vec4 vUVRect;     // offset and size in the atlas
+layout (location = 3) in vec4 vSizePhase;  // width, height, wind phase
+
+uniform mat3 NormalMatrix;
+uniform mat4 ModelViewMatrix;
+uniform mat4 MVP;
+uniform vec3 CameraPos;
+
+uniform float Time;
+uniform vec2 WindDir;
+uniform float WindStrength;
+
+// blades are thinned out between these distances from the camera
+uniform float DensityNear;
+uniform float DensityFar;
+
+out vec3 n_eye;
+out vec4 p_eye;
+
+out vec2 uv;
+
+void main()
+{
+  vec3 base= vPosRank.xyz;
+  vec3 toCamera= CameraPos - base;
+  toCamera.y= 0.0;
+  float dist= length(toCamera);
+
+  // blades with a rank above the density shrink to nothing
+  float density= 1.0 - smoothstep(DensityNear, DensityFar, dist);
+  float grow= clamp((density - vPosRank.w) * 8.0, 0.0, 1.0);
+  vec2 size= vSizePhase.xy * grow;
+
+  // turn around the y axis to face the camera
+  vec3 z= dist > 1e-4 ? toCamera / dist : vec3(0, 0, 1);
+  vec3 x= vec3(z.z, 0.0, -z.x);
+
+  // only the top of the blade moves with the wind
+  float sway= sin(Time * 2.0 + vSizePhase.z + dot(base.xz, WindDir) * 0.5);
+  float bend= vCorner.y * vCorner.y * sway * WindStrength * size.y;
+
+  vec3 pos= base + x * vCorner.x * size.x + vec3(0, vCorner.y * size.y, 0) +
+    vec3(WindDir.x, 0, WindDir.y) * bend;
+
+  n_eye= normalize(NormalMatrix * z);
+  p_eye= ModelViewMatrix * vec4(pos, 1.0);
+
+  uv= vUVRect.xy + vec2(vCorner.x + 0.5, vCorner.y) * vUVRect.zw;
+
+  gl_Position = MVP * vec4(pos, 1.0);
+}
@@ -0,0 +1,40 @@
+#version 430
+
+// Static mesh variant of spotlight.vs for Renderer::staticMesh
+// Draws are submitted with glMultiDrawElementsIndirect; each draw selects its
+// transforms from StaticDraws with the instanced DrawId attribute
+layout (location = 0) in vec3 vPos;
+layout (location = 1) in vec3 vNormals;
+layout (location = 2) in vec2 vTextureCoords;
+layout (location = 5) in uint DrawId;
+
+struct StaticDraw {
+  mat4 model;
+  mat4 normal;  // normal matrix (view * model), padded to a mat4
+};
+
+layout (std430, binding = 0) buffer StaticDraws {
+  StaticDraw draws[];
+};
+
+uniform mat4 ModelViewMatrix;  // camera transform only
+uniform mat4 MVP;              // camera transform only
+
+out vec3 n_eye;
+out vec4 p_eye;
+
+out vec2 uv;
+
+void main()
+{
+  StaticDraw draw= draws[DrawId];
+  vec4 pos= draw.model * vec4(vPos, 1.0);
+
+  // get the normal and vertex position to eye coordinates
+  n_eye= normalize(mat3(draw.normal) * vNormals);
+  p_eye= ModelViewMatrix * pos;
+
+  uv= vTextureCoords;
+
+  gl_Position = MVP * pos;
+}
@@ -29,6 +29,7 @@ uniform MaterialInfo Material;
 uniform sampler2D diffuseTexture;
 uniform bool HasUV;
 uniform bool useAlpha;
+uniform float AlphaCutoff; // alpha tested items (e.g. grass), 0 disables it
 in vec2 uv;
 
 // stuff for shader toy
@@ -211,6 +212,9 @@ void main()
 	vec4 phongColor= phongSpot();
 
 	float alpha= phongColor.w;
+	if (alpha < AlphaCutoff) {
+		discard;
+	}
 
 	vec3 color= phongColor.xyz;
 
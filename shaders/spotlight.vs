@@ -9,6 +9,15 @@ uniform mat3 NormalMatrix;
 uniform mat4 ModelViewMatrix;
 uniform mat4 MVP;
 
+// cylindrical billboards (see Renderer::billboard)
+// In billboard mode, ModelMatrix is the local transform of the item and
+// MVP, ModelViewMatrix and NormalMatrix only contain the camera transform
+uniform bool Billboard;
+uniform mat4 ModelMatrix;
+uniform vec3 BillboardPivot;
+uniform vec3 BillboardAxis;
+uniform vec3 CameraPos;
+
 out vec3 n_eye;
 out vec4 p_eye;
 
@@ -16,12 +25,28 @@ out vec2 uv;
 
 void main()
 {
+  vec4 pos= vec4(vPos, 1.0);
+  vec3 normal= vNormals;
+
+  if (Billboard) {
+    // rotate around the axis so that local +z faces the camera
+    vec3 y= normalize(BillboardAxis);
+    vec3 toCamera= CameraPos - BillboardPivot;
+    vec3 z= toCamera - dot(toCamera, y) * y;
+    z= dot(z, z) > 1e-8 ? normalize(z) : normalize(cross(vec3(1, 0, 0), y));
+    vec3 x= cross(y, z);
+    mat3 R= mat3(x, y, z);
+
+    pos= vec4(BillboardPivot + R * vec3(ModelMatrix * pos), 1.0);
+    normal= R * transpose(inverse(mat3(ModelMatrix))) * normal;
+  }
+
   // get the normal and vertex position to eye coordinates
-  n_eye= normalize(NormalMatrix * vNormals);
-  p_eye= ModelViewMatrix * vec4(vPos, 1.0);
+  n_eye= normalize(NormalMatrix * normal);
+  p_eye= ModelViewMatrix * pos;
 
   uv= vTextureCoords;
 
-  gl_Position = MVP * vec4(vPos, 1.0);
+  gl_Position = MVP * pos;
 }
 
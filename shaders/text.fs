@@ -3,11 +3,16 @@
 in vec4 color;
 in vec2 uv;
 
+// signed distance field, 0.5 on the glyph edge and larger inside
 uniform sampler2D fontTexture;
 out vec4 FragColor;
 
 void main()
 {
-  vec4 c = color * texture(fontTexture, uv);
-  FragColor = c; //vec4(1,0,0,1);
+  float d = texture(fontTexture, uv).r;
+
+  // blend over about one screen pixel, whatever the text size
+  float w = max(fwidth(d), 1e-4);
+  float alpha = smoothstep(0.5 - w, 0.5 + w, d);
+  FragColor = vec4(color.rgb, color.a * alpha);
 }
@@ -0,0 +1,117 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+#include "agl/asset_loader.h"
+#include <algorithm>
+#include <cassert>
+
+namespace agl {
+
+AssetLoader::AssetLoader(int numThreads) {
+  if (numThreads <= 0) {
+    numThreads = std::max(1, static_cast<int>(
+        std::thread::hardware_concurrency()));
+  }
+  for (int i = 0; i < numThreads; i++) {
+    _workers.push_back(std::thread(&AssetLoader::workerLoop, this));
+  }
+}
+
+AssetLoader::~AssetLoader() {
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _stop = true;
+  }
+  _readyCv.notify_all();
+  for (std::thread& worker : _workers) {
+    worker.join();
+  }
+}
+
+int AssetLoader::add(const Task& work, const Task& upload,
+    const std::vector<int>& deps) {
+  std::lock_guard<std::mutex> guard(_mutex);
+  int id = static_cast<int>(_jobs.size());
+  _jobs.push_back(Job());
+  Job& job = _jobs.back();
+  job.work = work;
+  job.upload = upload;
+  _numOpen++;
+
+  for (int dep : deps) {
+    assert(dep >= 0 && dep < id);
+    if (!_jobs[dep].done) {
+      _jobs[dep].dependents.push_back(id);
+      job.numDeps++;
+    }
+  }
+
+  if (job.numDeps == 0) {
+    _ready.push_back(id);
+    _readyCv.notify_one();
+  }
+  return id;
+}
+
+void AssetLoader::workerLoop() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    _readyCv.wait(lock, [this]() { return _stop || !_ready.empty(); });
+    if (_ready.empty()) return;  // stopping
+
+    int id = _ready.front();
+    _ready.pop_front();
+    Task work = _jobs[id].work;
+
+    lock.unlock();
+    if (work) work();
+    lock.lock();
+
+    _finished.push_back(id);
+    _finishedCv.notify_one();
+  }
+}
+
+void AssetLoader::complete(int id, std::unique_lock<std::mutex>* lock) {
+  Task upload = _jobs[id].upload;
+  if (upload) {
+    lock->unlock();
+    upload();
+    lock->lock();
+  }
+
+  Job& job = _jobs[id];
+  job.done = true;
+  _numOpen--;
+  for (int dependent : job.dependents) {
+    if (--_jobs[dependent].numDeps == 0) {
+      _ready.push_back(dependent);
+      _readyCv.notify_one();
+    }
+  }
+
+  // free captured data (e.g. decoded images) as soon as possible
+  job.work = Task();
+  job.upload = Task();
+}
+
+bool AssetLoader::poll() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_finished.empty()) {
+    int id = _finished.front();
+    _finished.pop_front();
+    complete(id, &lock);
+  }
+  return _numOpen == 0;
+}
+
+void AssetLoader::wait() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_numOpen > 0) {
+    _finishedCv.wait(lock, [this]() { return !_finished.empty(); });
+    int id = _finished.front();
+    _finished.pop_front();
+    complete(id, &lock);
+  }
+}
+
+}  // namespace agl
@@ -0,0 +1,107 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+
+#ifndef AGL_ASSET_LOADER_H_
+#define AGL_ASSET_LOADER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agl {
+
+/**
+ * @brief Loads assets on a pool of worker threads
+ *
+ * Each job has two parts. The work (e.g. decoding an image or parsing a
+ * mesh) runs on a worker thread as soon as the job's dependencies are done.
+ * The upload (e.g. creating the GL texture) runs on the thread that calls
+ * wait(), which should be the thread that owns the GL context. Uploads run
+ * in the order in which the work finishes, so the total loading time
+ * follows the slowest chain of jobs rather than the sum of all jobs.
+ *
+ * @code
+ * AssetLoader loader;
+ * Image img;
+ * loader.add([&]() { img.load("../textures/tree.png"); },
+ *   [&]() { renderer.loadTexture("tree", img, 0); });
+ * loader.wait();
+ * @endcode
+ *
+ * Work functions run concurrently and must not touch GL or shared state
+ * without their own synchronization.
+ */
+class AssetLoader {
+ public:
+  typedef std::function<void()> Task;
+
+  /**
+   * @brief Start the worker threads
+   * @param numThreads The number of workers, or 0 to use one per core
+   */
+  explicit AssetLoader(int numThreads = 0);
+
+  /**
+   * @brief Finish all jobs (see wait()) and stop the workers
+   */
+  ~AssetLoader();
+
+  /**
+   * @brief Add a job
+   * @param work Runs on a worker thread, may be empty
+   * @param upload Runs on the thread calling wait() after work, may be empty
+   * @param deps Jobs (ids returned by add) whose work and upload must be
+   * done before this job's work starts
+   * @return The id of the job
+   */
+  int add(const Task& work, const Task& upload = Task(),
+      const std::vector<int>& deps = std::vector<int>());
+
+  /**
+   * @brief Run uploads as jobs finish until every job is done
+   *
+   * Jobs may be added from upload functions while waiting.
+   */
+  void wait();
+
+  /**
+   * @brief Run the uploads of jobs that are already finished
+   * @return true if every job is done
+   *
+   * Use poll() instead of wait() to keep drawing (e.g. a loading screen)
+   * while assets load.
+   */
+  bool poll();
+
+  /**
+   * @brief Return the number of worker threads
+   */
+  int numThreads() const { return static_cast<int>(_workers.size()); }
+
+ private:
+  struct Job {
+    Task work;
+    Task upload;
+    int numDeps = 0;              // dependencies that are not done yet
+    std::vector<int> dependents;  // jobs waiting for this one
+    bool done = false;
+  };
+
+  void workerLoop();
+  void complete(int id, std::unique_lock<std::mutex>* lock);
+
+  std::deque<Job> _jobs;  // a deque so that references stay valid
+  std::deque<int> _ready;
+  std::deque<int> _finished;
+  int _numOpen = 0;  // jobs that are not done
+  bool _stop = false;
+  std::mutex _mutex;
+  std::condition_variable _readyCv;
+  std::condition_variable _finishedCv;
+  std::vector<std::thread> _workers;
+};
+
+}  // namespace agl
+#endif  // AGL_ASSET_LOADER_H_
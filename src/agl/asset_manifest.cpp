@@ -0,0 +1,142 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+#include "agl/asset_manifest.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "agl/cache_file.h"
+
+namespace agl {
+
+static const char MANIFEST_HEADER[] = "# agl asset manifest 2";
+static const int NUM_FIELDS = 14;
+
+static const char* TYPE_NAMES[] = { "mesh", "texture", "shader", "font" };
+static const int NUM_TYPES = sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]);
+
+static bool parseType(const std::string& name, AssetInfo::Type* type) {
+  for (int i = 0; i < NUM_TYPES; i++) {
+    if (name == TYPE_NAMES[i]) {
+      *type = static_cast<AssetInfo::Type>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+static std::vector<std::string> splitFields(const std::string& line) {
+  std::vector<std::string> fields;
+  std::stringstream stream(line);
+  std::string field;
+  while (std::getline(stream, field, '\t')) fields.push_back(field);
+  return fields;
+}
+
+bool AssetManifest::load(const std::string& filename) {
+  std::ifstream in(filename);
+  if (!in) return false;
+
+  std::string line;
+  if (!std::getline(in, line) || line != MANIFEST_HEADER) {
+    std::cout << "WARNING: unknown asset manifest " << filename << std::endl;
+    return false;
+  }
+
+  _assets.clear();
+  _index.clear();
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::vector<std::string> f = splitFields(line);
+    AssetInfo info;
+    if (f.size() != NUM_FIELDS || !parseType(f[0], &info.type)) {
+      std::cout << "WARNING: skipping manifest line: " << line << std::endl;
+      continue;
+    }
+    info.path = f[1];
+    info.hash = strtoull(f[2].c_str(), NULL, 16);
+    info.size = strtoull(f[3].c_str(), NULL, 10);
+    info.time = strtoll(f[4].c_str(), NULL, 10);
+    info.width = atoi(f[5].c_str());
+    info.height = atoi(f[6].c_str());
+    info.aspect = strtof(f[7].c_str(), NULL);
+    for (int i = 0; i < 3; i++) {
+      info.boundsMin[i] = strtof(f[8 + i].c_str(), NULL);
+      info.boundsMax[i] = strtof(f[11 + i].c_str(), NULL);
+    }
+    add(info);
+  }
+  return true;
+}
+
+bool AssetManifest::save(const std::string& filename) const {
+  std::vector<const AssetInfo*> sorted;
+  for (const AssetInfo& info : _assets) sorted.push_back(&info);
+  std::sort(sorted.begin(), sorted.end(),
+      [](const AssetInfo* a, const AssetInfo* b) { return a->path < b->path; });
+
+  std::ostringstream out;
+  out << MANIFEST_HEADER << "\n";
+  out << "# type\tpath\thash\tsize\ttime\twidth\theight\taspect\t"
+      "min xyz\tmax xyz\n";
+  out << std::setprecision(9);
+  for (const AssetInfo* info : sorted) {
+    out << TYPE_NAMES[info->type] << "\t" << info->path << "\t"
+        << std::hex << std::setw(16) << std::setfill('0') << info->hash
+        << std::dec << std::setfill(' ') << "\t"
+        << info->size << "\t" << info->time << "\t"
+        << info->width << "\t" << info->height << "\t" << info->aspect;
+    for (int i = 0; i < 3; i++) out << "\t" << info->boundsMin[i];
+    for (int i = 0; i < 3; i++) out << "\t" << info->boundsMax[i];
+    out << "\n";
+  }
+
+  std::string text = out.str();
+  return writeCacheFile(filename, std::vector<char>(text.begin(), text.end()));
+}
+
+void AssetManifest::add(const AssetInfo& info) {
+  auto it = _index.find(info.path);
+  if (it != _index.end()) {
+    _assets[it->second] = info;
+  } else {
+    _index[info.path] = _assets.size();
+    _assets.push_back(info);
+  }
+}
+
+const AssetInfo* AssetManifest::find(const std::string& path) const {
+  auto it = _index.find(path);
+  return it == _index.end() ? nullptr : &_assets[it->second];
+}
+
+const AssetInfo* AssetManifest::findCurrent(const std::string& path) const {
+  const AssetInfo* info = find(path);
+  if (!info) return nullptr;
+
+  SourceStamp stamp;
+  stamp.size = info->size;
+  stamp.time = info->time;
+  stamp.hash = info->hash;
+  int64_t time;
+  if (!isSourceUnchanged(path, stamp, &time)) {
+    std::cout << "WARNING: " << path << " changed since it was cooked, "
+        "run assetcook\n";
+    return nullptr;
+  }
+  return info;
+}
+
+std::vector<const AssetInfo*> AssetManifest::list(AssetInfo::Type type,
+    const std::string& dir) const {
+  std::vector<const AssetInfo*> result;
+  for (const AssetInfo& info : _assets) {
+    if (info.type == type && info.path.compare(0, dir.size(), dir) == 0) {
+      result.push_back(&info);
+    }
+  }
+  return result;
+}
+
+}  // namespace agl
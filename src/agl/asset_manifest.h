@@ -0,0 +1,101 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+
+#ifndef AGL_ASSET_MANIFEST_H_
+#define AGL_ASSET_MANIFEST_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "agl/aglm.h"
+
+namespace agl {
+
+/**
+ * @brief Metadata of one cooked asset
+ *
+ * Textures and fonts fill in the size (of the atlas for fonts) and aspect
+ * ratio, meshes the bounds.
+ */
+struct AssetInfo {
+  enum Type {
+    MESH,
+    TEXTURE,
+    SHADER,
+    FONT
+  };
+
+  Type type = TEXTURE;
+  std::string path;         // as the game opens it, e.g. ../models/a.ply
+  uint64_t hash = 0;        // FNV-1a hash of the source (see SourceStamp)
+  uint64_t size = 0;        // size and modification time of the source
+  int64_t time = 0;
+  int width = 0;
+  int height = 0;
+  float aspect = 1.0f;      // width / height
+  glm::vec3 boundsMin = glm::vec3(0);
+  glm::vec3 boundsMax = glm::vec3(0);
+};
+
+/**
+ * @brief List of cooked assets, written by the assetcook tool
+ *
+ * The manifest is a text file with one asset per line and tab separated
+ * fields, so it can be diffed and read without any of the assets.
+ */
+class AssetManifest {
+ public:
+  AssetManifest() {}
+
+  /**
+   * @brief Read a manifest, replacing the current entries
+   * @return false if the file does not exist or has an unknown version
+   */
+  bool load(const std::string& filename);
+
+  /**
+   * @brief Write the manifest, sorted by path
+   * @return false if the file could not be written
+   */
+  bool save(const std::string& filename) const;
+
+  /**
+   * @brief Add an asset, replacing any entry with the same path
+   */
+  void add(const AssetInfo& info);
+
+  /**
+   * @brief Return the entry for path, or null if there is none
+   */
+  const AssetInfo* find(const std::string& path) const;
+
+  /**
+   * @brief Return the entry for path if it still describes the source
+   *
+   * The source is compared with the entry, so an asset changed after the
+   * last cook is measured again instead of using stale metadata. Like the
+   * caches, the size and time are checked first and the source is only
+   * hashed when its time changed (see isSourceUnchanged()). Returns null,
+   * with a warning, if the source changed. A missing source counts as
+   * unchanged.
+   */
+  const AssetInfo* findCurrent(const std::string& path) const;
+
+  /**
+   * @brief Return the assets of a type whose path starts with dir
+   */
+  std::vector<const AssetInfo*> list(AssetInfo::Type type,
+      const std::string& dir) const;
+
+  /**
+   * @brief Return all assets
+   */
+  const std::vector<AssetInfo>& assets() const { return _assets; }
+
+ private:
+  std::vector<AssetInfo> _assets;
+  std::map<std::string, size_t> _index;  // path to position in _assets
+};
+
+}  // namespace agl
+#endif  // AGL_ASSET_MANIFEST_H_
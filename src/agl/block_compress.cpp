@@ -0,0 +1,349 @@
+// Copyright 2021, Savvy Sine, alinen
+#include "agl/block_compress.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace agl {
+
+// 4x4 RGBA pixels, row by row
+typedef unsigned char Block[64];
+
+static size_t blockBytes(TextureFormat format) {
+  return format == TEXTURE_BC3 ? 16 : 8;
+}
+
+bool isBlockCompressed(TextureFormat format) {
+  return format == TEXTURE_BC1 || format == TEXTURE_BC3 ||
+      format == TEXTURE_BC4;
+}
+
+size_t textureLevelSize(TextureFormat format, int width, int height) {
+  if (!isBlockCompressed(format)) {
+    return 4 * static_cast<size_t>(width) * height;
+  }
+  size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+  return blocks * blockBytes(format);
+}
+
+static void readBlock(const ConstImageView& src, int bx, int by, Block block) {
+  for (int y = 0; y < 4; y++) {
+    const unsigned char* row = src.row(std::min(4 * by + y, src.height() - 1));
+    for (int x = 0; x < 4; x++) {
+      int sx = std::min(4 * bx + x, src.width() - 1);
+      memcpy(block + 4 * (4 * y + x), row + 4 * sx, 4);
+    }
+  }
+}
+
+static void writeBlock(const Block block, int bx, int by,
+    const ImageView& dst) {
+  int width = std::min(4, dst.width() - 4 * bx);
+  int height = std::min(4, dst.height() - 4 * by);
+  for (int y = 0; y < height; y++) {
+    memcpy(dst.row(4 * by + y) + 16 * bx, block + 16 * y, 4 * width);
+  }
+}
+
+//--------------------------------------------------------------------------
+// BC1 colors
+
+static uint16_t pack565(const float rgb[3]) {
+  int r = static_cast<int>(rgb[0] * 31.0f / 255.0f + 0.5f);
+  int g = static_cast<int>(rgb[1] * 63.0f / 255.0f + 0.5f);
+  int b = static_cast<int>(rgb[2] * 31.0f / 255.0f + 0.5f);
+  r = std::max(0, std::min(31, r));
+  g = std::max(0, std::min(63, g));
+  b = std::max(0, std::min(31, b));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(uint16_t c, int rgb[3]) {
+  int r = (c >> 11) & 31;
+  int g = (c >> 5) & 63;
+  int b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// The colors indices 0-3 select, the three color mode (c0 <= c1 in BC1)
+// has the midpoint and transparent black instead of two thirds
+static void colorPalette(uint16_t c0, uint16_t c1, bool fourColors,
+    int palette[4][4]) {
+  unpack565(c0, palette[0]);
+  unpack565(c1, palette[1]);
+  for (int i = 0; i < 3; i++) {
+    if (fourColors) {
+      palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+      palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+    } else {
+      palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+      palette[3][i] = 0;
+    }
+  }
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  palette[3][3] = fourColors ? 255 : 0;
+}
+
+// Writes the block with the nearest palette color for every pixel
+// Returns the squared error
+static int writeColorBlock(const Block block, uint16_t c0, uint16_t c1,
+    unsigned char* dst) {
+  // four color mode needs c0 > c1, equal endpoints only need index 0
+  if (c0 < c1) std::swap(c0, c1);
+  int palette[4][4];
+  colorPalette(c0, c1, true, palette);
+  int numColors = c0 == c1 ? 1 : 4;
+
+  uint32_t indices = 0;
+  int error = 0;
+  for (int i = 0; i < 16; i++) {
+    const unsigned char* p = block + 4 * i;
+    int best = 0;
+    int bestError = INT32_MAX;
+    for (int j = 0; j < numColors; j++) {
+      int dr = p[0] - palette[j][0];
+      int dg = p[1] - palette[j][1];
+      int db = p[2] - palette[j][2];
+      int e = dr * dr + dg * dg + db * db;
+      if (e < bestError) {
+        best = j;
+        bestError = e;
+      }
+    }
+    indices |= static_cast<uint32_t>(best) << (2 * i);
+    error += bestError;
+  }
+
+  dst[0] = c0 & 0xff;
+  dst[1] = c0 >> 8;
+  dst[2] = c1 & 0xff;
+  dst[3] = c1 >> 8;
+  for (int i = 0; i < 4; i++) dst[4 + i] = (indices >> (8 * i)) & 0xff;
+  return error;
+}
+
+// Least squares endpoints for the indices of an encoded block
+// Returns false if every pixel uses the same weight
+static bool refitEndpoints(const Block block, const unsigned char* encoded,
+    float e0[3], float e1[3]) {
+  static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+  uint32_t indices = encoded[4] | (encoded[5] << 8) | (encoded[6] << 16) |
+      (static_cast<uint32_t>(encoded[7]) << 24);
+
+  float aa = 0, bb = 0, ab = 0;
+  float ax[3] = { 0, 0, 0 };
+  float bx[3] = { 0, 0, 0 };
+  for (int i = 0; i < 16; i++) {
+    float a = weights[(indices >> (2 * i)) & 3];
+    float b = 1.0f - a;
+    aa += a * a;
+    bb += b * b;
+    ab += a * b;
+    for (int c = 0; c < 3; c++) {
+      ax[c] += a * block[4 * i + c];
+      bx[c] += b * block[4 * i + c];
+    }
+  }
+
+  float det = aa * bb - ab * ab;
+  if (std::fabs(det) < 1e-6f) return false;
+  for (int c = 0; c < 3; c++) {
+    e0[c] = std::max(0.0f, std::min(255.0f, (ax[c] * bb - bx[c] * ab) / det));
+    e1[c] = std::max(0.0f, std::min(255.0f, (bx[c] * aa - ax[c] * ab) / det));
+  }
+  return true;
+}
+
+// Endpoints at the ends of the principal axis of the colors, then refit to
+// the indices they give
+static void encodeColorBlock(const Block block, unsigned char* dst) {
+  float mean[3] = { 0, 0, 0 };
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 3; c++) mean[c] += block[4 * i + c];
+  }
+  for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+
+  float cov[3][3] = { { 0 } };
+  for (int i = 0; i < 16; i++) {
+    float d[3];
+    for (int c = 0; c < 3; c++) d[c] = block[4 * i + c] - mean[c];
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) cov[r][c] += d[r] * d[c];
+    }
+  }
+
+  // power iteration for the principal axis
+  float axis[3] = { 1, 1, 1 };
+  for (int iter = 0; iter < 8; iter++) {
+    float next[3];
+    for (int r = 0; r < 3; r++) {
+      next[r] = cov[r][0] * axis[0] + cov[r][1] * axis[1] +
+          cov[r][2] * axis[2];
+    }
+    float len = std::sqrt(next[0] * next[0] + next[1] * next[1] +
+        next[2] * next[2]);
+    if (len < 1e-6f) break;
+    for (int c = 0; c < 3; c++) axis[c] = next[c] / len;
+  }
+
+  float lo = FLT_MAX;
+  float hi = -FLT_MAX;
+  for (int i = 0; i < 16; i++) {
+    float t = 0;
+    for (int c = 0; c < 3; c++) t += (block[4 * i + c] - mean[c]) * axis[c];
+    lo = std::min(lo, t);
+    hi = std::max(hi, t);
+  }
+  float e0[3], e1[3];
+  for (int c = 0; c < 3; c++) {
+    e0[c] = std::max(0.0f, std::min(255.0f, mean[c] + hi * axis[c]));
+    e1[c] = std::max(0.0f, std::min(255.0f, mean[c] + lo * axis[c]));
+  }
+  int error = writeColorBlock(block, pack565(e0), pack565(e1), dst);
+
+  unsigned char refit[8];
+  if (error > 0 && refitEndpoints(block, dst, e0, e1) &&
+      writeColorBlock(block, pack565(e0), pack565(e1), refit) < error) {
+    memcpy(dst, refit, sizeof(refit));
+  }
+}
+
+static void decodeColorBlock(const unsigned char* src, bool alwaysFourColors,
+    Block block) {
+  uint16_t c0 = src[0] | (src[1] << 8);
+  uint16_t c1 = src[2] | (src[3] << 8);
+  uint32_t indices = src[4] | (src[5] << 8) | (src[6] << 16) |
+      (static_cast<uint32_t>(src[7]) << 24);
+  int palette[4][4];
+  colorPalette(c0, c1, alwaysFourColors || c0 > c1, palette);
+  for (int i = 0; i < 16; i++) {
+    const int* color = palette[(indices >> (2 * i)) & 3];
+    for (int c = 0; c < 4; c++) {
+      block[4 * i + c] = static_cast<unsigned char>(color[c]);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+// BC4 channels, also the alpha of BC3
+
+// The values indices 0-7 select, a0 <= a1 has four steps plus 0 and 255
+static void channelPalette(int a0, int a1, int palette[8]) {
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a0 > a1) {
+    for (int i = 1; i <= 6; i++) palette[1 + i] = ((7 - i) * a0 + i * a1) / 7;
+  } else {
+    for (int i = 1; i <= 4; i++) palette[1 + i] = ((5 - i) * a0 + i * a1) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+static void encodeChannelBlock(const Block block, int channel,
+    unsigned char* dst) {
+  int lo = 255;
+  int hi = 0;
+  for (int i = 0; i < 16; i++) {
+    lo = std::min(lo, static_cast<int>(block[4 * i + channel]));
+    hi = std::max(hi, static_cast<int>(block[4 * i + channel]));
+  }
+
+  uint64_t indices = 0;
+  if (hi > lo) {
+    int palette[8];
+    channelPalette(hi, lo, palette);
+    for (int i = 0; i < 16; i++) {
+      int v = block[4 * i + channel];
+      int best = 0;
+      for (int j = 1; j < 8; j++) {
+        if (std::abs(v - palette[j]) < std::abs(v - palette[best])) best = j;
+      }
+      indices |= static_cast<uint64_t>(best) << (3 * i);
+    }
+  }
+
+  dst[0] = static_cast<unsigned char>(hi);
+  dst[1] = static_cast<unsigned char>(lo);
+  for (int i = 0; i < 6; i++) dst[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+static void decodeChannelBlock(const unsigned char* src, int channel,
+    Block block) {
+  int palette[8];
+  channelPalette(src[0], src[1], palette);
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++) {
+    indices |= static_cast<uint64_t>(src[2 + i]) << (8 * i);
+  }
+  for (int i = 0; i < 16; i++) {
+    block[4 * i + channel] =
+        static_cast<unsigned char>(palette[(indices >> (3 * i)) & 7]);
+  }
+}
+
+//--------------------------------------------------------------------------
+
+void compressBlocks(TextureFormat format, const ConstImageView& src,
+    unsigned char* dst) {
+  assert(isBlockCompressed(format));
+  int blocksX = (src.width() + 3) / 4;
+  int blocksY = (src.height() + 3) / 4;
+  Block block;
+  for (int by = 0; by < blocksY; by++) {
+    for (int bx = 0; bx < blocksX; bx++) {
+      readBlock(src, bx, by, block);
+      switch (format) {
+        case TEXTURE_BC1:
+          encodeColorBlock(block, dst);
+          break;
+        case TEXTURE_BC3:
+          encodeChannelBlock(block, 3, dst);
+          encodeColorBlock(block, dst + 8);
+          break;
+        default:
+          encodeChannelBlock(block, 0, dst);
+          break;
+      }
+      dst += blockBytes(format);
+    }
+  }
+}
+
+void decompressBlocks(TextureFormat format, const unsigned char* src,
+    const ImageView& dst) {
+  assert(isBlockCompressed(format));
+  int blocksX = (dst.width() + 3) / 4;
+  int blocksY = (dst.height() + 3) / 4;
+  Block block;
+  for (int by = 0; by < blocksY; by++) {
+    for (int bx = 0; bx < blocksX; bx++) {
+      switch (format) {
+        case TEXTURE_BC1:
+          // BC1 textures are opaque RGB, so the alpha of index 3 is ignored
+          decodeColorBlock(src, false, block);
+          for (int i = 0; i < 16; i++) block[4 * i + 3] = 255;
+          break;
+        case TEXTURE_BC3:
+          decodeColorBlock(src + 8, true, block);
+          decodeChannelBlock(src, 3, block);
+          break;
+        default:
+          decodeChannelBlock(src, 0, block);
+          for (int i = 0; i < 16; i++) {
+            block[4 * i + 1] = block[4 * i + 2] = block[4 * i];
+            block[4 * i + 3] = 255;
+          }
+          break;
+      }
+      writeBlock(block, bx, by, dst);
+      src += blockBytes(format);
+    }
+  }
+}
+
+}  // namespace agl
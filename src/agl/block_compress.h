@@ -0,0 +1,62 @@
+// Copyright 2021, Savvy Sine, alinen
+
+#ifndef AGL_BLOCK_COMPRESS_H_
+#define AGL_BLOCK_COMPRESS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "agl/image.h"
+
+namespace agl {
+
+/**
+ * @brief Pixel format of texture data
+ *
+ * The block compressed formats store each 4x4 block of pixels in a fixed
+ * number of bytes, and GPUs sample them without decompressing first:
+ *   - BC1 (DXT1): opaque RGB, 8 bytes per block (8x smaller than RGBA8)
+ *   - BC3 (DXT5): RGB with smooth alpha, 16 bytes per block (4x smaller)
+ *   - BC4 (RGTC1): one channel, 8 bytes per block, used for grayscale
+ *
+ * The values are stored in texture caches, so they must not change.
+ */
+enum TextureFormat {
+  TEXTURE_RGBA8 = 0,
+  TEXTURE_BC1 = 1,
+  TEXTURE_BC3 = 2,
+  TEXTURE_BC4 = 3
+};
+
+/**
+ * @brief Return whether a format stores 4x4 blocks
+ */
+bool isBlockCompressed(TextureFormat format);
+
+/**
+ * @brief Return the bytes needed for a width x height level
+ *
+ * Compressed levels are rounded up to whole blocks.
+ */
+size_t textureLevelSize(TextureFormat format, int width, int height);
+
+/**
+ * @brief Encode the pixels of src into blocks of a compressed format
+ *
+ * dst must hold textureLevelSize(format, src.width(), src.height()) bytes.
+ * Blocks that reach past the edge repeat the last row and column. BC4
+ * encodes the red channel.
+ */
+void compressBlocks(TextureFormat format, const ConstImageView& src,
+    unsigned char* dst);
+
+/**
+ * @brief Decode blocks of a compressed format into the pixels of dst
+ *
+ * BC4 is expanded to gray with opaque alpha, like the texture swizzle the
+ * renderer sets for it.
+ */
+void decompressBlocks(TextureFormat format, const unsigned char* src,
+    const ImageView& dst);
+
+}  // namespace agl
+#endif  // AGL_BLOCK_COMPRESS_H_
@@ -0,0 +1,229 @@
+// Copyright, 2020, Savvy Sine, Aline Normoyle
+#include "agl/bounds.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace agl {
+
+using glm::vec3;
+using glm::mat3;
+
+static inline vec3 position(const float* positions, size_t i) {
+  return vec3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+}
+
+void computeMinMax(const float* positions, size_t numVertices,
+    vec3* min, vec3* max) {
+  if (numVertices == 0) {
+    *min = *max = vec3(0);
+    return;
+  }
+
+  vec3 lo(FLT_MAX);
+  vec3 hi(-FLT_MAX);
+  size_t i = 0;
+#ifdef AGL_SSE2
+  // four vertices are three registers, xyzx yzxy zxyz, so each register
+  // keeps its own min and max and the lanes are sorted out at the end
+  if (numVertices >= 4) {
+    __m128 mn[3], mx[3];
+    for (int r = 0; r < 3; r++) {
+      mn[r] = mx[r] = _mm_loadu_ps(positions + 4 * r);
+    }
+    for (; i + 4 <= numVertices; i += 4) {
+      const float* p = positions + 3 * i;
+      for (int r = 0; r < 3; r++) {
+        __m128 v = _mm_loadu_ps(p + 4 * r);
+        mn[r] = _mm_min_ps(mn[r], v);
+        mx[r] = _mm_max_ps(mx[r], v);
+      }
+    }
+    float a[12], b[12];
+    for (int r = 0; r < 3; r++) {
+      _mm_storeu_ps(a + 4 * r, mn[r]);
+      _mm_storeu_ps(b + 4 * r, mx[r]);
+    }
+    for (int lane = 0; lane < 12; lane++) {
+      lo[lane % 3] = std::min(lo[lane % 3], a[lane]);
+      hi[lane % 3] = std::max(hi[lane % 3], b[lane]);
+    }
+  }
+#endif
+  for (; i < numVertices; i++) {
+    vec3 p = position(positions, i);
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+  *min = lo;
+  *max = hi;
+}
+
+static size_t farthestFrom(const float* positions, size_t numVertices,
+    const vec3& from) {
+  size_t best = 0;
+  float bestDist = -1.0f;
+  for (size_t i = 0; i < numVertices; i++) {
+    vec3 d = position(positions, i) - from;
+    float dist = glm::dot(d, d);
+    if (dist > bestDist) {
+      bestDist = dist;
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Ritter's bounding sphere: start from two far apart points, then grow the
+// sphere to include every point outside it
+static BoundingSphere ritterSphere(const float* positions,
+    size_t numVertices) {
+  vec3 a = position(positions,
+      farthestFrom(positions, numVertices, position(positions, 0)));
+  vec3 b = position(positions, farthestFrom(positions, numVertices, a));
+
+  BoundingSphere sphere;
+  sphere.center = 0.5f * (a + b);
+  sphere.radius = 0.5f * glm::length(b - a);
+  for (size_t i = 0; i < numVertices; i++) {
+    vec3 d = position(positions, i) - sphere.center;
+    float dist = glm::length(d);
+    if (dist > sphere.radius) {
+      float radius = 0.5f * (sphere.radius + dist);
+      sphere.center += ((dist - radius) / dist) * d;
+      sphere.radius = radius;
+    }
+  }
+  return sphere;
+}
+
+static float maxDistance(const float* positions, size_t numVertices,
+    const vec3& center) {
+  float dist = 0.0f;
+  for (size_t i = 0; i < numVertices; i++) {
+    vec3 d = position(positions, i) - center;
+    dist = std::max(dist, glm::dot(d, d));
+  }
+  return std::sqrt(dist);
+}
+
+// Eigenvectors of a symmetric 3x3 matrix with Jacobi rotations, the
+// columns of v are the eigenvectors
+static void jacobiEigenvectors(double a[3][3], double v[3][3]) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) v[i][j] = (i == j) ? 1.0 : 0.0;
+  }
+
+  static const int pairs[3][2] = { {0, 1}, {0, 2}, {1, 2} };
+  for (int sweep = 0; sweep < 16; sweep++) {
+    double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+    if (off < 1e-24) break;
+
+    for (const int* pq : pairs) {
+      int p = pq[0];
+      int q = pq[1];
+      if (std::fabs(a[p][q]) < 1e-30) continue;
+
+      double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+      double t = (theta >= 0 ? 1.0 : -1.0) /
+          (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+      double c = 1.0 / std::sqrt(t * t + 1.0);
+      double s = t * c;
+      for (int k = 0; k < 3; k++) {
+        double akp = a[k][p];
+        double akq = a[k][q];
+        a[k][p] = c * akp - s * akq;
+        a[k][q] = s * akp + c * akq;
+      }
+      for (int k = 0; k < 3; k++) {
+        double apk = a[p][k];
+        double aqk = a[q][k];
+        a[p][k] = c * apk - s * aqk;
+        a[q][k] = s * apk + c * aqk;
+      }
+      for (int k = 0; k < 3; k++) {
+        double vkp = v[k][p];
+        double vkq = v[k][q];
+        v[k][p] = c * vkp - s * vkq;
+        v[k][q] = s * vkp + c * vkq;
+      }
+    }
+  }
+}
+
+// Box along the principal axes (eigenvectors of the covariance)
+static OrientedBox pcaBox(const float* positions, size_t numVertices) {
+  glm::dvec3 mean(0.0);
+  for (size_t i = 0; i < numVertices; i++) {
+    mean += glm::dvec3(position(positions, i));
+  }
+  mean /= static_cast<double>(numVertices);
+
+  double cov[3][3] = { {0} };
+  for (size_t i = 0; i < numVertices; i++) {
+    glm::dvec3 d = glm::dvec3(position(positions, i)) - mean;
+    for (int r = 0; r < 3; r++) {
+      for (int c = r; c < 3; c++) cov[r][c] += d[r] * d[c];
+    }
+  }
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < r; c++) cov[r][c] = cov[c][r];
+  }
+
+  double v[3][3];
+  jacobiEigenvectors(cov, v);
+
+  OrientedBox box;
+  for (int i = 0; i < 2; i++) {
+    box.axes[i] = glm::normalize(vec3(v[0][i], v[1][i], v[2][i]));
+  }
+  box.axes[2] = glm::normalize(glm::cross(box.axes[0], box.axes[1]));
+
+  mat3 toBox = glm::transpose(box.axes);
+  vec3 lo(FLT_MAX);
+  vec3 hi(-FLT_MAX);
+  for (size_t i = 0; i < numVertices; i++) {
+    vec3 p = toBox * position(positions, i);
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+  box.center = box.axes * (0.5f * (lo + hi));
+  box.halfExtents = 0.5f * (hi - lo);
+  return box;
+}
+
+static float volume(const vec3& halfExtents) {
+  return halfExtents.x * halfExtents.y * halfExtents.z;
+}
+
+Bounds Bounds::compute(const float* positions, size_t numVertices) {
+  Bounds bounds;
+  bounds.valid = true;
+  computeMinMax(positions, numVertices, &bounds.min, &bounds.max);
+  if (numVertices == 0) return bounds;
+
+  bounds.sphere = ritterSphere(positions, numVertices);
+  float boxRadius = maxDistance(positions, numVertices, bounds.center());
+  if (boxRadius < bounds.sphere.radius) {
+    bounds.sphere.center = bounds.center();
+    bounds.sphere.radius = boxRadius;
+  }
+
+  bounds.box.center = bounds.center();
+  bounds.box.halfExtents = 0.5f * bounds.size();
+  if (numVertices >= 3) {
+    OrientedBox box = pcaBox(positions, numVertices);
+    if (volume(box.halfExtents) < volume(bounds.box.halfExtents)) {
+      bounds.box = box;
+    }
+  }
+  return bounds;
+}
+
+}  // namespace agl
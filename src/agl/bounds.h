@@ -0,0 +1,67 @@
+// Copyright, 2020, Savvy Sine, Aline Normoyle
+#ifndef AGL_BOUNDS_H_
+#define AGL_BOUNDS_H_
+
+#include <cstddef>
+#include "agl/aglm.h"
+
+namespace agl {
+
+/**
+ * @brief Sphere enclosing every vertex of a mesh
+ */
+struct BoundingSphere {
+  glm::vec3 center = glm::vec3(0);
+  float radius = 0.0f;
+};
+
+/**
+ * @brief Box enclosing every vertex of a mesh, aligned with its shape
+ *
+ * A point p is inside when |dot(p - center, axes[i])| <= halfExtents[i] for
+ * each axis. The columns of axes are orthonormal.
+ */
+struct OrientedBox {
+  glm::vec3 center = glm::vec3(0);
+  glm::mat3 axes = glm::mat3(1);
+  glm::vec3 halfExtents = glm::vec3(0);
+};
+
+/**
+ * @brief Bounding volumes of a set of vertex positions
+ *
+ * Meshes compute these once when their vertices are loaded, so culling,
+ * level of detail and picking can test against them for free.
+ * @see Mesh::bounds()
+ */
+struct Bounds {
+  glm::vec3 min = glm::vec3(0);  // axis-aligned box
+  glm::vec3 max = glm::vec3(0);
+  BoundingSphere sphere;
+  OrientedBox box;               // from the principal axes of the vertices
+  bool valid = false;            // false until computed
+
+  glm::vec3 center() const { return 0.5f * (min + max); }
+  glm::vec3 size() const { return max - min; }
+
+  /**
+   * @brief Compute the bounds of xyz positions
+   * @param positions numVertices * 3 floats
+   *
+   * The sphere is found with Ritter's method and the oriented box from the
+   * principal components of the vertices; each is replaced by the one
+   * around the axis-aligned box when that one is tighter.
+   */
+  static Bounds compute(const float* positions, size_t numVertices);
+};
+
+/**
+ * @brief Compute the axis-aligned box of xyz positions
+ *
+ * Both are zero when there are no positions.
+ */
+void computeMinMax(const float* positions, size_t numVertices,
+    glm::vec3* min, glm::vec3* max);
+
+}  // namespace agl
+#endif  // AGL_BOUNDS_H_
@@ -0,0 +1,191 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+#include "agl/cache_file.h"
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace agl {
+
+MappedFile::MappedFile() {
+  _data = 0;
+  _size = 0;
+  _mapped = false;
+  _handle = 0;
+  _mapping = 0;
+}
+
+MappedFile::MappedFile(std::vector<char>&& bytes) : MappedFile() {
+  _bytes = std::move(bytes);
+  _data = _bytes.data();
+  _size = _bytes.size();
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+  if (_mapped) UnmapViewOfFile(_data);
+  if (_mapping) CloseHandle(_mapping);
+  if (_handle) CloseHandle(_handle);
+#else
+  if (_mapped) munmap(const_cast<char*>(_data), _size);
+#endif
+}
+
+bool MappedFile::map(const std::string& filename) {
+  if (_data) return false;
+
+#ifdef _WIN32
+  HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ,
+      FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (handle == INVALID_HANDLE_VALUE) return false;
+  _handle = handle;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) return false;
+  _mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!_mapping) return false;
+  void* view = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) return false;
+  _data = static_cast<const char*>(view);
+  _size = static_cast<size_t>(size.QuadPart);
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+  _data = static_cast<const char*>(data);
+  _size = info.st_size;
+#endif
+  _mapped = true;
+  return true;
+}
+
+bool fileTimeAndSize(const std::string& filename, uint64_t* size,
+    int64_t* time) {
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) return false;
+  *size = static_cast<uint64_t>(info.st_size);
+  *time = static_cast<int64_t>(info.st_mtime);
+  return true;
+}
+
+static uint64_t hashFile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) return 0;
+
+  uint64_t hash = 14695981039346656037ULL;
+  std::vector<char> buffer(1 << 16);
+  while (file) {
+    file.read(buffer.data(), buffer.size());
+    for (std::streamsize i = 0; i < file.gcount(); i++) {
+      hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+bool SourceStamp::read(const std::string& filename) {
+  if (!fileTimeAndSize(filename, &size, &time)) return false;
+  hash = hashFile(filename);
+  return true;
+}
+
+bool isSourceUnchanged(const std::string& filename, const SourceStamp& stamp,
+    int64_t* time) {
+  uint64_t size;
+  *time = stamp.time;
+  if (!fileTimeAndSize(filename, &size, time)) return true;
+
+  if (size != stamp.size) return false;
+  if (*time == stamp.time) return true;
+  return hashFile(filename) == stamp.hash;
+}
+
+uint64_t hashFileStamps(const std::vector<std::string>& filenames) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto add = [&hash](const void* bytes, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(bytes);
+    for (size_t i = 0; i < size; i++) hash = (hash ^ p[i]) * 1099511628211ULL;
+  };
+  for (const std::string& filename : filenames) {
+    uint64_t size = 0;
+    int64_t time = 0;
+    fileTimeAndSize(filename, &size, &time);
+    add(filename.c_str(), filename.size() + 1);
+    add(&size, sizeof(size));
+    add(&time, sizeof(time));
+  }
+  return hash;
+}
+
+bool updateCacheTime(const std::string& path, size_t stampOffset,
+    int64_t time, std::shared_ptr<MappedFile>* file) {
+  file->reset();
+  {
+    std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+    out.seekp(stampOffset + offsetof(SourceStamp, time));
+    out.write(reinterpret_cast<const char*>(&time), sizeof(time));
+  }
+  *file = std::make_shared<MappedFile>();
+  if ((*file)->map(path)) return true;
+  file->reset();
+  return false;
+}
+
+std::string cacheFilePath(const std::string& filename,
+    const std::string& extension) {
+  size_t slash = filename.find_last_of("/\\");
+  std::string dir = (slash == std::string::npos) ?
+      "" : filename.substr(0, slash + 1);
+  std::string name = (slash == std::string::npos) ?
+      filename : filename.substr(slash + 1);
+  return dir + "cache/" + name + extension;
+}
+
+bool writeCacheFile(const std::string& path, const std::vector<char>& bytes) {
+  size_t slash = path.find_last_of("/\\");
+  if (slash != std::string::npos) {
+    std::string dir = path.substr(0, slash);
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+  }
+
+  // a crash while writing never leaves half a cache behind
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+    if (!out) {
+      std::cout << "WARNING: cannot write cache " << path << std::endl;
+      return false;
+    }
+  }
+  std::remove(path.c_str());
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    std::cout << "WARNING: cannot write cache " << path << std::endl;
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace agl
@@ -0,0 +1,121 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+
+#ifndef AGL_CACHE_FILE_H_
+#define AGL_CACHE_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace agl {
+
+/**
+ * @brief Read-only view of a whole file
+ *
+ * The file is memory-mapped, so its pages are only read when they are
+ * touched. Caches that cannot be written to disk can wrap their bytes
+ * instead, which gives the same interface.
+ */
+class MappedFile {
+ public:
+  MappedFile();
+
+  /**
+   * @brief Wrap bytes held in memory
+   */
+  explicit MappedFile(std::vector<char>&& bytes);
+
+  ~MappedFile();
+
+  /**
+   * @brief Map the given file
+   * @return false if the file does not exist or is empty
+   */
+  bool map(const std::string& filename);
+
+  const char* data() const { return _data; }
+  size_t size() const { return _size; }
+
+ private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char* _data;
+  size_t _size;
+  std::vector<char> _bytes;
+  bool _mapped;
+  void* _handle;   // file and mapping handles on Windows
+  void* _mapping;
+};
+
+/**
+ * @brief Identifies the version of a source file that a cache was built from
+ */
+struct SourceStamp {
+  uint64_t size;   // file size in bytes
+  int64_t time;    // modification time
+  uint64_t hash;   // FNV-1a hash of the contents
+
+  /**
+   * @brief Stamp the given file (reads the whole file for the hash)
+   * @return false if the file does not exist
+   */
+  bool read(const std::string& filename);
+};
+
+/**
+ * @brief Read the size and modification time of a file, without the hash
+ * @return false if the file does not exist
+ */
+bool fileTimeAndSize(const std::string& filename, uint64_t* size,
+    int64_t* time);
+
+/**
+ * @brief Check whether a source file still matches a stored stamp
+ *
+ * The size and time are compared first. When only the time changed (e.g.
+ * after a checkout) the contents are hashed; if they match, *time is set to
+ * the new time so that the caller can store it and skip the hash next time.
+ * A missing source counts as unchanged, so caches can ship without sources.
+ */
+bool isSourceUnchanged(const std::string& filename, const SourceStamp& stamp,
+    int64_t* time);
+
+/**
+ * @brief Return a key for a set of files from their names, sizes and times
+ *
+ * Unlike SourceStamp, the contents are not read, so this is cheap enough to
+ * check on every load. Missing files count as empty.
+ */
+uint64_t hashFileStamps(const std::vector<std::string>& filenames);
+
+/**
+ * @brief Store a new source time in a cache file that is mapped
+ *
+ * Windows cannot write a file while it is mapped, so the mapping is
+ * released first and the file is mapped again afterwards. The time is only
+ * an optimization (see isSourceUnchanged()), so a failed write is ignored.
+ * @param path The cache file
+ * @param stampOffset The offset of the SourceStamp in the file
+ * @param time The new modification time of the source
+ * @param file The mapping of path, replaced by the new mapping
+ * @return false if the file could not be mapped again
+ */
+bool updateCacheTime(const std::string& path, size_t stampOffset,
+    int64_t time, std::shared_ptr<MappedFile>* file);
+
+/**
+ * @brief Return dir/cache/name + extension for the file dir/name
+ */
+std::string cacheFilePath(const std::string& filename,
+    const std::string& extension);
+
+/**
+ * @brief Write a cache file through a temporary file, creating its directory
+ * @return false if the file could not be written
+ */
+bool writeCacheFile(const std::string& path, const std::vector<char>& bytes);
+
+}  // namespace agl
+#endif  // AGL_CACHE_FILE_H_
@@ -0,0 +1,329 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+#include "agl/cached_texture.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "agl/image.h"
+#include "agl/pixel_ops.h"
+
+namespace agl {
+
+static const char TEXTURE_MAGIC[8] = "AGLTEX";
+static const uint32_t TEXTURE_VERSION = 2;
+static const unsigned char ALPHA_CUTOFF = 128;
+
+static size_t align16(size_t n) {
+  return (n + 15) & ~static_cast<size_t>(15);
+}
+
+// Fraction of texels whose alpha (scaled) passes the cutoff
+static float coverage(const Image& image, float scale) {
+  size_t n = static_cast<size_t>(image.width()) * image.height();
+  if (n == 0) return 0.0f;
+
+  // the smallest alpha that passes, so the pixels need only one compare
+  int threshold = 0;
+  while (threshold < 256 && threshold * scale < ALPHA_CUTOFF) threshold++;
+  if (threshold == 256) return 0.0f;
+
+  size_t passed = countAlphaAtLeast(image.view(),
+      static_cast<unsigned char>(threshold));
+  return static_cast<float>(passed) / n;
+}
+
+// Scales the alpha of a level so that its coverage matches the target
+static void preserveCoverage(Image& image, float target) {
+  float lo = 0.0f;
+  float hi = 4.0f;
+  for (int i = 0; i < 12; i++) {
+    float mid = 0.5f * (lo + hi);
+    if (coverage(image, mid) < target) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  float scale = 0.5f * (lo + hi);
+  unsigned char table[256];
+  for (int a = 0; a < 256; a++) {
+    table[a] = static_cast<unsigned char>(std::min(255.0f, a * scale + 0.5f));
+  }
+  remapAlpha(image.view(), table);
+}
+
+// The smallest block format that keeps what the image uses
+//
+// Sizes need not be a multiple of 4: levels are always uploaded whole, and
+// blocks past the edge are padded (as they must be for the small mip levels)
+static TextureFormat chooseFormat(const Image& image) {
+  size_t n = static_cast<size_t>(image.width()) * image.height();
+  if (countAlphaAtLeast(image.view(), 255) < n) return TEXTURE_BC3;
+
+  for (int y = 0; y < image.height(); y++) {
+    const unsigned char* p = image.view().row(y);
+    for (int x = 0; x < image.width(); x++, p += 4) {
+      if (p[0] != p[1] || p[0] != p[2]) return TEXTURE_BC1;
+    }
+  }
+  return TEXTURE_BC4;
+}
+
+static bool isValidCache(const MappedFile& file) {
+  if (file.size() < sizeof(TextureCacheHeader)) return false;
+  const TextureCacheHeader& header =
+      *reinterpret_cast<const TextureCacheHeader*>(file.data());
+  if (memcmp(header.magic, TEXTURE_MAGIC, sizeof(TEXTURE_MAGIC)) != 0) {
+    return false;
+  }
+  if (header.version != TEXTURE_VERSION) return false;
+  if (header.format > TEXTURE_BC4) return false;
+  if (header.numLevels == 0 ||
+      header.numLevels > TextureCacheHeader::MAX_LEVELS) {
+    return false;
+  }
+  TextureFormat format = static_cast<TextureFormat>(header.format);
+  for (uint32_t i = 0; i < header.numLevels; i++) {
+    uint64_t offset = header.levelOffsets[i];
+    if (offset > file.size() || header.levelSizes[i] > file.size() - offset) {
+      return false;
+    }
+    int width = std::max(1, static_cast<int>(header.width >> i));
+    int height = std::max(1, static_cast<int>(header.height >> i));
+    if (header.levelSizes[i] != textureLevelSize(format, width, height)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+CachedTexture::CachedTexture() {
+  _width = 0;
+  _height = 0;
+  _flipped = false;
+  _compressed = true;
+  _numLevels = 0;
+  _format = TEXTURE_RGBA8;
+  _aspect = 1.0f;
+  _alphaCoverage = 1.0f;
+  _sourceHash = 0;
+}
+
+std::string CachedTexture::cachePath(const std::string& filename,
+    bool flip, bool compress) {
+  std::string extension = flip ? ".flip" : "";
+  if (!compress) extension += ".rgba";
+  return cacheFilePath(filename, extension + ".tex");
+}
+
+bool CachedTexture::isCacheCurrent(const std::string& filename, bool flip,
+    bool compress) {
+  return openCache(filename, flip, compress) != nullptr;
+}
+
+std::shared_ptr<MappedFile> CachedTexture::openCache(
+    const std::string& filename, bool flip, bool compress) {
+  std::string path = cachePath(filename, flip, compress);
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if (!file->map(path) || !isValidCache(*file)) return nullptr;
+
+  const TextureCacheHeader& cached =
+      *reinterpret_cast<const TextureCacheHeader*>(file->data());
+  int64_t time;
+  if (!isSourceUnchanged(filename, cached.source, &time)) return nullptr;
+
+  if (time != cached.source.time) {
+    // store the new time so that the next load skips the hash
+    size_t stampOffset = offsetof(TextureCacheHeader, source);
+    if (!updateCacheTime(path, stampOffset, time, &file)) return nullptr;
+  }
+  return file;
+}
+
+std::shared_ptr<MappedFile> CachedTexture::buildCache(
+    const std::string& filename, bool flip, bool compress) {
+  Image image;
+  if (!image.load(filename, flip)) return nullptr;
+
+  SourceStamp source;
+  source.read(filename);
+  return buildCache(cachePath(filename, flip, compress), image, source, flip,
+      compress);
+}
+
+std::shared_ptr<MappedFile> CachedTexture::buildCache(const std::string& path,
+    Image& image, const SourceStamp& source, bool flip, bool compress) {
+  TextureCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TEXTURE_MAGIC, sizeof(TEXTURE_MAGIC));
+  header.version = TEXTURE_VERSION;
+  header.source = source;
+  header.width = image.width();
+  header.height = image.height();
+  header.flipped = flip ? 1 : 0;
+  header.aspect = static_cast<float>(image.width()) / image.height();
+
+  // build the mip chain down to 1x1, the decoded image is the first level
+  std::vector<Image> levels;
+  header.alphaCoverage = coverage(image, 1.0f);
+  bool keepCoverage = header.alphaCoverage > 0.0f &&
+      header.alphaCoverage < 1.0f;
+  levels.push_back(std::move(image));
+
+  while ((levels.back().width() > 1 || levels.back().height() > 1) &&
+      levels.size() < TextureCacheHeader::MAX_LEVELS) {
+    const Image& prev = levels.back();
+    Image next(std::max(1, prev.width() / 2), std::max(1, prev.height() / 2));
+    downsample(prev.view(), next.view());
+    if (keepCoverage) preserveCoverage(next, header.alphaCoverage);
+    levels.push_back(std::move(next));
+  }
+  header.numLevels = static_cast<uint32_t>(levels.size());
+
+  // levels are filtered uncompressed, then encoded
+  TextureFormat format = compress ? chooseFormat(levels[0]) : TEXTURE_RGBA8;
+  header.format = format;
+  size_t offset = align16(sizeof(header));
+  for (size_t i = 0; i < levels.size(); i++) {
+    header.levelOffsets[i] = offset;
+    header.levelSizes[i] = textureLevelSize(format, levels[i].width(),
+        levels[i].height());
+    offset = align16(offset + header.levelSizes[i]);
+  }
+
+  std::vector<char> bytes(offset, 0);
+  memcpy(bytes.data(), &header, sizeof(header));
+  for (size_t i = 0; i < levels.size(); i++) {
+    unsigned char* dst =
+        reinterpret_cast<unsigned char*>(&bytes[header.levelOffsets[i]]);
+    if (isBlockCompressed(format)) {
+      compressBlocks(format, levels[i].view(), dst);
+    } else {
+      memcpy(dst, levels[i].data(), header.levelSizes[i]);
+    }
+  }
+
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if (!writeCacheFile(path, bytes) || !file->map(path)) {
+    return std::make_shared<MappedFile>(std::move(bytes));
+  }
+  return file;
+}
+
+bool CachedTexture::load(const std::string& filename, bool flip,
+    bool compress) {
+  _file = openCache(filename, flip, compress);
+  if (!_file) _file = buildCache(filename, flip, compress);
+  if (!_file) return false;
+
+  const TextureCacheHeader& h = header();
+  _filename = filename;
+  _flipped = flip;
+  _compressed = compress;
+  _width = h.width;
+  _height = h.height;
+  _numLevels = h.numLevels;
+  _format = static_cast<TextureFormat>(h.format);
+  _aspect = h.aspect;
+  _alphaCoverage = h.alphaCoverage;
+  _sourceHash = h.source.hash;
+  return true;
+}
+
+bool CachedTexture::loadGenerated(const std::string& path, uint64_t key,
+    const std::function<bool(Image*)>& build, bool compress) {
+  // the key stands in for the hash of a source file
+  _file = std::make_shared<MappedFile>();
+  if (!_file->map(path) || !isValidCache(*_file) ||
+      header().source.hash != key ||
+      isBlockCompressed(static_cast<TextureFormat>(header().format)) !=
+      compress) {
+    Image image;
+    if (!build(&image) || image.width() <= 0 || image.height() <= 0) {
+      _file.reset();
+      return false;
+    }
+    SourceStamp source;
+    memset(&source, 0, sizeof(source));
+    source.hash = key;
+    _file = buildCache(path, image, source, false, compress);
+  }
+
+  const TextureCacheHeader& h = header();
+  _filename.clear();
+  _flipped = false;
+  _compressed = compress;
+  _width = h.width;
+  _height = h.height;
+  _numLevels = h.numLevels;
+  _format = static_cast<TextureFormat>(h.format);
+  _aspect = h.aspect;
+  _alphaCoverage = h.alphaCoverage;
+  _sourceHash = key;
+  return true;
+}
+
+void CachedTexture::release() {
+  _file.reset();
+}
+
+bool CachedTexture::decompress() {
+  if (!_file) return false;
+  if (!isBlockCompressed(_format)) return true;
+
+  TextureCacheHeader h = header();
+  h.format = TEXTURE_RGBA8;
+  size_t offset = align16(sizeof(h));
+  for (int i = 0; i < _numLevels; i++) {
+    h.levelOffsets[i] = offset;
+    h.levelSizes[i] = textureLevelSize(TEXTURE_RGBA8, levelWidth(i),
+        levelHeight(i));
+    offset = align16(offset + h.levelSizes[i]);
+  }
+
+  std::vector<char> bytes(offset, 0);
+  memcpy(bytes.data(), &h, sizeof(h));
+  for (int i = 0; i < _numLevels; i++) {
+    unsigned char* dst =
+        reinterpret_cast<unsigned char*>(&bytes[h.levelOffsets[i]]);
+    decompressBlocks(_format, levelData(i),
+        ImageView(dst, levelWidth(i), levelHeight(i)));
+  }
+
+  _file = std::make_shared<MappedFile>(std::move(bytes));
+  _format = TEXTURE_RGBA8;
+  return true;
+}
+
+const TextureCacheHeader& CachedTexture::header() const {
+  assert(_file);
+  return *reinterpret_cast<const TextureCacheHeader*>(_file->data());
+}
+
+int CachedTexture::levelWidth(int level) const {
+  return std::max(1, _width >> level);
+}
+
+int CachedTexture::levelHeight(int level) const {
+  return std::max(1, _height >> level);
+}
+
+size_t CachedTexture::levelSize(int level) const {
+  assert(level >= 0 && level < _numLevels);
+  return header().levelSizes[level];
+}
+
+const unsigned char* CachedTexture::levelData(int level) const {
+  assert(level >= 0 && level < _numLevels);
+  return reinterpret_cast<const unsigned char*>(
+      _file->data() + header().levelOffsets[level]);
+}
+
+size_t CachedTexture::dataSize(int firstLevel) const {
+  size_t size = 0;
+  for (int i = firstLevel; i < _numLevels; i++) size += levelSize(i);
+  return size;
+}
+
+}  // namespace agl
@@ -0,0 +1,184 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+
+#ifndef AGL_CACHED_TEXTURE_H_
+#define AGL_CACHED_TEXTURE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "agl/block_compress.h"
+#include "agl/cache_file.h"
+
+namespace agl {
+
+/**
+ * @brief Layout of a texture cache file
+ *
+ * The header is followed by the pixel data of every mip level, largest
+ * first, each starting on a 16 byte boundary.
+ */
+struct TextureCacheHeader {
+  static const int MAX_LEVELS = 16;
+
+  char magic[8];            // "AGLTEX"
+  uint32_t version;
+  uint32_t format;          // TextureFormat of every level
+  SourceStamp source;       // the image file this was built from
+  uint32_t width;
+  uint32_t height;
+  uint32_t numLevels;
+  uint32_t flipped;         // 1 if the rows were flipped when decoding
+  float aspect;             // width / height
+  float alphaCoverage;      // fraction of texels with alpha >= 0.5
+  uint64_t levelOffsets[MAX_LEVELS];
+  uint64_t levelSizes[MAX_LEVELS];
+};
+
+/**
+ * @brief An image decoded ahead of time, with its full mip chain
+ *
+ * The first load of an image decodes it, builds the mip levels and writes
+ * them to <image dir>/cache/<file>.tex. Later loads map that file, so the
+ * levels can be uploaded with no decoding or copying. The cache is rebuilt
+ * when the source image changes (see isSourceUnchanged()).
+ *
+ * Mip levels of images with alpha keep the alpha coverage of the first
+ * level, so alpha tested foliage does not thin out in the distance.
+ *
+ * Levels are block compressed: opaque images use BC1, grayscale ones BC4
+ * and images with alpha BC3 (see TextureFormat). GPUs without these
+ * formats get RGBA8 levels from decompress(). Images whose detail the
+ * lossy formats would blur, such as text, can be loaded uncompressed.
+ *
+ * Loading only touches files, so it can run on any thread.
+ * @see Renderer::loadTexture(const std::string&, const CachedTexture&, int)
+ */
+class CachedTexture {
+ public:
+  CachedTexture();
+
+  /**
+   * @brief Map the cache of an image, building it if needed
+   * @param flip Whether the image should be flipped vertically
+   * @param compress Whether the levels are block compressed or RGBA8
+   * @return false if the image could not be loaded
+   */
+  bool load(const std::string& filename, bool flip = false,
+      bool compress = true);
+
+  /**
+   * @brief Map the cache of an image made from other files, e.g. an atlas
+   *
+   * build() makes the image when the cache at path is missing or was built
+   * for another key, so the key must change whenever the inputs do (see
+   * hashFileStamps()). The image gets mip levels like any other. Such
+   * textures have no filename and cannot be reloaded from one.
+   * @param path The cache file, e.g. from cacheFilePath()
+   * @param build Fills in the image, returns false on error
+   * @return false if the cache could not be loaded or built
+   */
+  bool loadGenerated(const std::string& path, uint64_t key,
+      const std::function<bool(Image*)>& build, bool compress = true);
+
+  /**
+   * @brief Unmap the cache, e.g. once the texture is uploaded
+   *
+   * The size and metadata stay available.
+   */
+  void release();
+
+  /**
+   * @brief Return whether the pixel data is available
+   */
+  bool loaded() const { return _file != nullptr; }
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+  int numLevels() const { return _numLevels; }
+
+  /**
+   * @brief Return the format of the levels
+   */
+  TextureFormat format() const { return _format; }
+
+  /**
+   * @brief Return width / height
+   */
+  float aspect() const { return _aspect; }
+
+  /**
+   * @brief Return the fraction of texels with alpha >= 0.5
+   */
+  float alphaCoverage() const { return _alphaCoverage; }
+
+  /**
+   * @brief Return the image file and options passed to load()
+   */
+  const std::string& filename() const { return _filename; }
+  bool flipped() const { return _flipped; }
+  bool compressed() const { return _compressed; }
+
+  /**
+   * @brief Return the hash of the image the cache was built from
+   */
+  uint64_t sourceHash() const { return _sourceHash; }
+
+  /**
+   * @brief Replace block compressed levels with RGBA8 ones
+   *
+   * The levels are decoded into memory, the cache file is unchanged. Used
+   * when the GPU cannot sample the cached format.
+   * @return false if the pixels are not loaded
+   */
+  bool decompress();
+
+  /**
+   * @brief Return the size and pixels of a mip level
+   */
+  int levelWidth(int level) const;
+  int levelHeight(int level) const;
+  size_t levelSize(int level) const;
+  const unsigned char* levelData(int level) const;
+
+  /**
+   * @brief Return the size of the levels from firstLevel on
+   */
+  size_t dataSize(int firstLevel = 0) const;
+
+  /**
+   * @brief Return the cache file used for an image
+   */
+  static std::string cachePath(const std::string& filename, bool flip,
+      bool compress = true);
+
+  /**
+   * @brief Return whether the cache of an image exists and is up to date
+   */
+  static bool isCacheCurrent(const std::string& filename, bool flip,
+      bool compress = true);
+
+ private:
+  static std::shared_ptr<MappedFile> openCache(const std::string& filename,
+      bool flip, bool compress);
+  static std::shared_ptr<MappedFile> buildCache(const std::string& filename,
+      bool flip, bool compress);
+  static std::shared_ptr<MappedFile> buildCache(const std::string& path,
+      Image& image, const SourceStamp& source, bool flip, bool compress);
+  const TextureCacheHeader& header() const;
+
+  std::shared_ptr<MappedFile> _file;
+  std::string _filename;
+  bool _flipped;
+  bool _compressed;
+  int _width;
+  int _height;
+  int _numLevels;
+  TextureFormat _format;
+  float _aspect;
+  float _alphaCoverage;
+  uint64_t _sourceHash;
+};
+
+}  // namespace agl
+#endif  // AGL_CACHED_TEXTURE_H_
@@ -2,7 +2,12 @@
 
 #include "agl/image.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "agl/pixel_ops.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
 #define STB_IMAGE_IMPLEMENTATION
@@ -12,24 +17,103 @@ namespace agl {
 using glm::vec3;
 using glm::vec4;
 
+// Keeps freed pixel buffers for reuse, so that loads which create and drop
+// images of similar size (e.g. mip levels, atlases) do not hit the heap
+class PixelPool {
+ public:
+  unsigned char* acquire(size_t size, size_t* capacity) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      for (size_t i = 0; i < _free.size(); i++) {
+        if (_free[i].capacity >= size && _free[i].capacity / 2 <= size) {
+          Buffer buffer = _free[i];
+          _free.erase(_free.begin() + i);
+          _bytes -= buffer.capacity;
+          *capacity = buffer.capacity;
+          return buffer.data;
+        }
+      }
+    }
+    *capacity = size;
+    return new unsigned char[size];
+  }
+
+  void release(unsigned char* data, size_t capacity) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_bytes + capacity <= MAX_BYTES) {
+        _free.push_back(Buffer{data, capacity});
+        _bytes += capacity;
+        return;
+      }
+    }
+    delete[] data;
+  }
+
+ private:
+  static const size_t MAX_BYTES = 64 * 1024 * 1024;
+
+  struct Buffer {
+    unsigned char* data;
+    size_t capacity;
+  };
+  std::mutex _mutex;
+  std::vector<Buffer> _free;
+  size_t _bytes = 0;
+};
+
+// never destroyed, images may outlive other statics
+static PixelPool& pixelPool() {
+  static PixelPool* pool = new PixelPool();
+  return *pool;
+}
+
+template <typename T>
+BasicImageView<T> BasicImageView<T>::region(int x, int y,
+    int width, int height) const {
+  assert(x >= 0 && y >= 0 && x + width <= _width && y + height <= _height);
+  return BasicImageView(row(y) + 4 * x, width, height, _stride);
+}
+
+template <typename T>
+bool BasicImageView<T>::save(const std::string& filename, bool flip) const {
+  stbi_flip_vertically_on_write(flip);
+  int result = stbi_write_png(filename.c_str(), _width, _height,
+    4, _data, _stride);
+  return (result == 1);
+}
+
+template class BasicImageView<unsigned char>;
+template class BasicImageView<const unsigned char>;
+
 Image::Image() :
   myData(0),
   myWidth(0),
   myHeight(0),
+  myCapacity(0),
   myLoaded(false) {
 }
 
 Image::Image(int width, int height) :
   myWidth(width), myHeight(height), myLoaded(false) {
-  myData = new unsigned char[4*width*height];
+  myData = pixelPool().acquire(4 * width * height, &myCapacity);
 }
 
-Image::Image(const Image& orig) {
-  myWidth = orig.myWidth;
-  myHeight = orig.myHeight;
-  myLoaded = false;
-  myData = new unsigned char[4 * myWidth * myHeight];
-  memcpy(myData, orig.myData, sizeof(unsigned char) * myWidth * myHeight * 4);
+Image::Image(const Image& orig) : Image() {
+  *this = orig;
+}
+
+Image::Image(Image&& orig) noexcept :
+  myData(orig.myData),
+  myWidth(orig.myWidth),
+  myHeight(orig.myHeight),
+  myCapacity(orig.myCapacity),
+  myLoaded(orig.myLoaded) {
+  orig.myData = 0;
+  orig.myWidth = 0;
+  orig.myHeight = 0;
+  orig.myCapacity = 0;
+  orig.myLoaded = false;
 }
 
 Image& Image::operator=(const Image& orig) {
@@ -37,13 +121,27 @@ Image& Image::operator=(const Image& orig) {
     return *this;
   }
 
-  clear();
+  if (orig.myData) {
+    set(orig.myWidth, orig.myHeight, orig.myData);
+  } else {
+    clear();
+    myWidth = orig.myWidth;
+    myHeight = orig.myHeight;
+  }
+  return *this;
+}
 
-  myWidth = orig.myWidth;
-  myHeight = orig.myHeight;
-  myLoaded = false;
-  myData = new unsigned char[4 * myWidth * myHeight];
-  memcpy(myData, orig.myData, sizeof(unsigned char) * myWidth * myHeight * 4);
+Image& Image::operator=(Image&& orig) noexcept {
+  if (&orig == this) {
+    return *this;
+  }
+
+  clear();
+  std::swap(myData, orig.myData);
+  std::swap(myWidth, orig.myWidth);
+  std::swap(myHeight, orig.myHeight);
+  std::swap(myCapacity, orig.myCapacity);
+  std::swap(myLoaded, orig.myLoaded);
   return *this;
 }
 
@@ -56,39 +154,44 @@ void Image::set(int width, int height, unsigned char* data) {
 
   myWidth = width;
   myHeight = height;
-  myLoaded = false;
-  myData = new unsigned char[4 * myWidth * myHeight];
+  myData = pixelPool().acquire(4 * myWidth * myHeight, &myCapacity);
   memcpy(myData, data, sizeof(unsigned char) * myWidth * myHeight * 4);
 }
 
 void Image::clear() {
   if (myLoaded) {
     stbi_image_free(myData);
-    myData = 0;
-    myLoaded = false;
-  } else {
-    delete[] myData;
+  } else if (myData) {
+    pixelPool().release(myData, myCapacity);
   }
+  myData = 0;
+  myCapacity = 0;
+  myLoaded = false;
 }
 
 bool Image::load(const std::string& filename, bool flip) {
   clear();
-  stbi_set_flip_vertically_on_load(flip);
 
-  int x, y, n;
+  // stb's flip flag is global, so flip here to keep loads thread-safe
+  int x = 0, y = 0, n;
   myData = stbi_load(filename.c_str(), &x, &y, &n, 4);
   myWidth = x;
   myHeight = y;
   myLoaded = true;
+  if (myData != NULL && flip) {
+    flipRows(view());
+  }
   return (myData != NULL);
 }
 
+bool Image::readSize(const std::string& filename, int* width,
+    int* height) {
+  int n;
+  return stbi_info(filename.c_str(), width, height, &n) == 1;
+}
 
 bool Image::save(const std::string& filename, bool flip) const {
-  stbi_flip_vertically_on_write(flip);
-  int result = stbi_write_png(filename.c_str(), myWidth, myHeight,
-    4, (unsigned char*) myData, myWidth*4);
-  return (result == 1);
+  return view().save(filename, flip);
 }
 
 Pixel Image::get(int row, int col) const {
@@ -21,15 +21,81 @@ struct Pixel {
     unsigned char a;
 };
 
+/**
+ * @brief Non-owning view of RGBA pixels, e.g. an Image or a region of one
+ *
+ * Rows are stride bytes apart, so a view can cover part of a larger image
+ * without copying it. A view is only valid while the pixels it points to
+ * are alive. ImageView can change the pixels, ConstImageView can only read
+ * them; an ImageView converts to a ConstImageView but not the other way.
+ *
+ * @see pixel_ops.h
+ */
+template <typename T>
+class BasicImageView {
+ public:
+  BasicImageView() : _data(0), _width(0), _height(0), _stride(0) {}
+
+  /**
+   * @brief View width x height pixels starting at data
+   * @param stride Bytes between rows, 0 for tightly packed rows
+   */
+  BasicImageView(T* data, int width, int height, int stride = 0) :
+    _data(data), _width(width), _height(height),
+    _stride(stride > 0 ? stride : 4 * width) {}
+
+  /**
+   * @brief View the same pixels as a writable view
+   */
+  BasicImageView(const BasicImageView<unsigned char>& other) :
+    _data(other.data()), _width(other.width()), _height(other.height()),
+    _stride(other.stride()) {}
+
+  inline T* data() const { return _data; }
+  inline int width() const { return _width; }
+  inline int height() const { return _height; }
+  inline int stride() const { return _stride; }
+
+  /** @brief Return the first pixel of the given row
+   */
+  inline T* row(int y) const { return _data + y * _stride; }
+
+  /**
+   * @brief Return the view of a rectangle inside this view
+   */
+  BasicImageView region(int x, int y, int width, int height) const;
+
+  /**
+   * @brief Save the pixels to the given filename (.png)
+   * @param flip Whether the rows should be flipped vertically when saved
+   */
+  bool save(const std::string& filename, bool flip = true) const;
+
+ private:
+  T* _data;
+  int _width;
+  int _height;
+  int _stride;
+};
+
+typedef BasicImageView<unsigned char> ImageView;
+typedef BasicImageView<const unsigned char> ConstImageView;
+
 /**
  * @brief Implements loading, modifying, and saving RGBA images
+ *
+ * Copies duplicate the pixels, so pass images by reference and use
+ * std::move (e.g. when storing them in containers) to hand them over.
+ * Pixel buffers are recycled between images of similar size.
  */
 class Image {
  public:
   Image();
   Image(int width, int height);
   Image(const Image& orig);
+  Image(Image&& orig) noexcept;
   Image& operator=(const Image& orig);
+  Image& operator=(Image&& orig) noexcept;
 
   virtual ~Image();
 
@@ -42,6 +108,12 @@ class Image {
    */
   bool load(const std::string& filename, bool flip = false);
 
+  /**
+   * @brief Read the size of an image file without decoding its pixels
+   * @return false if the file is not an image
+   */
+  static bool readSize(const std::string& filename, int* width, int* height);
+
   /** 
    * @brief Save the image to the given filename (.png)
    * @param filename The file to load, relative to the running directory
@@ -64,6 +136,18 @@ class Image {
    */
   inline unsigned char* data() const { return myData; }
 
+  /**
+   * @brief Return a view of the whole image
+   */
+  inline ImageView view() { return ImageView(myData, myWidth, myHeight); }
+
+  /**
+   * @brief Return a read-only view of the whole image
+   */
+  inline ConstImageView view() const {
+    return ConstImageView(myData, myWidth, myHeight);
+  }
+
   /**
    * @brief Replace image RGBA data
    * @param width The new image width
@@ -118,6 +202,7 @@ class Image {
   unsigned char* myData;
   unsigned int myWidth;
   unsigned int myHeight;
+  size_t myCapacity;  // size of the pooled buffer, 0 if stb owns myData
   bool myLoaded;
 };
 }  // namespace agl
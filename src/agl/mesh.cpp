@@ -6,6 +6,10 @@ using glm::vec4;
 
 namespace agl {
 
+static size_t byteSize(const std::vector<GLfloat>* data) {
+  return data ? data->size() * sizeof(GLfloat) : 0;
+}
+
 void Mesh::initBuffers(
   std::vector<GLfloat> * points,
   std::vector<GLfloat> * normals,
@@ -24,6 +28,9 @@ void Mesh::initBuffers(
   _initialized = true;
   _hasUV = (texCoords != nullptr);
   _nVerts = points->size() / 3;  // assumes xyz positions
+  if (!_bounds.valid) _bounds = Bounds::compute(points->data(), _nVerts);
+  _gpuBytes = byteSize(points) + byteSize(normals) + byteSize(texCoords) +
+      byteSize(colors) + byteSize(tangents);
 
   GLuint type = GL_STATIC_DRAW;
   if (_isDynamic) {
@@ -127,6 +134,7 @@ void Mesh::deleteBuffers() {
     glDeleteBuffers((GLsizei)_buffers.size(), _buffers.data());
     _buffers.clear();
   }
+  _gpuBytes = 0;
 
   if (_vao != 0) {
     glDeleteVertexArrays(1, &_vao);
@@ -134,6 +142,24 @@ void Mesh::deleteBuffers() {
   }
 }
 
+void Mesh::upload() {
+  init();
+  if (_initialized) releaseCpuData();
+}
+
+void Mesh::setResidency(Residency residency) {
+  assert(_initialized == false);
+  _residency = residency;
+}
+
+size_t Mesh::cpuBytes() const {
+  size_t bytes = 0;
+  for (const std::vector<GLfloat>& data : _data) {
+    bytes += data.capacity() * sizeof(GLfloat);
+  }
+  return bytes;
+}
+
 void Mesh::setIsDynamic(bool on) {
   assert(_initialized == false);
   _isDynamic = on;
@@ -2,9 +2,11 @@
 #ifndef AGL_MESH_H_
 #define AGL_MESH_H_
 
+#include <cstddef>
 #include <vector>
 #include "agl/agl.h"
 #include "agl/aglm.h"
+#include "agl/bounds.h"
 
 namespace agl {
 
@@ -17,8 +19,13 @@ namespace agl {
  */
 class Mesh {
  public:
+  Mesh() = default;
   virtual ~Mesh();
 
+  // Meshes own their GPU buffers, share them by pointer instead of copying
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+
   /**
    * @brief Draw this mesh
    *
@@ -56,12 +63,63 @@ class Mesh {
    */
   bool isDynamic() const { return _isDynamic; }
 
+  /**
+   * @brief Return the bounding box, sphere and oriented box of the vertices
+   *
+   * Meshes loaded from files know their bounds once loaded, other meshes
+   * once they are initialized (e.g. after the first render()). Dynamic
+   * meshes keep the bounds of their initial vertices.
+   */
+  const Bounds& bounds() const { return _bounds; }
+
+  /**
+   * @brief What happens to vertex data in main memory once it is uploaded
+   *
+   * * *KEEP_CPU_DATA* Keep every vertex array, e.g. to read or edit it later
+   * * *KEEP_POSITIONS* Keep only the positions, e.g. for collision or picking
+   * * *RELEASE_CPU_DATA* Free the vertex arrays, the GPU has its own copy
+   *
+   * Dynamic meshes always keep the data they update the GPU from.
+   * @see setResidency(Residency)
+   */
+  enum Residency {
+    KEEP_CPU_DATA,
+    KEEP_POSITIONS,
+    RELEASE_CPU_DATA
+  };
+
+  /**
+   * @brief Set what to keep in main memory after the upload
+   *
+   * Must be called before the mesh is initialized. Meshes keep their CPU
+   * data by default.
+   */
+  void setResidency(Residency residency);
+
+  /**
+   * @brief Return the residency policy
+   */
+  Residency residency() const { return _residency; }
+
+  /**
+   * @brief Return the bytes of vertex data held in main memory
+   */
+  virtual size_t cpuBytes() const;
+
+  /**
+   * @brief Return the bytes of vertex data uploaded to the GPU
+   */
+  size_t gpuBytes() const { return _gpuBytes; }
+
  protected:
   GLuint _nVerts = 0;      // Number of unique vertices
   GLuint _vao = 0;         // The Vertex Array Object
   bool _hasUV = false;
   bool _isDynamic = false;
   bool _initialized = false;
+  Bounds _bounds;
+  Residency _residency = KEEP_CPU_DATA;
+  size_t _gpuBytes = 0;
   std::vector<GLuint> _buffers;   // vertex buffers
   std::vector<GLfloat> _data[6];  // State for dynamic meshes
   enum VertexAttribute {
@@ -145,6 +203,23 @@ class Mesh {
    */
   virtual void init() = 0;
 
+  /**
+   * @brief Call init() and then release the data the residency policy does
+   * not keep
+   *
+   * render() calls this the first time the mesh is drawn.
+   */
+  void upload();
+
+  /**
+   * @brief Free the CPU data that the residency policy does not keep
+   *
+   * Called once after init(). Subclasses that hold their own vertex arrays
+   * (e.g. PLYMesh) override this.
+   * @see setResidency(Residency)
+   */
+  virtual void releaseCpuData() {}
+
   /**
    * @brief Call initBuffers from init() to set the data for this mesh
    *
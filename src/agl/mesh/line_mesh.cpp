@@ -7,7 +7,7 @@ using glm::vec4;
 namespace agl {
 
 void LineMesh::render() const {
-  if (!_initialized) const_cast<LineMesh*>(this)->init();
+  if (!_initialized) const_cast<LineMesh*>(this)->upload();
   if (_vao == 0) return;
 
   glBindVertexArray(_vao);
@@ -7,7 +7,7 @@ using glm::vec4;
 namespace agl {
 
 void PointMesh::render() const {
-  if (!_initialized) const_cast<PointMesh*>(this)->init();
+  if (!_initialized) const_cast<PointMesh*>(this)->upload();
   if (_vao == 0) return;
 
   glBindVertexArray(_vao);
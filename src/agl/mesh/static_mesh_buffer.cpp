@@ -0,0 +1,230 @@
+// Copyright, 2020, Savvy Sine, Aline Normoyle
+#include "agl/mesh/static_mesh_buffer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+
+using glm::mat3;
+using glm::mat4;
+
+namespace agl {
+
+// Interleaved vertex: position, normal, uv
+static const int VERTEX_FLOATS = 8;
+static const GLsizeiptr VERTEX_SIZE = VERTEX_FLOATS * sizeof(GLfloat);
+
+StaticMeshBuffer::StaticMeshBuffer() {
+  _hasUV = true;
+  _vao = 0;
+  _vertexBuffer = 0;
+  _vertexCapacity = 0;
+  _vertexBytes = 0;
+  _indexBuffer = 0;
+  _indexCapacity = 0;
+  _indexBytes = 0;
+  _drawIdBuffer = 0;
+  _drawIdCapacity = 0;
+  _commandBuffer = 0;
+  _commandCapacity = 0;
+  _transformBuffer = 0;
+  _transformCapacity = 0;
+}
+
+StaticMeshBuffer::~StaticMeshBuffer() {
+  GLuint buffers[] = {_vertexBuffer, _indexBuffer, _drawIdBuffer,
+    _commandBuffer, _transformBuffer};
+  glDeleteBuffers(5, buffers);
+  glDeleteVertexArrays(1, &_vao);
+}
+
+bool StaticMeshBuffer::multiDrawSupported() {
+  static int supported = -1;
+  if (supported < 0) {
+    supported = (GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect &&
+        GLEW_ARB_shader_storage_buffer_object)) ? 1 : 0;
+  }
+  return supported == 1;
+}
+
+bool StaticMeshBuffer::reserve(GLuint* buffer, GLsizeiptr* capacity,
+    GLsizeiptr used, GLsizeiptr needed) {
+  if (used + needed <= *capacity) return false;
+
+  // grow geometrically and copy the existing contents on the GPU
+  GLsizeiptr newCapacity = std::max(used + needed, *capacity * 2);
+  GLuint newBuffer = 0;
+  glGenBuffers(1, &newBuffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, NULL, GL_STATIC_DRAW);
+  if (*buffer != 0) {
+    if (used > 0) {
+      glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+          0, 0, used);
+    }
+    glDeleteBuffers(1, buffer);
+  }
+  *buffer = newBuffer;
+  *capacity = newCapacity;
+  return true;
+}
+
+void StaticMeshBuffer::stream(GLenum target, GLuint buffer,
+    GLsizeiptr* capacity, const void* data, GLsizeiptr size) {
+  glBindBuffer(target, buffer);
+  if (size > *capacity) {
+    *capacity = std::max<GLsizeiptr>(size, *capacity * 2);
+  }
+  glBufferData(target, *capacity, NULL, GL_STREAM_DRAW);
+  glBufferSubData(target, 0, size, data);
+}
+
+void StaticMeshBuffer::initVao() {
+  if (_vao == 0) glGenVertexArrays(1, &_vao);
+  glBindVertexArray(_vao);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+
+  glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+  glEnableVertexAttribArray(0);  // Vertex position
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, 0);
+  glEnableVertexAttribArray(1);  // Normal
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE,
+      (const GLvoid*) (3 * sizeof(GLfloat)));
+  glEnableVertexAttribArray(2);  // Texture coordinates
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, VERTEX_SIZE,
+      (const GLvoid*) (6 * sizeof(GLfloat)));
+
+  // Draw id, advanced once per draw via baseInstance
+  if (_drawIdBuffer != 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, _drawIdBuffer);
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(GLuint), 0);
+    glVertexAttribDivisor(5, 1);
+  }
+
+  glBindVertexArray(0);
+}
+
+int StaticMeshBuffer::add(const std::vector<GLuint>& indices,
+    const std::vector<GLfloat>& points,
+    const std::vector<GLfloat>& normals,
+    const std::vector<GLfloat>* texCoords) {
+  size_t nVerts = points.size() / 3;
+  if (indices.empty() || nVerts == 0 || normals.size() != points.size()) {
+    std::cout << "StaticMeshBuffer: indices, points, and normals should "
+        "be non-empty and of matching size\n";
+    return -1;
+  }
+
+  bool hasUV = texCoords && texCoords->size() == nVerts * 2;
+  _hasUV = _hasUV && hasUV;
+
+  std::vector<GLfloat> vertices(nVerts * VERTEX_FLOATS, 0.0f);
+  for (size_t i = 0; i < nVerts; i++) {
+    GLfloat* v = &vertices[i * VERTEX_FLOATS];
+    std::copy(&points[i * 3], &points[i * 3] + 3, v);
+    std::copy(&normals[i * 3], &normals[i * 3] + 3, v + 3);
+    if (hasUV) {
+      std::copy(&(*texCoords)[i * 2], &(*texCoords)[i * 2] + 2, v + 6);
+    }
+  }
+
+  GLsizeiptr vertexSize = vertices.size() * sizeof(GLfloat);
+  GLsizeiptr indexSize = indices.size() * sizeof(GLuint);
+  bool grew = reserve(&_vertexBuffer, &_vertexCapacity,
+      _vertexBytes, vertexSize);
+  grew = reserve(&_indexBuffer, &_indexCapacity, _indexBytes, indexSize) ||
+      grew;
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, _vertexBuffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, _vertexBytes, vertexSize,
+      vertices.data());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, _indexBuffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, _indexBytes, indexSize,
+      indices.data());
+
+  Range range;
+  range.firstIndex = (GLuint) (_indexBytes / sizeof(GLuint));
+  range.count = (GLuint) indices.size();
+  range.baseVertex = (GLint) (_vertexBytes / VERTEX_SIZE);
+  _meshes.push_back(range);
+
+  _vertexBytes += vertexSize;
+  _indexBytes += indexSize;
+  if (grew) initVao();
+
+  return (int) _meshes.size() - 1;
+}
+
+void StaticMeshBuffer::queue(int id, const mat4& model) {
+  assert(id >= 0 && id < (int) _meshes.size());
+  const Range& range = _meshes[id];
+
+  DrawCommand cmd;
+  cmd.count = range.count;
+  cmd.instanceCount = 1;
+  cmd.firstIndex = range.firstIndex;
+  cmd.baseVertex = range.baseVertex;
+  cmd.baseInstance = (GLuint) _commands.size();
+  _commands.push_back(cmd);
+
+  DrawTransform xform;
+  xform.model = model;
+  _transforms.push_back(xform);
+}
+
+void StaticMeshBuffer::drawIndirect(const mat4& view) {
+  if (_commands.empty()) return;
+  assert(multiDrawSupported());
+
+  // Draw ids 0..n-1; baseInstance selects one per draw
+  GLsizeiptr idSize = _commands.size() * sizeof(GLuint);
+  if (idSize > _drawIdCapacity) {
+    _drawIdCapacity = std::max(idSize, _drawIdCapacity * 2);
+    std::vector<GLuint> ids(_drawIdCapacity / sizeof(GLuint));
+    for (size_t i = 0; i < ids.size(); i++) ids[i] = (GLuint) i;
+    if (_drawIdBuffer == 0) glGenBuffers(1, &_drawIdBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _drawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, _drawIdCapacity, ids.data(),
+        GL_STATIC_DRAW);
+    initVao();
+  }
+
+  for (DrawTransform& xform : _transforms) {
+    mat3 mv = mat3(view * xform.model);
+    xform.normal = mat4(glm::transpose(glm::inverse(mv)));
+  }
+
+  if (_commandBuffer == 0) glGenBuffers(1, &_commandBuffer);
+  if (_transformBuffer == 0) glGenBuffers(1, &_transformBuffer);
+  stream(GL_SHADER_STORAGE_BUFFER, _transformBuffer, &_transformCapacity,
+      _transforms.data(), _transforms.size() * sizeof(DrawTransform));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _transformBuffer);
+  stream(GL_DRAW_INDIRECT_BUFFER, _commandBuffer, &_commandCapacity,
+      _commands.data(), _commands.size() * sizeof(DrawCommand));
+
+  glBindVertexArray(_vao);
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0,
+      (GLsizei) _commands.size(), 0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  clear();
+}
+
+void StaticMeshBuffer::drawQueued(int i) const {
+  const DrawCommand& cmd = _commands[i];
+  glBindVertexArray(_vao);
+  glDrawElementsBaseVertex(GL_TRIANGLES, cmd.count, GL_UNSIGNED_INT,
+      (GLvoid*) (cmd.firstIndex * sizeof(GLuint)), cmd.baseVertex);
+  glBindVertexArray(0);
+}
+
+void StaticMeshBuffer::clear() {
+  _commands.clear();
+  _transforms.clear();
+}
+
+}  // namespace agl
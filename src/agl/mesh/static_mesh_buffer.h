@@ -0,0 +1,149 @@
+// Copyright, 2020, Savvy Sine, Aline Normoyle
+#ifndef AGL_MESH_STATIC_MESH_BUFFER_H_
+#define AGL_MESH_STATIC_MESH_BUFFER_H_
+
+#include <vector>
+#include "agl/agl.h"
+#include "agl/aglm.h"
+
+namespace agl {
+
+/**
+ * @brief Shared vertex and index storage for static meshes
+ *
+ * Static meshes are sub-allocated into one interleaved vertex buffer
+ * (position, normal, uv) and one index buffer. Each mesh is remembered by
+ * its (firstIndex, indexCount, baseVertex) range, so any number of meshes
+ * can be drawn without rebinding buffers or vertex arrays.
+ *
+ * Draws are queued with a model transform and submitted together. When the
+ * context supports GL 4.3 (ARB_multi_draw_indirect and
+ * ARB_shader_storage_buffer_object), the whole queue is drawn with a single
+ * glMultiDrawElementsIndirect call. Transforms are read by the vertex shader
+ * from a shader storage buffer (binding 0) indexed by the per-draw id
+ * attribute (location 5); see shaders/spotlight-static.vs. Otherwise,
+ * callers draw the queue one entry at a time with drawQueued().
+ *
+ * Typically, users do not use this class directly.
+ * @see Renderer::loadStaticMesh
+ * @see Renderer::staticMesh
+ */
+class StaticMeshBuffer {
+ public:
+  StaticMeshBuffer();
+  virtual ~StaticMeshBuffer();
+
+  /**
+   * @brief Query whether the current context can use glMultiDrawElementsIndirect
+   */
+  static bool multiDrawSupported();
+
+  /**
+   * @brief Copy a mesh into the shared buffers
+   * @param indices Triangle indices (relative to the mesh)
+   * @param points xyz positions
+   * @param normals xyz normals
+   * @param texCoords uv coordinates (optional)
+   * @return The id used to queue draws of this mesh, or -1 on error
+   */
+  int add(const std::vector<GLuint>& indices,
+      const std::vector<GLfloat>& points,
+      const std::vector<GLfloat>& normals,
+      const std::vector<GLfloat>* texCoords = nullptr);
+
+  /**
+   * @brief Queue a draw of mesh id with the given model transform
+   */
+  void queue(int id, const glm::mat4& model);
+
+  /**
+   * @brief Return true if no draws are queued
+   */
+  bool empty() const { return _commands.empty(); }
+
+  /**
+   * @brief Return the number of queued draws
+   */
+  int numQueued() const { return (int) _commands.size(); }
+
+  /**
+   * @brief Return the model transform of the i-th queued draw
+   */
+  const glm::mat4& queuedTransform(int i) const { return _transforms[i].model; }
+
+  /**
+   * @brief Return true if every mesh in the buffer has uv coordinates
+   */
+  bool hasUV() const { return _hasUV; }
+
+  /**
+   * @brief Draw the whole queue with one glMultiDrawElementsIndirect call
+   * @param view The view matrix, used to build per-draw normal matrices
+   *
+   * Requires multiDrawSupported(). The queue is cleared afterwards.
+   */
+  void drawIndirect(const glm::mat4& view);
+
+  /**
+   * @brief Draw the i-th queued draw with glDrawElementsBaseVertex
+   *
+   * Fallback for contexts without multi-draw indirect. The caller is
+   * responsible for setting the transform uniforms and calling clear().
+   */
+  void drawQueued(int i) const;
+
+  /**
+   * @brief Discard all queued draws
+   */
+  void clear();
+
+ private:
+  void initVao();
+  bool reserve(GLuint* buffer, GLsizeiptr* capacity,
+      GLsizeiptr used, GLsizeiptr needed);
+  void stream(GLenum target, GLuint buffer, GLsizeiptr* capacity,
+      const void* data, GLsizeiptr size);
+
+  // Layout of DrawElementsIndirectCommand (see glMultiDrawElementsIndirect)
+  struct DrawCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+  };
+
+  // std430 layout of an entry in the transform buffer
+  struct DrawTransform {
+    glm::mat4 model;
+    glm::mat4 normal;  // mat3 normal matrix, padded
+  };
+
+  struct Range {
+    GLuint firstIndex;
+    GLuint count;
+    GLint baseVertex;
+  };
+
+  std::vector<Range> _meshes;
+  std::vector<DrawCommand> _commands;
+  std::vector<DrawTransform> _transforms;
+  bool _hasUV;
+
+  GLuint _vao;
+  GLuint _vertexBuffer;
+  GLsizeiptr _vertexCapacity;
+  GLsizeiptr _vertexBytes;
+  GLuint _indexBuffer;
+  GLsizeiptr _indexCapacity;
+  GLsizeiptr _indexBytes;
+  GLuint _drawIdBuffer;
+  GLsizeiptr _drawIdCapacity;
+  GLuint _commandBuffer;
+  GLsizeiptr _commandCapacity;
+  GLuint _transformBuffer;
+  GLsizeiptr _transformCapacity;
+};
+
+}  // namespace agl
+#endif  // AGL_MESH_STATIC_MESH_BUFFER_H_
@@ -26,6 +26,11 @@ void TriangleMesh::initBuffers(
   _hasUV = (texCoords != nullptr);
   _nIndices = (GLuint)indices->size();
   _nVerts = points->size() / 3;  // assumes xyz positions
+  if (!_bounds.valid) _bounds = Bounds::compute(points->data(), _nVerts);
+  _gpuBytes = indices->size() * sizeof(GLuint) +
+      (points->size() + normals->size()) * sizeof(GLfloat);
+  if (texCoords != nullptr) _gpuBytes += texCoords->size() * sizeof(GLfloat);
+  if (tangents != nullptr) _gpuBytes += tangents->size() * sizeof(GLfloat);
 
   GLuint type = GL_STATIC_DRAW;
   if (_isDynamic) {
@@ -104,7 +109,7 @@ void TriangleMesh::initBuffers(
 }
 
 void TriangleMesh::render() const {
-  if (!_initialized) const_cast<TriangleMesh*>(this)->init();
+  if (!_initialized) const_cast<TriangleMesh*>(this)->upload();
   if (_vao == 0) return;
 
   glBindVertexArray(_vao);
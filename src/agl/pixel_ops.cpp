@@ -0,0 +1,124 @@
+// Copyright 2021, Savvy Sine, alinen
+
+#include "agl/pixel_ops.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace agl {
+
+void flipRows(const ImageView& image) {
+  int rowSize = 4 * image.width();
+  for (int y = 0; y < image.height() / 2; y++) {
+    unsigned char* a = image.row(y);
+    unsigned char* b = image.row(image.height() - 1 - y);
+    int i = 0;
+#ifdef AGL_SSE2
+    for (; i + 16 <= rowSize; i += 16) {
+      __m128i va = _mm_loadu_si128(reinterpret_cast<__m128i*>(a + i));
+      __m128i vb = _mm_loadu_si128(reinterpret_cast<__m128i*>(b + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(a + i), vb);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(b + i), va);
+    }
+#endif
+    std::swap_ranges(a + i, a + rowSize, b + i);
+  }
+}
+
+void copyPixels(const ConstImageView& src, const ImageView& dst) {
+  assert(src.width() == dst.width() && src.height() == dst.height());
+  if (src.stride() == dst.stride() && src.stride() == 4 * src.width()) {
+    memcpy(dst.data(), src.data(), src.stride() * src.height());
+    return;
+  }
+  for (int y = 0; y < src.height(); y++) {
+    memcpy(dst.row(y), src.row(y), 4 * src.width());
+  }
+}
+
+void downsample(const ConstImageView& src, const ImageView& dst) {
+  int w = src.width();
+  int h = src.height();
+  assert(dst.width() == std::max(1, w / 2));
+  assert(dst.height() == std::max(1, h / 2));
+
+  for (int y = 0; y < dst.height(); y++) {
+    const unsigned char* r0 = src.row(std::min(2 * y, h - 1));
+    const unsigned char* r1 = src.row(std::min(2 * y + 1, h - 1));
+    unsigned char* out = dst.row(y);
+    int x = 0;
+#ifdef AGL_SSE2
+    // two output pixels from a 4x2 block, summed in 16 bits
+    if (w >= 2) {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i two = _mm_set1_epi16(2);
+      for (; x + 2 <= dst.width(); x += 2) {
+        __m128i a = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(r0 + 8 * x));
+        __m128i b = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(r1 + 8 * x));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+            _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+            _mm_unpackhi_epi8(b, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        __m128i sum = _mm_unpacklo_epi64(lo, hi);
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * x),
+            _mm_packus_epi16(sum, zero));
+      }
+    }
+#endif
+    for (; x < dst.width(); x++) {
+      int x0 = std::min(2 * x, w - 1);
+      int x1 = std::min(2 * x + 1, w - 1);
+      for (int c = 0; c < 4; c++) {
+        int sum = r0[4 * x0 + c] + r0[4 * x1 + c] +
+            r1[4 * x0 + c] + r1[4 * x1 + c];
+        out[4 * x + c] = static_cast<unsigned char>((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+size_t countAlphaAtLeast(const ConstImageView& image,
+    unsigned char threshold) {
+  size_t count = 0;
+  for (int y = 0; y < image.height(); y++) {
+    const unsigned char* row = image.row(y);
+    int x = 0;
+#ifdef AGL_SSE2
+    const __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+    for (; x + 4 <= image.width(); x += 4) {
+      __m128i v = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(row + 4 * x));
+      // bytes >= threshold are unchanged by max
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v));
+      count += ((mask >> 3) & 1) + ((mask >> 7) & 1) +
+          ((mask >> 11) & 1) + ((mask >> 15) & 1);
+    }
+#endif
+    for (; x < image.width(); x++) {
+      if (row[4 * x + 3] >= threshold) count++;
+    }
+  }
+  return count;
+}
+
+void remapAlpha(const ImageView& image, const unsigned char table[256]) {
+  for (int y = 0; y < image.height(); y++) {
+    unsigned char* row = image.row(y);
+    for (int x = 0; x < image.width(); x++) {
+      row[4 * x + 3] = table[row[4 * x + 3]];
+    }
+  }
+}
+
+}  // namespace agl
@@ -0,0 +1,48 @@
+// Copyright 2021, Savvy Sine, alinen
+
+#ifndef AGL_PIXEL_OPS_H_
+#define AGL_PIXEL_OPS_H_
+
+#include <cstddef>
+#include "agl/image.h"
+
+namespace agl {
+
+/**
+ * @brief Bulk operations on RGBA pixels
+ *
+ * These replace per-pixel Image::get/set loops in loading code. They use
+ * SSE2 on x86 (always available on x86-64) and plain loops elsewhere, with
+ * identical results.
+ */
+
+/**
+ * @brief Flip the rows of a view in place
+ */
+void flipRows(const ImageView& image);
+
+/**
+ * @brief Copy the pixels of src into dst, which must be the same size
+ */
+void copyPixels(const ConstImageView& src, const ImageView& dst);
+
+/**
+ * @brief Box filter src into dst, which is max(1, w/2) x max(1, h/2)
+ *
+ * Each channel is the rounded average of a 2x2 block.
+ */
+void downsample(const ConstImageView& src, const ImageView& dst);
+
+/**
+ * @brief Return the number of pixels with alpha >= threshold
+ */
+size_t countAlphaAtLeast(const ConstImageView& image,
+    unsigned char threshold);
+
+/**
+ * @brief Replace every alpha a with table[a]
+ */
+void remapAlpha(const ImageView& image, const unsigned char table[256]);
+
+}  // namespace agl
+#endif  // AGL_PIXEL_OPS_H_
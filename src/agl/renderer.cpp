@@ -1,8 +1,12 @@
 // Copyright 2020, Savvy Sine, Aline Normoyle
 
 #include "agl/renderer.h"
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
+#include <iostream>
 #include <sstream>
+#include "agl/asset_loader.h"
 #include "agl/image.h"
 #include "agl/shader.h"
 #include "agl/mesh/sphere.h"
@@ -13,14 +17,19 @@
 #include "agl/mesh/torus.h"
 #include "agl/mesh/plane.h"
 #include "agl/mesh/skybox.h"
-#define FONTSTASH_IMPLEMENTATION
-#include "fontstash/fontstash.h"
-#define GLFONTSTASH_IMPLEMENTATION
-#include "fontstash/gl3corefontstash.h"
+#include "agl/mesh/static_mesh_buffer.h"
+#include "agl/sdf_font.h"
 
 namespace agl {
 
-static FONScontext* _fs = NULL;
+// the font atlas is always bound to this slot while text is drawn
+static const int FONT_TEXTURE_SLOT = 10;
+
+static unsigned int packRGBA(unsigned char r, unsigned char g,
+    unsigned char b, unsigned char a) {
+  return r | (g << 8) | (b << 16) | (static_cast<unsigned int>(a) << 24);
+}
+
 using glm::vec2;
 using glm::vec3;
 using glm::vec4;
@@ -32,20 +41,35 @@ using std::vector;
 
 int Renderer::PrimitiveSubdivision = 8;
 
+// Upload data to a streaming buffer, growing its storage geometrically so
+// that steady-state frames only orphan and refill the existing allocation
+static void streamBuffer(GLuint vbo, GLsizeiptr* capacity,
+    const void* data, GLsizeiptr size) {
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  if (size > *capacity) {
+    *capacity = std::max<GLsizeiptr>(size, *capacity * 2);
+  }
+  glBufferData(GL_ARRAY_BUFFER, *capacity, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+}
+
 Renderer::Renderer() {
-  _cube = 0;
-  _cone = 0;
-  _capsule = 0;
-  _cylinder = 0;
-  _teapot = 0;
-  _torus = 0;
-  _plane = 0;
-  _sphere = 0;
   _skybox = 0;
+  _flushingBatches = false;
+  _staticMeshes = 0;
+  _textureStreamer = 0;
   _blendMode = DEFAULT;
 
-  _fontNormal = FONS_INVALID;
-  _fs = NULL;
+  _font = 0;
+  _fontTexture = 0;
+  mVboTextId = 0;
+  mVaoTextId = 0;
+  mVboLineId = 0;
+  mVaoLineId = 0;
+  _lineVboSize = 0;
+  mVboSpriteId = 0;
+  mVaoSpriteId = 0;
+  _spriteVboSize = 0;
 
   _currentShader = 0;
   _initialized = false;
@@ -56,35 +80,59 @@ Renderer::~Renderer() {
 }
 
 void Renderer::cleanup() {
-  glfonsDelete(_fs);
-  _fs = NULL;
-  _fontNormal = FONS_INVALID;
-
-  delete _cube;
-  delete _cone;
-  delete _capsule;
-  delete _cylinder;
-  delete _teapot;
-  delete _torus;
-  delete _plane;
-  delete _sphere;
-  delete _skybox;
+  delete _font;
+  _font = 0;
+  if (_fontTexture != 0) {
+    glDeleteTextures(1, &_fontTexture);
+    _fontTexture = 0;
+  }
+  _textLayouts.clear();
+  _textBatch.clear();
+
+  for (auto it : _primitives) {
+    delete it.second;
+  }
+  _primitives.clear();
 
-  _cube = 0;
-  _cone = 0;
-  _capsule = 0;
-  _cylinder = 0;
-  _teapot = 0;
-  _torus = 0;
-  _plane = 0;
-  _sphere = 0;
+  delete _skybox;
   _skybox = 0;
 
+  delete _staticMeshes;
+  _staticMeshes = 0;
+
+  _residency.clear();
+  delete _textureStreamer;
+  _textureStreamer = 0;
+
   glDeleteBuffers(3, mBBVboIds);
-  glDeleteBuffers(2, mVboLineIds);
 
-  for (auto it : _shaders) {
-    delete it.second;
+  if (mVboLineId != 0) {
+    glDeleteBuffers(1, &mVboLineId);
+    glDeleteVertexArrays(1, &mVaoLineId);
+    mVboLineId = 0;
+    mVaoLineId = 0;
+    _lineVboSize = 0;
+  }
+
+  if (mVboSpriteId != 0) {
+    glDeleteBuffers(1, &mVboSpriteId);
+    glDeleteVertexArrays(1, &mVaoSpriteId);
+    mVboSpriteId = 0;
+    mVaoSpriteId = 0;
+    _spriteVboSize = 0;
+  }
+  _lineBatch.clear();
+  _spriteBatch.clear();
+
+  if (mVboTextId != 0) {
+    glDeleteBuffers(1, &mVboTextId);
+    glDeleteVertexArrays(1, &mVaoTextId);
+    mVboTextId = 0;
+    mVaoTextId = 0;
+  }
+
+  for (Shader* shader : _shaders) {
+    delete shader;
   }
   _shaders.clear();
   _textures.clear();
@@ -102,6 +150,7 @@ vec3 Renderer::cameraPosition() const {
 
 
 void Renderer::setDepthTest(bool b) {
+  flushBatches();
   if (b) glEnable(GL_DEPTH_TEST);
   else glDisable(GL_DEPTH_TEST);
 }
@@ -123,15 +172,6 @@ void Renderer::init() {
   loadShader("cubemap", "../shaders/cubemap.vs", "../shaders/cubemap.fs");
   loadShader("unlit", "../shaders/unlit.vs", "../shaders/unlit.fs");
 
-  _cube = new Cube(1.0f);
-  _cone = new Cylinder(0.5f, 0.01, 1, PrimitiveSubdivision);
-  _capsule = new Capsule(0.25, 0.5, PrimitiveSubdivision, PrimitiveSubdivision);
-  _cylinder = new Cylinder(0.5, 1.0, PrimitiveSubdivision);
-  _teapot = new Teapot(13, mat4(1.0));
-  _torus = new Torus(0.5, 0.25, PrimitiveSubdivision, PrimitiveSubdivision);
-  _plane = new Plane(1.0, 1.0, 1.0, 1.0);
-  _sphere = new Sphere(0.5f, PrimitiveSubdivision, PrimitiveSubdivision);
-  _skybox = new SkyBox(1);
   _trs = mat4(1.0);
   _initialized = true;
 
@@ -140,28 +180,21 @@ void Renderer::init() {
 
 void Renderer::initLines() {
   loadShader("lines", "../shaders/lines.vs", "../shaders/lines.fs");
-  const float positions[] = {
-    0.0f, 0.0f, 1.0f,
-    1.0f, 0.0f, 0.0f
-  };
-
-  glGenBuffers(2, mVboLineIds);
-  glBindBuffer(GL_ARRAY_BUFFER, mVboLineIds[0]);
-  glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(float), positions, GL_DYNAMIC_DRAW);
-
-  glBindBuffer(GL_ARRAY_BUFFER, mVboLineIds[1]);
-  glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(float), positions, GL_DYNAMIC_DRAW);
 
+  glGenBuffers(1, &mVboLineId);
   glGenVertexArrays(1, &mVaoLineId);
   glBindVertexArray(mVaoLineId);
+  glBindBuffer(GL_ARRAY_BUFFER, mVboLineId);
 
-  glEnableVertexAttribArray(0);  // 0 -> VertexPositions to array #0
-  glBindBuffer(GL_ARRAY_BUFFER, mVboLineIds[0]);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, static_cast<GLubyte*>(0));
+  GLsizei stride = sizeof(LineVertex);
+  glEnableVertexAttribArray(0);  // 0 -> VertexPositions
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<GLvoid*>(offsetof(LineVertex, pos)));
 
-  glEnableVertexAttribArray(1);  // 1 -> VertexPositions to array #1
-  glBindBuffer(GL_ARRAY_BUFFER, mVboLineIds[1]);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, static_cast<GLubyte*>(0));
+  glEnableVertexAttribArray(1);  // 1 -> VertexColors
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<GLvoid*>(offsetof(LineVertex, color)));
+  glBindVertexArray(0);
 }
 
 void Renderer::initBillboards() {
@@ -220,6 +253,32 @@ void Renderer::initBillboards() {
   glBindBuffer(GL_ARRAY_BUFFER, mBBVboIds[2]);  // bind before setting data
   glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, static_cast<GLubyte*>(0));
 
+  // Sprites reuse the quad corners and read per-instance attributes from a
+  // streaming buffer
+  glGenBuffers(1, &mVboSpriteId);
+  glGenVertexArrays(1, &mVaoSpriteId);
+  glBindVertexArray(mVaoSpriteId);
+
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, mBBVboIds[0]);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, static_cast<GLubyte*>(0));
+
+  GLsizei stride = sizeof(SpriteInstance);
+  glBindBuffer(GL_ARRAY_BUFFER, mVboSpriteId);
+  glEnableVertexAttribArray(1);  // offset
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<GLvoid*>(offsetof(SpriteInstance, offset)));
+  glVertexAttribDivisor(1, 1);
+  glEnableVertexAttribArray(2);  // color
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<GLvoid*>(offsetof(SpriteInstance, color)));
+  glVertexAttribDivisor(2, 1);
+  glEnableVertexAttribArray(3);  // size, rot
+  glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<GLvoid*>(offsetof(SpriteInstance, size)));
+  glVertexAttribDivisor(3, 1);
+  glBindVertexArray(0);
+
   loadShader("sprite",
       "../shaders/billboard.vs",
       "../shaders/billboard.fs");
@@ -227,21 +286,51 @@ void Renderer::initBillboards() {
 
 void Renderer::initText() {
     loadShader("text", "../shaders/text.vs", "../shaders/text.fs");
-    _fs = glfonsCreate(512, 512, FONS_ZERO_TOPLEFT);
-    if (_fs == NULL) {
-      printf("Could not create stash.\n");
-    }
 
-    _fontNormal = fonsAddFont(_fs, "sans", "../fonts/DroidSerif-Regular.ttf");
-    if (_fontNormal == FONS_INVALID) {
-      printf("Could not add font normal.\n");
+    // the atlas is read from its cache, so no glyph is rasterized here
+    _font = new SdfFont();
+    if (_font->load("../fonts/DroidSerif-Regular.ttf")) {
+      glGenTextures(1, &_fontTexture);
+      glActiveTexture(GL_TEXTURE0 + FONT_TEXTURE_SLOT);
+      glBindTexture(GL_TEXTURE_2D, _fontTexture);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, _font->width(), _font->height());
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _font->width(), _font->height(),
+          GL_RED, GL_UNSIGNED_BYTE, _font->pixels());
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      _font->release();
+    } else {
+      std::cout << "WARNING: Could not load font\n";
     }
 
-    _fontColor = glfonsRGBA(255, 255, 255, 255);
+    _fontColor = packRGBA(255, 255, 255, 255);
     _fontSize = 20.0;
+
+    // Batched glyph quads share one interleaved streaming buffer
+    glGenBuffers(1, &mVboTextId);
+    glGenVertexArrays(1, &mVaoTextId);
+    glBindVertexArray(mVaoTextId);
+    glBindBuffer(GL_ARRAY_BUFFER, mVboTextId);
+
+    GLsizei stride = sizeof(TextVertex);
+    glEnableVertexAttribArray(0);  // position
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+        reinterpret_cast<GLvoid*>(offsetof(TextVertex, x)));
+    glEnableVertexAttribArray(1);  // uv
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+        reinterpret_cast<GLvoid*>(offsetof(TextVertex, s)));
+    glEnableVertexAttribArray(2);  // color
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_FALSE, stride,
+        reinterpret_cast<GLvoid*>(offsetof(TextVertex, color)));
+    glBindVertexArray(0);
 }
 
 void Renderer::blendMode(BlendMode mode) {
+  flushBatches();
   if (mode == ADD) {
     _blendMode = ADD;
     glEnable(GL_BLEND);
@@ -286,27 +375,41 @@ void Renderer::blendMode(BlendMode mode) {
 
 void Renderer::perspective(float fovRadians,
     float aspect, float near, float far) {
+  flushBatches();
   _projectionMatrix = glm::perspective(fovRadians, aspect, near, far);
 }
 
 void Renderer::ortho(float minx, float maxx,
     float miny, float maxy, float minz, float maxz) {
+  flushBatches();
   _projectionMatrix = glm::ortho(minx, maxx, miny, maxy, minz, maxz);
 }
 
 void Renderer::lookAt(const vec3& lookfrom,
     const vec3& lookat, const vec3& up) {
+  flushBatches();
   _lookfrom = lookfrom;
   _viewMatrix = glm::lookAt(lookfrom, lookat, up);
 }
 
 void Renderer::texture(const std::string& uniformName,
     const std::string& textureName) {
-  assert(_textures.count(textureName) != 0);
+  assert(_textures.find(textureName).valid());
+  texture(uniformName, _textures.find(textureName));
+}
 
-  glActiveTexture(GL_TEXTURE0 + _textures[textureName].slot);
-  glBindTexture(GL_TEXTURE_2D, _textures[textureName].texId);
-  setUniform(uniformName, _textures[textureName].slot);
+void Renderer::texture(const std::string& uniformName, TextureId id) {
+  const Texture& tex = _textures[id];
+  flushBatches();
+  _residency.touch(id);
+
+  glActiveTexture(GL_TEXTURE0 + tex.slot);
+  glBindTexture(GL_TEXTURE_2D, tex.texId);
+  setUniform(uniformName, tex.slot);
+}
+
+TextureId Renderer::textureId(const std::string& name) {
+  return _textures.intern(name);
 }
 
 void Renderer::fontColor(const glm::vec4& c) {
@@ -314,7 +417,7 @@ void Renderer::fontColor(const glm::vec4& c) {
   unsigned char g = (unsigned char) (c[1]*255.9);
   unsigned char b = (unsigned char) (c[2]*255.9);
   unsigned char a = (unsigned char) (c[3]*255.9);
-  _fontColor = glfonsRGBA(r, g, b, a);
+  _fontColor = packRGBA(r, g, b, a);
 }
 
 void Renderer::fontSize(int s) {
@@ -322,33 +425,74 @@ void Renderer::fontSize(int s) {
 }
 
 float Renderer::textWidth(const std::string& s) {
-  float w = fonsTextBounds(_fs, 0, 0, s.c_str(), NULL, NULL);
-  return w;
+  if (!_font || !_font->valid()) return 0.0f;
+  return _font->textWidth(s, _fontSize);
 }
 
 float Renderer::textHeight() {
-  float lineh = 0;
-  fonsVertMetrics(_fs, NULL, NULL, &lineh);
-  return lineh;
+  if (!_font || !_font->valid()) return 0.0f;
+  return _font->lineHeight(_fontSize);
+}
+
+const std::vector<float>& Renderer::textLayout(const std::string& text) {
+  // the atlas never changes, so layouts only need a bound on their number
+  if (_textLayouts.size() > 256) _textLayouts.clear();
+
+  TextKey key(text, static_cast<int>(_fontSize * 10.0f));
+  auto it = _textLayouts.find(key);
+  if (it != _textLayouts.end()) return it->second;
+
+  std::vector<float>& quads = _textLayouts[key];
+  if (_font && _font->valid()) _font->layout(text, _fontSize, &quads);
+  return quads;
 }
 
 void Renderer::text(const std::string& text, float x, float y) {
-  float viewport[4]; 
-  glGetFloatv(GL_VIEWPORT, viewport);
+  const std::vector<float>& quads = textLayout(text);
+  for (size_t i = 0; i < quads.size(); i += 8) {
+    float x0 = quads[i + 0] + x, y0 = quads[i + 1] + y;
+    float s0 = quads[i + 2], t0 = quads[i + 3];
+    float x1 = quads[i + 4] + x, y1 = quads[i + 5] + y;
+    float s1 = quads[i + 6], t1 = quads[i + 7];
+
+    _textBatch.push_back(TextVertex{x0, y0, s0, t0, _fontColor});
+    _textBatch.push_back(TextVertex{x1, y1, s1, t1, _fontColor});
+    _textBatch.push_back(TextVertex{x1, y0, s1, t0, _fontColor});
+
+    _textBatch.push_back(TextVertex{x0, y0, s0, t0, _fontColor});
+    _textBatch.push_back(TextVertex{x0, y1, s0, t1, _fontColor});
+    _textBatch.push_back(TextVertex{x1, y1, s1, t1, _fontColor});
+  }
+}
+
+void Renderer::flushText() {
+  if (_textBatch.empty()) return;
 
+  float viewport[4];
+  glGetFloatv(GL_VIEWPORT, viewport);
   mat4 ortho = glm::ortho(0.0f, viewport[2], viewport[3], 0.0f, -100.0f, 100.0f);
+
   BlendMode m = _blendMode;
+  GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
   blendMode(BLEND);
+  glDisable(GL_DEPTH_TEST);
   beginShader("text");
   setUniform("MVP", ortho);
+  setUniform("fontTexture", FONT_TEXTURE_SLOT);
+
+  glActiveTexture(GL_TEXTURE0 + FONT_TEXTURE_SLOT);
+  glBindTexture(GL_TEXTURE_2D, _fontTexture);
 
-  fonsSetSize(_fs, _fontSize);
-  fonsSetFont(_fs, _fontNormal);
-  fonsSetColor(_fs, _fontColor);
-  fonsDrawText(_fs, x, y, text.c_str(), NULL);
-  //std::cout << viewport[2] << " " << viewport[3] << std::endl;
+  glBindVertexArray(mVaoTextId);
+  glBindBuffer(GL_ARRAY_BUFFER, mVboTextId);
+  glBufferData(GL_ARRAY_BUFFER, _textBatch.size() * sizeof(TextVertex),
+      _textBatch.data(), GL_STREAM_DRAW);
+  glDrawArrays(GL_TRIANGLES, 0, (GLsizei) _textBatch.size());
+  glBindVertexArray(0);
+  _textBatch.clear();
 
   endShader();
+  if (depthTest) glEnable(GL_DEPTH_TEST);
   blendMode(m);
 }
 
@@ -356,33 +500,8 @@ void Renderer::line(const glm::vec3& p1, const glm::vec3& p2,
     const glm::vec3& c1, const glm::vec3& c2) {
   assert(_initialized);
 
-  mat4 mvp = _projectionMatrix * _viewMatrix * _trs;
-  setUniform("MVP", mvp);
-
-  GLfloat positions[6];
-  positions[0] = p1.x;
-  positions[1] = p1.y;
-  positions[2] = p1.z;
-  positions[3] = p2.x;
-  positions[4] = p2.y;
-  positions[5] = p2.z;
-
-  GLfloat colors[6];
-  colors[0] = c1.x;
-  colors[1] = c1.y;
-  colors[2] = c1.z;
-  colors[3] = c2.x;
-  colors[4] = c2.y;
-  colors[5] = c2.z;
-
-  glBindVertexArray(mVaoLineId);
-  glBindBuffer(GL_ARRAY_BUFFER, mVboLineIds[0]);
-  glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(float), positions, GL_DYNAMIC_DRAW);
-
-  glBindBuffer(GL_ARRAY_BUFFER, mVboLineIds[1]);
-  glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(float), colors, GL_DYNAMIC_DRAW);
-
-  glDrawArrays(GL_LINES, 0, 2);
+  _lineBatch.push_back(LineVertex{vec3(_trs * vec4(p1, 1.0f)), c1});
+  _lineBatch.push_back(LineVertex{vec3(_trs * vec4(p2, 1.0f)), c2});
 }
 
 void Renderer::quad() {
@@ -397,34 +516,131 @@ void Renderer::quad() {
   setUniform("NormalMatrix", nmv);
   setUniform("ModelMatrix", _trs);
   setUniform("HasUV", true);
+  setUniform("Billboard", false);
 
   glBindVertexArray(mBBVaoId);
   glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
+void Renderer::billboard(const glm::vec3& pivot, const glm::vec2& size,
+    const glm::vec3& offset, const glm::vec3& axis) {
+  assert(_initialized);
+
+  // local transform: center the unit quad on offset and scale it
+  mat4 local(1.0f);
+  local[0][0] = size.x;
+  local[1][1] = size.y;
+  local[3] = vec4(offset.x - 0.5f * size.x, offset.y - 0.5f * size.y,
+      offset.z, 1.0f);
+
+  setUniform("MVP", _projectionMatrix * _viewMatrix);
+  setUniform("ModelViewMatrix", _viewMatrix);
+  setUniform("NormalMatrix", mat3(_viewMatrix));
+  setUniform("ModelMatrix", local);
+  setUniform("HasUV", true);
+  setUniform("Billboard", true);
+  setUniform("BillboardPivot", pivot);
+  setUniform("BillboardAxis", axis);
+  setUniform("CameraPos", _lookfrom);
+
+  glBindVertexArray(mBBVaoId);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void Renderer::billboard(const Mesh& mesh, const glm::vec3& pivot,
+    const glm::vec3& axis) {
+  assert(_initialized);
+
+  setUniform("MVP", _projectionMatrix * _viewMatrix);
+  setUniform("ModelViewMatrix", _viewMatrix);
+  setUniform("NormalMatrix", mat3(_viewMatrix));
+  setUniform("ModelMatrix", _trs);
+  setUniform("HasUV", mesh.hasUV());
+  setUniform("Billboard", true);
+  setUniform("BillboardPivot", pivot);
+  setUniform("BillboardAxis", axis);
+  setUniform("CameraPos", _lookfrom);
+
+  mesh.render();
+}
+
 
 void Renderer::sprite(const glm::vec3& pos,
     const glm::vec4& color, float size, float rot) {
   assert(_initialized);
 
-  mat4 mvp = _projectionMatrix * _viewMatrix * _trs;
+  vec3 offset = vec3(_trs * vec4(pos, 1.0f));
+  _spriteBatch.push_back(SpriteInstance{offset, color, size, rot});
+}
+
+void Renderer::flushBatches() {
+  bool hasStatic = _staticMeshes && !_staticMeshes->empty();
+  if (_lineBatch.empty() && _spriteBatch.empty() && !hasStatic) return;
+  assert(_currentShader != nullptr);
+  _flushingBatches = true;  // the uniforms set below belong to the batches
+
+  // Batched positions are already in world space
+  mat4 mvp = _projectionMatrix * _viewMatrix;
   setUniform("MVP", mvp);
-  setUniform("CameraPos", _lookfrom);
-  setUniform("Offset", pos);
-  setUniform("Color", color);
-  setUniform("Size", size);
-  setUniform("Rot", rot);
 
-  glBindVertexArray(mBBVaoId);
-  glDrawArrays(GL_TRIANGLES, 0, 6);
+  if (!_lineBatch.empty()) {
+    streamBuffer(mVboLineId, &_lineVboSize, _lineBatch.data(),
+        _lineBatch.size() * sizeof(LineVertex));
+    glBindVertexArray(mVaoLineId);
+    glDrawArrays(GL_LINES, 0, (GLsizei) _lineBatch.size());
+    _lineBatch.clear();
+  }
+
+  if (!_spriteBatch.empty()) {
+    setUniform("CameraPos", _lookfrom);
+    streamBuffer(mVboSpriteId, &_spriteVboSize, _spriteBatch.data(),
+        _spriteBatch.size() * sizeof(SpriteInstance));
+    glBindVertexArray(mVaoSpriteId);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei) _spriteBatch.size());
+    _spriteBatch.clear();
+  }
+  glBindVertexArray(0);
+
+  if (hasStatic) {
+    setUniform("HasUV", _staticMeshes->hasUV());
+    setUniform("Billboard", false);
+
+    // Only shaders that read the per-draw transforms (see
+    // shaders/spotlight-static.vs) can draw the queue in one call
+    if (StaticMeshBuffer::multiDrawSupported() &&
+        _currentShader->hasStorageBlock("StaticDraws")) {
+      // Per-draw model and normal matrices come from the storage buffer
+      setUniform("ModelViewMatrix", _viewMatrix);
+      _staticMeshes->drawIndirect(_viewMatrix);
+
+    } else {
+      for (int i = 0; i < _staticMeshes->numQueued(); i++) {
+        const mat4& model = _staticMeshes->queuedTransform(i);
+        mat4 mv = _viewMatrix * model;
+        setUniform("MVP", _projectionMatrix * mv);
+        setUniform("ModelViewMatrix", mv);
+        setUniform("NormalMatrix", transpose(inverse(mat3(mv))));
+        setUniform("ModelMatrix", model);
+        _staticMeshes->drawQueued(i);
+      }
+      _staticMeshes->clear();
+    }
+  }
+  _flushingBatches = false;
 }
 
 void Renderer::cubemap(const std::string& uniformName,
     const std::string& textureName) {
-  assert(_textures.count(textureName) != 0);
+  assert(_textures.find(textureName).valid());
+  cubemap(uniformName, _textures.find(textureName));
+}
 
-  glBindTexture(GL_TEXTURE_CUBE_MAP, _textures[textureName].texId);
-  setUniform(uniformName, _textures[textureName].slot);
+void Renderer::cubemap(const std::string& uniformName, TextureId id) {
+  const Texture& tex = _textures[id];
+  flushBatches();
+
+  glBindTexture(GL_TEXTURE_CUBE_MAP, tex.texId);
+  setUniform(uniformName, tex.slot);
 }
 
 void Renderer::skybox(float size) {
@@ -433,6 +649,7 @@ void Renderer::skybox(float size) {
   mat4 s = glm::scale(mat4(1.0f), vec3(size));
   mat4 mvp = _projectionMatrix * _viewMatrix * s;
   setUniform("MVP", mvp);
+  if (!_skybox) _skybox = new SkyBox(1);
   _skybox->render();
 }
 
@@ -470,36 +687,83 @@ void Renderer::transform(const glm::mat4& trs) {
   _trs = _trs * trs;
 }
 
+const Mesh& Renderer::primitive(Primitive type, int subdivisions) {
+  auto key = std::make_pair(static_cast<int>(type), subdivisions);
+  auto it = _primitives.find(key);
+  if (it != _primitives.end()) return *(it->second);
+
+  // Construction only stores parameters; vertex data and GL buffers are
+  // created by TriangleMesh::init() the first time the mesh is rendered
+  Mesh* m = 0;
+  int n = subdivisions;
+  switch (type) {
+    case CUBE: m = new Cube(1.0f); break;
+    case CONE: m = new Cylinder(0.5f, 0.01, 1, n); break;
+    case CAPSULE: m = new Capsule(0.25, 0.5, n, n); break;
+    case CYLINDER: m = new Cylinder(0.5, 1.0, n); break;
+    case TEAPOT: m = new Teapot(n, mat4(1.0)); break;
+    case TORUS: m = new Torus(0.5, 0.25, n, n); break;
+    case PLANE: m = new Plane(1.0, 1.0, 1.0, 1.0); break;
+    case SPHERE: m = new Sphere(0.5f, n, n); break;
+  }
+  _primitives[key] = m;
+  return *m;
+}
+
 void Renderer::teapot() {
-  mesh(*_teapot);
+  teapot(13);
+}
+
+void Renderer::teapot(int subdivisions) {
+  mesh(primitive(TEAPOT, subdivisions));
 }
 
 void Renderer::plane() {
-  mesh(*_plane);
+  mesh(primitive(PLANE, 0));
 }
 
 void Renderer::cylinder() {
-  mesh(*_cylinder);
+  cylinder(PrimitiveSubdivision);
+}
+
+void Renderer::cylinder(int subdivisions) {
+  mesh(primitive(CYLINDER, subdivisions));
 }
 
 void Renderer::capsule() {
-  mesh(*_capsule);
+  capsule(PrimitiveSubdivision);
+}
+
+void Renderer::capsule(int subdivisions) {
+  mesh(primitive(CAPSULE, subdivisions));
 }
 
 void Renderer::torus() {
-  mesh(*_torus);
+  torus(PrimitiveSubdivision);
+}
+
+void Renderer::torus(int subdivisions) {
+  mesh(primitive(TORUS, subdivisions));
 }
 
 void Renderer::cone() {
-  mesh(*_cone);
+  cone(PrimitiveSubdivision);
+}
+
+void Renderer::cone(int subdivisions) {
+  mesh(primitive(CONE, subdivisions));
 }
 
 void Renderer::cube() {
-  mesh(*_cube);
+  mesh(primitive(CUBE, 0));
 }
 
 void Renderer::sphere() {
-  mesh(*_sphere);
+  sphere(PrimitiveSubdivision);
+}
+
+void Renderer::sphere(int subdivisions) {
+  mesh(primitive(SPHERE, subdivisions));
 }
 
 void Renderer::mesh(const Mesh& mesh) {
@@ -514,10 +778,25 @@ void Renderer::mesh(const Mesh& mesh) {
   setUniform("NormalMatrix", nmv);
   setUniform("ModelMatrix", _trs);
   setUniform("HasUV", mesh.hasUV());
+  setUniform("Billboard", false);
 
   mesh.render();
 }
 
+int Renderer::loadStaticMesh(const std::vector<GLuint>& indices,
+    const std::vector<GLfloat>& points,
+    const std::vector<GLfloat>& normals,
+    const std::vector<GLfloat>* texCoords) {
+  assert(_initialized);
+  if (!_staticMeshes) _staticMeshes = new StaticMeshBuffer();
+  return _staticMeshes->add(indices, points, normals, texCoords);
+}
+
+void Renderer::staticMesh(int id) {
+  assert(_initialized && _staticMeshes);
+  _staticMeshes->queue(id, _trs);
+}
+
 void Renderer::cleanupShaders() {
   while (_shaderStack.size() > 1) {
     endShader();
@@ -525,15 +804,26 @@ void Renderer::cleanupShaders() {
 }
 
 void Renderer::beginShader(const std::string& shaderName) {
-  assert(_shaders.count(shaderName) != 0);
+  assert(_shaders.find(shaderName).valid());
+  beginShader(_shaders.find(shaderName));
+}
+
+void Renderer::beginShader(ShaderId id) {
+  assert(_shaders[id] != nullptr);
+  flushBatches();  // queued primitives belong to the previous shader
 
   _shaderStack.push_front(_currentShader);
-  _currentShader = _shaders[shaderName];
+  _currentShader = _shaders[id];
   _currentShader->use();
 }
 
+ShaderId Renderer::shaderId(const std::string& name) {
+  return _shaders.intern(name);
+}
+
 void Renderer::endShader() {
   assert(_shaderStack.size() > 0);
+  flushBatches();
 
   _currentShader = _shaderStack.front();
   _shaderStack.pop_front();
@@ -548,67 +838,79 @@ void Renderer::endShader() {
 
 void Renderer::setUniform(const std::string& name, float x, float y, float z) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), x, y, z);
 }
 
 void Renderer::setUniform(const std::string& name,
     float x, float y, float z, float w) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), glm::vec4(x, y, z, w));
 }
 
 void Renderer::setUniform(const std::string& name, const glm::vec2 &v) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), v);
 }
 
 void Renderer::setUniform(const std::string& name, const glm::vec3 &v) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), v);
 }
 
 void Renderer::setUniform(const std::string& name, const glm::vec4 &v) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), v);
 }
 
 void Renderer::setUniform(const std::string& name, const glm::mat4 &m) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), m);
 }
 
 void Renderer::setUniform(const std::string& name, const glm::mat3 &m) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), m);
 }
 
 void Renderer::setUniform(const std::string& name, 
   const std::vector<glm::mat4> &ms) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), ms);
 }
 
 void Renderer::setUniform(const std::string& name, float val) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), val);
 }
 
 void Renderer::setUniform(const std::string& name, int val) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), val);
 }
 
 void Renderer::setUniform(const std::string& name, bool val) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), val);
 }
 
 void Renderer::setUniform(const std::string& name, GLuint val) {
   assert(_currentShader != nullptr);
+  if (!_flushingBatches) flushBatches();  // queued primitives keep their uniforms
   _currentShader->setUniform(name.c_str(), val);
 }
 
-void Renderer::loadCubemap(const std::string& name,
+TextureId Renderer::loadCubemap(const std::string& name,
     const string& dir, int slot) {
   vector<string> faces = {
       dir + "/right.png",
@@ -618,38 +920,36 @@ void Renderer::loadCubemap(const std::string& name,
       dir + "/back.png",
       dir + "/front.png",
   };
-  loadCubemap(name, faces, slot);
+  return loadCubemap(name, faces, slot);
 }
 
-void Renderer::loadCubemap(const std::string& name,
+TextureId Renderer::loadCubemap(const std::string& name,
     const vector<string>& faces, int slot) {
-  vector<Image> images;
-  for (string filename : faces) {
-      Image img;
-      img.load(filename);
-      images.push_back(img);
+  // decode the faces in parallel, the upload happens on this thread
+  vector<Image> images(faces.size());
+  AssetLoader loader(static_cast<int>(faces.size()));
+  for (size_t i = 0; i < faces.size(); i++) {
+    loader.add([&images, &faces, i]() { images[i].load(faces[i]); });
   }
-  loadCubemap(name, images, slot);
+  loader.wait();
+  return loadCubemap(name, images, slot);
 }
 
-void Renderer::loadCubemap(const std::string& name,
+TextureId Renderer::loadCubemap(const std::string& name,
     const vector<Image>& faces, int slot) {
-  if (slot == GLFONS_FONT_TEXTURE_SLOT) {
+  if (slot == FONT_TEXTURE_SLOT) {
     std::cout << "WARNING: slot " << slot << " conflicts with font texture\n";
   }
   glEnable(GL_TEXTURE0 + slot);
   glActiveTexture(GL_TEXTURE0 + slot);
 
-  GLuint texId;
-  if (_textures.count(name) == 0) {
-    glGenTextures(1, &texId);
-    Texture tex{texId, slot};
-    _textures[name] = tex;
-
-  } else {
-    texId = _textures[name].texId;
+  TextureId id = _textures.intern(name);
+  Texture& tex = _textures[id];
+  if (tex.texId == 0) {
+    glGenTextures(1, &tex.texId);
+    tex.slot = slot;
   }
-  glBindTexture(GL_TEXTURE_CUBE_MAP, texId);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, tex.texId);
 
   GLuint targets[] = {
     GL_TEXTURE_CUBE_MAP_POSITIVE_X,
@@ -666,48 +966,130 @@ void Renderer::loadCubemap(const std::string& name,
         0, GL_RGBA, GL_UNSIGNED_BYTE, faces[i].data());
     }
   }
+  size_t bytes = 0;
+  for (const Image& face : faces) {
+    bytes += textureLevelSize(TEXTURE_RGBA8, face.width(), face.height());
+  }
+  _residency.add(id, tex.texId, bytes);
+
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  return id;
 }
 
-void Renderer::loadTexture(const std::string& name,
+TextureId Renderer::loadTexture(const std::string& name,
     const std::string& fileName, int slot) {
-  Image img;
-  img.load(fileName);
-  loadTexture(name, img, slot);
+  CachedTexture tex;
+  if (!tex.load(fileName)) {
+    std::cout << "WARNING: cannot load texture " << fileName << std::endl;
+    return _textures.intern(name);
+  }
+  return loadTexture(name, tex, slot);
 }
 
-void Renderer::loadTexture(const std::string& name,
-    const Image& image, int slot) {
-  if (slot == GLFONS_FONT_TEXTURE_SLOT) {
+GLuint Renderer::registerTexture(TextureId id, int slot) {
+  if (slot == FONT_TEXTURE_SLOT) {
     std::cout << "WARNING: slot " << slot << " conflicts with font texture\n";
   }
   glEnable(GL_TEXTURE0 + slot);
   glActiveTexture(GL_TEXTURE0 + slot);
 
-  GLuint texId;
-  if (_textures.count(name) == 0) {
-    glGenTextures(1, &texId);
-    _textures[name] = Texture{texId, slot};
-  } else {
-    //std::cout << "Warning: texture already registered with name: " << 
-        //name << std::endl;
-    texId = _textures[name].texId;
+  // texture storage is immutable, so reloading a name needs a new texture
+  Texture& tex = _textures[id];
+  if (tex.texId != 0) {
+    glDeleteTextures(1, &tex.texId);
   }
+  glGenTextures(1, &tex.texId);
+  tex.slot = slot;
 
-  glBindTexture(GL_TEXTURE_2D, texId);
+  glBindTexture(GL_TEXTURE_2D, tex.texId);
+  return tex.texId;
+}
+
+TextureId Renderer::loadTexture(const std::string& name,
+    const Image& image, int slot) {
+  TextureId id = _textures.intern(name);
+  GLuint texId = registerTexture(id, slot);
   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, image.width(), image.height());
   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width(), image.height(),
       GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+  _residency.add(id, texId,
+      textureLevelSize(TEXTURE_RGBA8, image.width(), image.height()));
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  return id;
 }
 
-void Renderer::loadShader(const std::string& name,
+TextureId Renderer::loadTexture(const std::string& name,
+    const CachedTexture& tex, int slot) {
+  assert(tex.loaded());
+  if (!isTextureFormatSupported(tex.format())) {
+    CachedTexture decoded = tex;
+    decoded.decompress();
+    return loadTexture(name, decoded, slot);
+  }
+
+  TextureId id = _textures.intern(name);
+  GLuint texId = registerTexture(id, slot);
+  allocateTextureStorage(tex);
+  for (int level = 0; level < tex.numLevels(); level++) {
+    uploadTextureLevel(tex, level, tex.levelData(level));
+  }
+  _residency.add(id, texId, slot, tex);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+      tex.numLevels() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  return id;
+}
+
+TextureHandle Renderer::streamTexture(const std::string& name,
+    const std::string& fileName, int slot, bool flip, bool compress) {
+  // names may be reserved by textureId() beforehand, but not loaded
+  TextureId id = _textures.intern(name);
+  if (_textures[id].texId != 0) {
+    std::cout << "WARNING: texture already registered with name: " <<
+        name << std::endl;
+    return TextureHandle();
+  }
+
+  // storage is allocated once the size is known
+  GLuint texId = registerTexture(id, slot);
+  if (!_textureStreamer) _textureStreamer = new TextureStreamer();
+  TextureHandle handle = _textureStreamer->request(texId, slot, fileName,
+      flip, compress);
+  _residency.add(id, texId, slot, fileName, flip, compress, handle);
+  return handle;
+}
+
+void Renderer::updateTextures() {
+  if (_textureStreamer) _textureStreamer->update();
+
+  // reloads go through the streamer, so it is only needed once a texture
+  // can be reloaded
+  if (_residency.hasReloadable()) {
+    if (!_textureStreamer) _textureStreamer = new TextureStreamer();
+    std::vector<TextureResidency::Swap> swaps;
+    _residency.update(*_textureStreamer, &swaps);
+    for (const TextureResidency::Swap& swap : swaps) {
+      _textures[swap.id].texId = swap.texId;
+    }
+  }
+}
+
+void Renderer::setTextureBudget(size_t bytes) {
+  _residency.setBudget(bytes);
+}
+
+size_t Renderer::textureBytes() const {
+  return _residency.residentBytes();
+}
+
+ShaderId Renderer::loadShader(const std::string& name,
     const std::string& vs, const std::string& fs) {
 
   Shader* shader = new Shader();
@@ -721,40 +1103,56 @@ void Renderer::loadShader(const std::string& name,
   shader->link();
   //std::cout << "Loaded shader: " << name << std::endl;
 
-  _shaders[name] = shader;
+  ShaderId id = _shaders.intern(name);
+  delete _shaders[id];
+  _shaders[id] = shader;
+  return id;
+}
+
+RenderTargetId Renderer::renderTargetId(const std::string& name) {
+  return _renderTextures.intern(name);
 }
 
 void Renderer::beginRenderTexture(const std::string& targetName) {
-  assert(_renderTextures.count(targetName) != 0);
-  assert(_activeRenderTexture == "");
+  assert(_renderTextures.find(targetName).valid());
+  beginRenderTexture(_renderTextures.find(targetName));
+}
+
+void Renderer::beginRenderTexture(RenderTargetId target) {
+  assert(_renderTextures[target].loaded);
+  assert(!_activeRenderTexture.valid());
+  flushBatches();
+  flushText();  // queued text belongs to the screen
 
-  RenderTexture& tex = _renderTextures[targetName];
+  RenderTexture& tex = _renderTextures[target];
   glBindFramebuffer(GL_FRAMEBUFFER, tex.handleId);
 
   // Cache viewport size so it can be restored later
   glGetIntegerv(GL_VIEWPORT, tex.winProps);
   glViewport(0, 0, tex.width, tex.height);
-  _activeRenderTexture = targetName;
+  _activeRenderTexture = target;
 }
 
 void Renderer::endRenderTexture() {
-  assert(_activeRenderTexture.size() != 0);
+  assert(_activeRenderTexture.valid());
+  flushBatches();
+  flushText();  // queued text belongs to the render target
   glFlush();
 
   // unbind fbo and revert to default (the screen)
-  RenderTexture target = _renderTextures[_activeRenderTexture];
+  const RenderTexture& target = _renderTextures[_activeRenderTexture];
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
   glViewport(target.winProps[0],
              target.winProps[1],
              target.winProps[2],
              target.winProps[3]);
 
-  _activeRenderTexture = "";
+  _activeRenderTexture = RenderTargetId();
 }
 
-void Renderer::loadRenderTexture(const std::string& name,
+RenderTargetId Renderer::loadRenderTexture(const std::string& name,
     int slot, int width, int height) {
-  if (slot == GLFONS_FONT_TEXTURE_SLOT) {
+  if (slot == FONT_TEXTURE_SLOT) {
     std::cout << "WARNING: slot " << slot << " conflicts with font texture\n";
   }
   // Generate and bind the framebuffer
@@ -773,7 +1171,10 @@ void Renderer::loadRenderTexture(const std::string& name,
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
   // save texture as an available texture object with the same name
-  _textures[name] = Texture{renderTex, slot};
+  TextureId texture = _textures.intern(name);
+  _textures[texture] = Texture{renderTex, slot};
+  _residency.add(texture, renderTex,
+      textureLevelSize(TEXTURE_RGBA8, width, height));
 
   // Bind the texture to the FBO
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
@@ -798,17 +1199,19 @@ void Renderer::loadRenderTexture(const std::string& name,
     std::cout << "Framebuffer error: " << result << std::endl;
   }
 
-  RenderTexture target;
+  RenderTargetId id = _renderTextures.intern(name);
+  RenderTexture& target = _renderTextures[id];
+  target.loaded = true;
   target.handleId = fboHandle;
   target.textureId = renderTex;
   target.depthId = depthBuf;
   target.slot = slot;
   target.width = width;
   target.height = height;
-  _renderTextures[name] = target;
 
   // unbind fbo and revert to default (the screen)
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return id;
 }
 
 
@@ -7,10 +7,15 @@
 #include <list>
 #include <string>
 #include <map>
+#include <utility>
 #include "agl/agl.h"
 #include "agl/aglm.h"
+#include "agl/cached_texture.h"
 #include "agl/image.h"
 #include "agl/mesh.h"
+#include "agl/resource_registry.h"
+#include "agl/texture_residency.h"
+#include "agl/texture_streamer.h"
 
 namespace agl {
 
@@ -177,11 +182,20 @@ class Renderer {
    * renderer automatically loads shaders for "phong", "sprites", and
    * "cubemap". Paths are relative to the directory from which you run your
    * application.
+   * @return The id of the shader, for use with beginShader(ShaderId)
    * @see beginShader
    */
-  void loadShader(const std::string& name,
+  ShaderId loadShader(const std::string& name,
       const std::string& vs, const std::string& fs);
 
+  /**
+   * @brief Return the id of a shader name
+   *
+   * The name is reserved if the shader is not loaded yet; it must be loaded
+   * before the id is used for drawing.
+   */
+  ShaderId shaderId(const std::string& name);
+
   /**
    * @brief Set active shader to use for rendering.
    *
@@ -200,6 +214,14 @@ class Renderer {
    */
   void beginShader(const std::string& shaderName);
 
+  /**
+   * @brief Set active shader by id, without looking up its name
+   *
+   * @see beginShader(const std::string&)
+   * @see shaderId
+   */
+  void beginShader(ShaderId shader);
+
   /**
    * @brief Clear active shader to use for rendering.
    *
@@ -220,6 +242,14 @@ class Renderer {
    */
   void beginRenderTexture(const std::string& targetName);
 
+  /**
+   * @brief Render to the texture target with the given id
+   *
+   * @see beginRenderTexture(const std::string&)
+   * @see renderTargetId
+   */
+  void beginRenderTexture(RenderTargetId target);
+
   /**
    * @brief Revert to rendering to the screen
    *
@@ -237,13 +267,23 @@ class Renderer {
    * @width The width in pixels of the rendered texture
    * @height The height in pixels of the rendered texture
    *
+   * @return The id of the target. The rendered texture has the same name,
+   * see textureId().
    * @see beginRenderTexture
    * @see endRenderTexture
    * @verbinclude render_texture.cpp
    */
-  void loadRenderTexture(const std::string& name, int slot,
+  RenderTargetId loadRenderTexture(const std::string& name, int slot,
       int width, int height);
 
+  /**
+   * @brief Return the id of a render target name
+   *
+   * The name is reserved if the target is not loaded yet; it must be loaded
+   * before the id is used.
+   */
+  RenderTargetId renderTargetId(const std::string& name);
+
   /**
    * @brief Clear all active shaders
    *
@@ -331,6 +371,15 @@ class Renderer {
    */
   void texture(const std::string& uniformName, const std::string& textureName);
 
+  /**
+   * @brief Set a uniform sampler parameter to the texture with the given id
+   *
+   * Prefer this version in draw loops, the texture is found by index instead
+   * of by name.
+   * @see textureId
+   */
+  void texture(const std::string& uniformName, TextureId texture);
+
   /**
    * @brief Set a uniform sampler parameter in the currently active shader
    *
@@ -343,6 +392,21 @@ class Renderer {
    */
   void cubemap(const std::string& uniformName, const std::string& texName);
 
+  /**
+   * @brief Set a uniform sampler parameter to the cubemap with the given id
+   */
+  void cubemap(const std::string& uniformName, TextureId texture);
+
+  /**
+   * @brief Return the id of a texture name
+   *
+   * Names are interned once, so items can store the id when they are created
+   * (even before the texture is loaded) and draw with texture(const
+   * std::string&, TextureId). The id stays the same when the texture is
+   * reloaded. Textures that are not loaded yet sample as black.
+   */
+  TextureId textureId(const std::string& name);
+
   /** @name Loading textures
    * @brief Textures should typically be loaded from setup()
    */
@@ -350,31 +414,85 @@ class Renderer {
   /**
    * @brief Load a texture from a file
    *
+   * The image is read through its texture cache, so it is only decoded the
+   * first time (or when it changes) and its mip levels are prebuilt.
+   * @return The id of the texture, see textureId()
+   * @see CachedTexture
    * @verbinclude sprites.cpp
    */
-  void loadTexture(const std::string& name,
+  TextureId loadTexture(const std::string& name,
       const std::string& filename, int slot);
 
   /**
    * @brief Load a texture from an Image
    */
-  void loadTexture(const std::string& name, const Image& img, int slot);
+  TextureId loadTexture(const std::string& name, const Image& img, int slot);
+
+  /**
+   * @brief Load a texture and its mip levels from a texture cache
+   *
+   * Block compressed levels are uploaded as they are, or decompressed first
+   * if the GPU cannot sample their format (see isTextureFormatSupported()).
+   */
+  TextureId loadTexture(const std::string& name, const CachedTexture& tex,
+      int slot);
+
+  /**
+   * @brief Load a texture from a file without blocking the frame
+   *
+   * The file is decoded on a worker thread and copied to the GPU through a
+   * pixel buffer ring over the next frames (see TextureStreamer). The name
+   * is registered right away, but the texture samples as black until the
+   * returned handle reports that it is resident. Use this to load textures
+   * during gameplay.
+   *
+   * @param flip Whether the image should be flipped vertically
+   * @param compress Whether the image is block compressed, see CachedTexture
+   * @return A handle that reports when the texture can be used
+   */
+  TextureHandle streamTexture(const std::string& name,
+      const std::string& filename, int slot, bool flip = false,
+      bool compress = true);
+
+  /**
+   * @brief Advance streamed texture uploads
+   *
+   * Window calls this method once per frame. Users should not call this
+   * method.
+   */
+  void updateTextures();
+
+  /**
+   * @brief Limit the memory used by textures, 256 MB by default
+   *
+   * When textures use more, the ones loaded from files that were not drawn
+   * recently keep only their small mip levels, and are evicted if that is
+   * not enough. They are streamed back in full when drawn again, and
+   * sample as black while evicted. See TextureResidency.
+   */
+  void setTextureBudget(size_t bytes);
+
+  /**
+   * @brief Return the bytes used by all textures
+   */
+  size_t textureBytes() const;
 
   /**
    * @brief Load a cube map
    */
-  void loadCubemap(const std::string& name, const std::string& dir, int slot);
+  TextureId loadCubemap(const std::string& name, const std::string& dir,
+      int slot);
 
   /**
    * @brief Load a cube map
    */
-  void loadCubemap(const std::string& name,
+  TextureId loadCubemap(const std::string& name,
       const std::vector<std::string>& names, int slot);
 
   /**
    * @brief Load a cube map
    */
-  void loadCubemap(const std::string& name,
+  TextureId loadCubemap(const std::string& name,
       const std::vector<Image>& images, int slot);
   ///@}
 
@@ -504,31 +622,75 @@ class Renderer {
    * @param pos The location of the center of the sprite
    * @param color The color of the sprite
    * @param size The size (width/height) of the billboard
+   * @param rot The rotation of the billboard around the view axis
+   *
+   * Sprites are batched. Each call appends one instance to a streaming
+   * buffer and the whole batch is drawn with one instanced draw call when
+   * the batch is flushed. The position is transformed by the current matrix
+   * when the sprite is added. The size is in world units and, unlike before
+   * sprites were batched, is not scaled by the current matrix.
    *
+   * @see flushBatches()
    * @verbinclude sprites.cpp
    */
   void sprite(const glm::vec3& pos, const glm::vec4& color, float size, float rot = 0.0f);
 
   /**
-   * @brief Draws a sprite using a point billboard
+   * @brief Draws a line segment
    * @param p1 The location of the first point
    * @param p2 The location of the second point
    * @param c1 The color of the first point
    * @param c2 The color of the second point
    *
+   * Lines are batched like sprites. Endpoints are transformed by the current
+   * matrix when the line is added and the whole batch is drawn with a single
+   * GL_LINES call using the active shader.
+   *
+   * @see flushBatches()
    */
   void line(const glm::vec3& p1, const glm::vec3& p2,
       const glm::vec3& c1, const glm::vec3& c2);
 
+  /**
+   * @brief Draw all lines, sprites and static meshes queued since the last
+   * flush
+   *
+   * Batches are drawn with the shader and uniforms that were active when
+   * they were queued. The Renderer flushes automatically before any change
+   * that would affect queued primitives (setting uniforms, changing shaders,
+   * textures, blend mode, depth test, camera or projection, render targets)
+   * and Window flushes at the end of each frame, so users rarely need to
+   * call this directly.
+   */
+  void flushBatches();
+
   /**
    * @brief Draws text using the current font size and color
    * @param text The phrase to display
    * @param x The x-location of the text (left-most point). Range [0, screenwidth]
    * @param y The y-location of the text (bottom-most point). Range [0, screenheight]
    *
+   * Text is not drawn immediately. Glyph quads are appended to a batch which
+   * is drawn with a single draw call by flushText(). Window flushes the batch
+   * at the end of each frame. Layouts are cached by (text, size), so
+   * drawing the same label every frame does not re-layout the string.
+   *
+   * Glyphs come from a signed distance field atlas built once per font (see
+   * SdfFont), so text stays sharp at any size and nothing is rasterized
+   * while drawing.
+   *
+   * @see flushText()
    */
   void text(const std::string& text, float x, float y);
 
+  /**
+   * @brief Draw all text queued with text() since the last flush
+   *
+   * Window calls this method automatically at the end of each frame. Call it
+   * explicitly if text must appear before something drawn later in the frame.
+   */
+  void flushText();
+
   /**
    * @brief Set font color for drawing text
    * @param color A RGBA color with values in range [0,1]
@@ -538,7 +700,7 @@ class Renderer {
 
   /**
    * @brief Set font size for drawing text
-   * @param size The point size of the font
+   * @param size The pixel height of the font
    *
    */
   void fontSize(int s);
@@ -565,6 +727,12 @@ class Renderer {
    */
   void sphere();
 
+  /**
+   * @brief Draws a sphere with the given tessellation
+   * @param subdivisions The number of slices/stacks used to build the mesh
+   */
+  void sphere(int subdivisions);
+
   /**
    * @brief Draws a cube centered at the origin with width, height, and depth
    * equal to 1.0
@@ -580,12 +748,24 @@ class Renderer {
    */
   void cone();
 
+  /**
+   * @brief Draws a cone with the given tessellation
+   * @param subdivisions The number of slices/stacks used to build the mesh
+   */
+  void cone(int subdivisions);
+
   /**
    * @brief Draws a teapot with largest side with width 1
    *
    */
   void teapot();
 
+  /**
+   * @brief Draws a teapot with the given tessellation
+   * @param subdivisions The grid size of each Bezier patch (13 by default)
+   */
+  void teapot(int subdivisions);
+
   /**
    * @brief Draws a plane
    *
@@ -598,6 +778,12 @@ class Renderer {
    */
   void cylinder();
 
+  /**
+   * @brief Draws a cylinder with the given tessellation
+   * @param subdivisions The number of slices/stacks used to build the mesh
+   */
+  void cylinder(int subdivisions);
+
   /**
    * @brief Draws a capsule with endpoints at (0,0,0) and (0,0,1).
    * The cap radius is 0.25 and the width is 0.5.
@@ -605,12 +791,24 @@ class Renderer {
    */
   void capsule();
 
+  /**
+   * @brief Draws a capsule with the given tessellation
+   * @param subdivisions The number of slices/stacks used to build the mesh
+   */
+  void capsule(int subdivisions);
+
   /**
    * @brief Draws a torus
    *
    */
   void torus();
 
+  /**
+   * @brief Draws a torus with the given tessellation
+   * @param subdivisions The number of slices/stacks used to build the mesh
+   */
+  void torus(int subdivisions);
+
   /**
    * @brief Draws a skybox (typically with a cubemap)
    *
@@ -631,31 +829,111 @@ class Renderer {
    */
   void mesh(const Mesh& m);
 
+  /**
+   * @brief Copy a static triangle mesh into the shared static mesh buffers
+   * @param indices Triangle indices
+   * @param points xyz positions
+   * @param normals xyz normals
+   * @param texCoords uv coordinates (optional)
+   * @return An id for staticMesh(int), or -1 on error
+   *
+   * Static meshes share one vertex buffer and one index buffer, so any
+   * number of them can be submitted together. Use this for props that never
+   * change their vertices (e.g. PLYMesh::positions(), PLYMesh::normals(),
+   * PLYMesh::indices()). The source mesh can be freed afterwards.
+   *
+   * @see staticMesh(int)
+   */
+  int loadStaticMesh(const std::vector<GLuint>& indices,
+      const std::vector<GLfloat>& points,
+      const std::vector<GLfloat>& normals,
+      const std::vector<GLfloat>* texCoords = nullptr);
+
+  /**
+   * @brief Draws a static mesh with the current transform
+   * @param id The id returned by loadStaticMesh()
+   *
+   * Static meshes are batched like sprites and lines. When the context
+   * supports GL 4.3 and the active shader reads per-draw transforms from the
+   * StaticDraws storage buffer (see shaders/spotlight-static.vs), the whole
+   * batch is drawn with one glMultiDrawElementsIndirect call. Otherwise,
+   * each mesh is drawn with its own call and the usual MVP, ModelViewMatrix
+   * and NormalMatrix uniforms, so the regular shaders can be used.
+   *
+   * @see flushBatches()
+   * @see StaticMeshBuffer::multiDrawSupported()
+   */
+  void staticMesh(int id);
+
   /**
    * @brief Draws a 2D quad
    *
    */
   void quad();
+
+  /**
+   * @brief Draws a quad as a cylindrical billboard
+   * @param pivot The world position the billboard rotates around
+   * @param size The width and height of the quad
+   * @param offset Offset of the quad center from the pivot, in the
+   * billboard's rotated frame (e.g. to attach a page in front of a tree)
+   * @param axis The constrained up axis of the billboard
+   *
+   * The quad rotates around axis to face the camera. The rotation is built
+   * in the vertex shader from CameraPos, so no heading is computed on the
+   * CPU and the matrix stack is not used. The current shader must support
+   * billboard mode (e.g. spotlight.vs), which defines the uniforms
+   *
+   * * *uniform bool Billboard*
+   * * *uniform mat4 ModelMatrix* The local transform of the item
+   * * *uniform vec3 BillboardPivot*
+   * * *uniform vec3 BillboardAxis*
+   * * *uniform vec3 CameraPos*
+   */
+  void billboard(const glm::vec3& pivot, const glm::vec2& size,
+      const glm::vec3& offset = glm::vec3(0),
+      const glm::vec3& axis = glm::vec3(0, 1, 0));
+
+  /**
+   * @brief Draws a mesh as a cylindrical billboard
+   * @param m The mesh to draw
+   * @param pivot The world position the mesh rotates around
+   * @param axis The constrained up axis
+   *
+   * The current matrix is used as the local transform of the mesh (relative
+   * to the pivot) before the camera-facing rotation is applied.
+   *
+   * @see billboard(const glm::vec3&, const glm::vec2&, const glm::vec3&,
+   *     const glm::vec3&)
+   */
+  void billboard(const Mesh& m, const glm::vec3& pivot,
+      const glm::vec3& axis = glm::vec3(0, 1, 0));
   ///@}
 
  private:
   void initBillboards();
   void initLines();
   void initText();
+  const std::vector<float>& textLayout(const std::string& text);
+  GLuint registerTexture(TextureId id, int slot);
 
  private:
   bool _initialized;
   BlendMode _blendMode;
 
-  // textures
+  // textures, shaders and render targets are stored by interned name, so
+  // drawing with an id is an array lookup
   struct Texture {
-    GLuint texId;
-    int slot;
+    GLuint texId = 0;  // 0 until loaded
+    int slot = 0;
   };
-  std::map<std::string, Texture> _textures;
+  ResourceRegistry<Texture, TextureId> _textures;
+  class TextureStreamer* _textureStreamer;
+  TextureResidency _residency;
 
   // render targets
   struct RenderTexture {
+    bool loaded = false;
     GLuint handleId;    // fbo id
     GLuint textureId;   // render texture target
     GLuint depthId;     // depth buffer id
@@ -664,12 +942,12 @@ class Renderer {
     int height;         // texture and depth buffer height
     GLint winProps[4];  // cached window x,y,w,h (needed to restore viewport)
   };
-  std::map<std::string, RenderTexture> _renderTextures;
-  std::string _activeRenderTexture;
+  ResourceRegistry<RenderTexture, RenderTargetId> _renderTextures;
+  RenderTargetId _activeRenderTexture;
 
   // shaders
   class Shader* _currentShader;
-  std::map<std::string, class Shader*> _shaders;
+  ResourceRegistry<class Shader*, ShaderId> _shaders;
   std::list<Shader*> _shaderStack;
 
   // matrix stack
@@ -681,31 +959,67 @@ class Renderer {
   glm::mat4 _viewMatrix;
   glm::vec3 _lookfrom;
 
-  // default meshes
-  class Cube* _cube;
-  class Cylinder* _cone;
-  class Capsule* _capsule;
-  class Cylinder* _cylinder;
-  class Teapot* _teapot;
-  class Torus* _torus;
-  class Plane* _plane;
-  class Sphere* _sphere;
+  // default meshes, built on first use and keyed by (type, subdivisions)
+  enum Primitive {
+    CUBE, CONE, CAPSULE, CYLINDER, TEAPOT, TORUS, PLANE, SPHERE
+  };
+  const Mesh& primitive(Primitive type, int subdivisions);
+  std::map<std::pair<int, int>, Mesh*> _primitives;
   class SkyBox* _skybox;
 
   // Quad
   GLuint mBBVboIds[3];
   GLuint mBBVaoId;
 
-  // Line
-  GLuint mVboLineIds[2];
+  // Line and sprite batches (flushed by flushBatches)
+  struct LineVertex {
+    glm::vec3 pos;
+    glm::vec3 color;
+  };
+  struct SpriteInstance {
+    glm::vec3 offset;
+    glm::vec4 color;
+    float size;
+    float rot;
+  };
+  std::vector<LineVertex> _lineBatch;
+  std::vector<SpriteInstance> _spriteBatch;
+  class StaticMeshBuffer* _staticMeshes;
+  GLuint mVboLineId;
   GLuint mVaoLineId;
+  GLsizeiptr _lineVboSize;
+  bool _flushingBatches;  // setUniform() does not flush while drawing them
+  GLuint mVboSpriteId;
+  GLuint mVaoSpriteId;
+  GLsizeiptr _spriteVboSize;
 
   // Text
-  int _fontNormal;
+  class SdfFont* _font;
+  GLuint _fontTexture;
   unsigned int _fontColor;
   float _fontSize;
 
+  struct TextVertex {
+    float x, y;          // screen position
+    float s, t;          // atlas uv
+    unsigned int color;  // packed RGBA, r in the lowest byte
+  };
+  std::vector<TextVertex> _textBatch;
+  GLuint mVboTextId;
+  GLuint mVaoTextId;
+
+  // cached glyph quads (x0,y0,s0,t0,x1,y1,s1,t1) keyed by (text, size)
+  typedef std::pair<std::string, int> TextKey;
+  std::map<TextKey, std::vector<float>> _textLayouts;
+
  public:
+  /**
+   * @brief Slices/stacks used by sphere(), cone(), cylinder(), capsule() and
+   * torus() when no subdivisions are given
+   *
+   * The primitive meshes are built on first use and cached for each
+   * (primitive, subdivisions) pair, so any number of levels can be drawn.
+   */
   static int PrimitiveSubdivision;
 };
 
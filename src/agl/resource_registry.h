@@ -0,0 +1,133 @@
+// Copyright 2020, Aline Normoyle, alinen@savvysine.com, MIT License
+
+#ifndef AGL_RESOURCE_REGISTRY_H_
+#define AGL_RESOURCE_REGISTRY_H_
+
+#include <cassert>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace agl {
+
+/**
+ * @brief Compact handle to a named renderer resource
+ *
+ * Ids are indices into a ResourceRegistry, so using one is an array lookup
+ * instead of a string compare. The Tag only keeps texture, shader and render
+ * target ids from being mixed up. Default constructed ids are invalid.
+ * @see TextureId
+ * @see ShaderId
+ * @see RenderTargetId
+ */
+template <typename Tag>
+struct ResourceId {
+  int index = -1;
+
+  bool valid() const { return index >= 0; }
+  bool operator==(const ResourceId& other) const {
+    return index == other.index;
+  }
+  bool operator!=(const ResourceId& other) const {
+    return index != other.index;
+  }
+};
+
+/**
+ * @brief Id of a 2D texture or cube map
+ * @see Renderer::textureId(const std::string&)
+ */
+typedef ResourceId<struct TextureTag> TextureId;
+
+/**
+ * @brief Id of a shader program
+ * @see Renderer::shaderId(const std::string&)
+ */
+typedef ResourceId<struct ShaderTag> ShaderId;
+
+/**
+ * @brief Id of a render texture target
+ * @see Renderer::renderTargetId(const std::string&)
+ */
+typedef ResourceId<struct RenderTargetTag> RenderTargetId;
+
+/**
+ * @brief Resources stored in an array and looked up by interned names
+ *
+ * Each name is given an index the first time it is interned and keeps it
+ * until clear(), so ids can be taken before a resource is loaded and stay
+ * valid when it is reloaded. Interned but unloaded entries hold T().
+ */
+template <typename T, typename Id>
+class ResourceRegistry {
+ public:
+  /**
+   * @brief Return the id of name, adding an empty entry the first time
+   */
+  Id intern(const std::string& name) {
+    auto it = _ids.find(name);
+    if (it != _ids.end()) return it->second;
+
+    Id id;
+    id.index = static_cast<int>(_items.size());
+    _ids[name] = id;
+    _items.push_back(T());
+    _names.push_back(name);
+    return id;
+  }
+
+  /**
+   * @brief Return the id of name, or an invalid id if it was never interned
+   */
+  Id find(const std::string& name) const {
+    auto it = _ids.find(name);
+    return it != _ids.end() ? it->second : Id();
+  }
+
+  /**
+   * @brief Return whether id belongs to this registry
+   */
+  bool contains(Id id) const {
+    return id.index >= 0 && id.index < static_cast<int>(_items.size());
+  }
+
+  T& operator[](Id id) {
+    assert(contains(id));
+    return _items[id.index];
+  }
+
+  const T& operator[](Id id) const {
+    assert(contains(id));
+    return _items[id.index];
+  }
+
+  /**
+   * @brief Return the name id was interned with
+   */
+  const std::string& name(Id id) const {
+    assert(contains(id));
+    return _names[id.index];
+  }
+
+  size_t size() const { return _items.size(); }
+
+  typename std::vector<T>::iterator begin() { return _items.begin(); }
+  typename std::vector<T>::iterator end() { return _items.end(); }
+
+  /**
+   * @brief Remove every entry, previously returned ids become invalid
+   */
+  void clear() {
+    _ids.clear();
+    _items.clear();
+    _names.clear();
+  }
+
+ private:
+  std::unordered_map<std::string, Id> _ids;
+  std::vector<T> _items;
+  std::vector<std::string> _names;
+};
+
+}  // namespace agl
+#endif  // AGL_RESOURCE_REGISTRY_H_
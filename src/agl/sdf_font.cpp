@@ -0,0 +1,331 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+#include "agl/sdf_font.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#define STB_TRUETYPE_IMPLEMENTATION
+#define STBTT_STATIC
+#include "fontstash/stb_truetype.h"
+
+namespace agl {
+
+static const char FONT_MAGIC[8] = "AGLFONT";
+static const uint32_t FONT_VERSION = 1;
+
+// printable ASCII, rendered once at BAKE_SIZE into an ATLAS_WIDTH wide atlas
+static const uint32_t FIRST_CODEPOINT = 32;
+static const uint32_t LAST_CODEPOINT = 126;
+static const float BAKE_SIZE = 48.0f;
+static const int SPREAD = 8;
+static const int ATLAS_WIDTH = 512;
+static const unsigned char ON_EDGE = 128;
+
+static size_t align16(size_t n) {
+  return (n + 15) & ~static_cast<size_t>(15);
+}
+
+static const FontCacheHeader& header(const MappedFile& file) {
+  return *reinterpret_cast<const FontCacheHeader*>(file.data());
+}
+
+static bool isValidCache(const MappedFile& file) {
+  if (file.size() < sizeof(FontCacheHeader)) return false;
+  const FontCacheHeader& h = header(file);
+  if (memcmp(h.magic, FONT_MAGIC, sizeof(FONT_MAGIC)) != 0) return false;
+  if (h.version != FONT_VERSION || h.numGlyphs == 0) return false;
+
+  uint64_t blobs[][2] = {
+    {h.glyphsOffset, h.numGlyphs * sizeof(SdfGlyph)},
+    {h.kerningOffset, h.numKerning * sizeof(SdfKerning)},
+    {h.pixelsOffset, static_cast<uint64_t>(h.width) * h.height}
+  };
+  for (auto& blob : blobs) {
+    if (blob[0] > file.size() || blob[1] > file.size() - blob[0]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Decodes one UTF-8 sequence at *p, invalid bytes become U+FFFD
+static uint32_t nextCodepoint(const char** p, const char* end) {
+  const unsigned char* s = reinterpret_cast<const unsigned char*>(*p);
+  uint32_t c = *s++;
+  int extra = 0;
+  if (c >= 0xF0) {
+    extra = 3;
+    c &= 0x07;
+  } else if (c >= 0xE0) {
+    extra = 2;
+    c &= 0x0F;
+  } else if (c >= 0xC0) {
+    extra = 1;
+    c &= 0x1F;
+  } else if (c >= 0x80) {
+    c = 0xFFFD;
+  }
+  for (; extra > 0; extra--) {
+    if (reinterpret_cast<const char*>(s) >= end || (*s & 0xC0) != 0x80) {
+      c = 0xFFFD;
+      break;
+    }
+    c = (c << 6) | (*s++ & 0x3F);
+  }
+  *p = reinterpret_cast<const char*>(s);
+  return c;
+}
+
+SdfFont::SdfFont() {
+  _firstCodepoint = 0;
+  _width = 0;
+  _height = 0;
+  _bakeSize = BAKE_SIZE;
+  _lineHeight = 0.0f;
+  _sourceHash = 0;
+}
+
+std::string SdfFont::cachePath(const std::string& filename) {
+  return cacheFilePath(filename, ".sdf");
+}
+
+bool SdfFont::isCacheCurrent(const std::string& filename) {
+  return openCache(filename) != nullptr;
+}
+
+std::shared_ptr<MappedFile> SdfFont::openCache(const std::string& filename) {
+  std::string path = cachePath(filename);
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if (!file->map(path) || !isValidCache(*file)) return nullptr;
+
+  const FontCacheHeader& cached = header(*file);
+  int64_t time;
+  if (!isSourceUnchanged(filename, cached.source, &time)) return nullptr;
+
+  if (time != cached.source.time) {
+    // store the new time so that the next load skips the hash
+    size_t stampOffset = offsetof(FontCacheHeader, source);
+    if (!updateCacheTime(path, stampOffset, time, &file)) return nullptr;
+  }
+  return file;
+}
+
+std::shared_ptr<MappedFile> SdfFont::buildCache(const std::string& filename) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) return nullptr;
+  std::vector<unsigned char> ttf((std::istreambuf_iterator<char>(in)),
+      std::istreambuf_iterator<char>());
+
+  stbtt_fontinfo info;
+  if (ttf.empty() || !stbtt_InitFont(&info, ttf.data(),
+      stbtt_GetFontOffsetForIndex(ttf.data(), 0))) {
+    return nullptr;
+  }
+  float scale = stbtt_ScaleForPixelHeight(&info, BAKE_SIZE);
+
+  FontCacheHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, FONT_MAGIC, sizeof(FONT_MAGIC));
+  h.version = FONT_VERSION;
+  h.source.read(filename);
+  h.firstCodepoint = FIRST_CODEPOINT;
+  h.numGlyphs = LAST_CODEPOINT - FIRST_CODEPOINT + 1;
+  h.bakeSize = BAKE_SIZE;
+  h.spread = SPREAD;
+  int ascent, descent, lineGap;
+  stbtt_GetFontVMetrics(&info, &ascent, &descent, &lineGap);
+  h.ascent = ascent * scale;
+  h.descent = descent * scale;
+  h.lineGap = lineGap * scale;
+
+  // render every glyph's distance field, 128 on the edge and falling by
+  // 128 / SPREAD per pixel outside it
+  struct Bitmap {
+    unsigned char* pixels;
+    int w, h, x, y;
+  };
+  std::vector<Bitmap> bitmaps(h.numGlyphs);
+  std::vector<SdfGlyph> glyphs(h.numGlyphs);
+  for (uint32_t i = 0; i < h.numGlyphs; i++) {
+    int cp = FIRST_CODEPOINT + i;
+    Bitmap& b = bitmaps[i];
+    int xoff = 0, yoff = 0;
+    b.pixels = stbtt_GetCodepointSDF(&info, scale, cp, SPREAD, ON_EDGE,
+        static_cast<float>(ON_EDGE) / SPREAD, &b.w, &b.h, &xoff, &yoff);
+    if (!b.pixels) b.w = b.h = 0;
+
+    int advance, bearing;
+    stbtt_GetCodepointHMetrics(&info, cp, &advance, &bearing);
+    glyphs[i].advance = advance * scale;
+    glyphs[i].x0 = static_cast<float>(xoff);
+    glyphs[i].y0 = static_cast<float>(yoff);
+    glyphs[i].x1 = static_cast<float>(xoff + b.w);
+    glyphs[i].y1 = static_cast<float>(yoff + b.h);
+  }
+
+  // shelf pack the tallest glyphs first, then round the height up to a
+  // power of two
+  std::vector<uint32_t> order(h.numGlyphs);
+  for (uint32_t i = 0; i < h.numGlyphs; i++) order[i] = i;
+  std::sort(order.begin(), order.end(), [&bitmaps](uint32_t a, uint32_t b) {
+    return bitmaps[a].h > bitmaps[b].h;
+  });
+  int x = 0, y = 0, shelf = 0;
+  for (uint32_t i : order) {
+    Bitmap& b = bitmaps[i];
+    if (x + b.w > ATLAS_WIDTH) {
+      x = 0;
+      y += shelf + 1;
+      shelf = 0;
+    }
+    b.x = x;
+    b.y = y;
+    x += b.w + 1;
+    shelf = std::max(shelf, b.h);
+  }
+  h.width = ATLAS_WIDTH;
+  h.height = 1;
+  while (h.height < static_cast<uint32_t>(y + shelf)) h.height *= 2;
+
+  std::vector<unsigned char> atlas(h.width * h.height, 0);
+  for (uint32_t i = 0; i < h.numGlyphs; i++) {
+    Bitmap& b = bitmaps[i];
+    for (int row = 0; row < b.h; row++) {
+      memcpy(&atlas[(b.y + row) * h.width + b.x], b.pixels + row * b.w, b.w);
+    }
+    if (b.pixels) stbtt_FreeSDF(b.pixels, NULL);
+    glyphs[i].s0 = static_cast<float>(b.x) / h.width;
+    glyphs[i].t0 = static_cast<float>(b.y) / h.height;
+    glyphs[i].s1 = static_cast<float>(b.x + b.w) / h.width;
+    glyphs[i].t1 = static_cast<float>(b.y + b.h) / h.height;
+  }
+
+  // pairs are generated in increasing order, so lookups can bisect
+  std::vector<SdfKerning> kerning;
+  for (uint32_t a = FIRST_CODEPOINT; a <= LAST_CODEPOINT; a++) {
+    for (uint32_t b = FIRST_CODEPOINT; b <= LAST_CODEPOINT; b++) {
+      int k = stbtt_GetCodepointKernAdvance(&info, a, b);
+      if (k != 0) kerning.push_back(SdfKerning{a << 16 | b, k * scale});
+    }
+  }
+  h.numKerning = static_cast<uint32_t>(kerning.size());
+
+  size_t offset = align16(sizeof(h));
+  h.glyphsOffset = offset;
+  offset = align16(offset + glyphs.size() * sizeof(SdfGlyph));
+  h.kerningOffset = offset;
+  offset = align16(offset + kerning.size() * sizeof(SdfKerning));
+  h.pixelsOffset = offset;
+  offset = align16(offset + atlas.size());
+
+  std::vector<char> bytes(offset, 0);
+  memcpy(bytes.data(), &h, sizeof(h));
+  memcpy(&bytes[h.glyphsOffset], glyphs.data(),
+      glyphs.size() * sizeof(SdfGlyph));
+  if (!kerning.empty()) {
+    memcpy(&bytes[h.kerningOffset], kerning.data(),
+        kerning.size() * sizeof(SdfKerning));
+  }
+  memcpy(&bytes[h.pixelsOffset], atlas.data(), atlas.size());
+
+  std::string path = cachePath(filename);
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if (!writeCacheFile(path, bytes) || !file->map(path)) {
+    return std::make_shared<MappedFile>(std::move(bytes));
+  }
+  return file;
+}
+
+bool SdfFont::load(const std::string& filename) {
+  _file = openCache(filename);
+  if (!_file) _file = buildCache(filename);
+  if (!_file) return false;
+
+  const FontCacheHeader& h = header(*_file);
+  const SdfGlyph* glyphs =
+      reinterpret_cast<const SdfGlyph*>(_file->data() + h.glyphsOffset);
+  const SdfKerning* kerning =
+      reinterpret_cast<const SdfKerning*>(_file->data() + h.kerningOffset);
+  _glyphs.assign(glyphs, glyphs + h.numGlyphs);
+  _kerning.assign(kerning, kerning + h.numKerning);
+  _firstCodepoint = h.firstCodepoint;
+  _width = h.width;
+  _height = h.height;
+  _bakeSize = h.bakeSize;
+  _lineHeight = h.ascent - h.descent + h.lineGap;
+  _sourceHash = h.source.hash;
+  return true;
+}
+
+void SdfFont::release() {
+  _file.reset();
+}
+
+const unsigned char* SdfFont::pixels() const {
+  assert(_file);
+  return reinterpret_cast<const unsigned char*>(
+      _file->data() + header(*_file).pixelsOffset);
+}
+
+const SdfGlyph* SdfFont::glyph(uint32_t codepoint) const {
+  if (codepoint < _firstCodepoint ||
+      codepoint - _firstCodepoint >= _glyphs.size()) {
+    return nullptr;
+  }
+  return &_glyphs[codepoint - _firstCodepoint];
+}
+
+float SdfFont::kerning(uint32_t first, uint32_t second) const {
+  uint32_t pair = first << 16 | second;
+  auto it = std::lower_bound(_kerning.begin(), _kerning.end(), pair,
+      [](const SdfKerning& k, uint32_t p) { return k.pair < p; });
+  return (it != _kerning.end() && it->pair == pair) ? it->advance : 0.0f;
+}
+
+template <typename F>
+void SdfFont::forEachGlyph(const std::string& text, float size, F f) const {
+  float scale = size / _bakeSize;
+  float pen = 0.0f;
+  uint32_t prev = 0;
+  const char* p = text.data();
+  const char* end = p + text.size();
+  while (p < end) {
+    uint32_t cp = nextCodepoint(&p, end);
+    const SdfGlyph* g = glyph(cp);
+    if (!g) {
+      cp = '?';
+      g = glyph(cp);
+      if (!g) continue;
+    }
+    if (prev) pen += kerning(prev, cp) * scale;
+    f(*g, pen, scale);
+    pen += g->advance * scale;
+    prev = cp;
+  }
+}
+
+void SdfFont::layout(const std::string& text, float size,
+    std::vector<float>* quads) const {
+  forEachGlyph(text, size, [quads](const SdfGlyph& g, float pen, float s) {
+    if (g.x1 <= g.x0) return;  // e.g. spaces
+    float quad[] = {pen + g.x0 * s, g.y0 * s, g.s0, g.t0,
+                    pen + g.x1 * s, g.y1 * s, g.s1, g.t1};
+    quads->insert(quads->end(), quad, quad + 8);
+  });
+}
+
+float SdfFont::textWidth(const std::string& text, float size) const {
+  float width = 0.0f;
+  forEachGlyph(text, size, [&width](const SdfGlyph& g, float pen, float s) {
+    width = pen + g.advance * s;
+  });
+  return width;
+}
+
+float SdfFont::lineHeight(float size) const {
+  return _lineHeight * size / _bakeSize;
+}
+
+}  // namespace agl
@@ -0,0 +1,168 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+
+#ifndef AGL_SDF_FONT_H_
+#define AGL_SDF_FONT_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "agl/cache_file.h"
+
+namespace agl {
+
+/**
+ * @brief Layout of a font cache file
+ *
+ * The header is followed by numGlyphs SdfGlyph entries, numKerning
+ * SdfKerning entries sorted by pair, and the width x height distance field
+ * (one byte per texel), each starting on a 16 byte boundary.
+ */
+struct FontCacheHeader {
+  char magic[8];            // "AGLFONT"
+  uint32_t version;
+  uint32_t firstCodepoint;  // glyphs cover [first, first + numGlyphs)
+  SourceStamp source;       // the ttf file this was built from
+  uint32_t numGlyphs;
+  uint32_t numKerning;
+  uint32_t width;           // atlas size
+  uint32_t height;
+  float bakeSize;           // pixel height the glyphs were rendered at
+  float spread;             // distance in pixels from the edge to 0 or 255
+  float ascent;             // line metrics at bakeSize, descent < 0
+  float descent;
+  float lineGap;
+  uint32_t padding;
+  uint64_t glyphsOffset;
+  uint64_t kerningOffset;
+  uint64_t pixelsOffset;
+};
+
+/**
+ * @brief Placement of one glyph, in pixels at the bake size
+ *
+ * The quad is relative to the pen position on the baseline, with y down.
+ */
+struct SdfGlyph {
+  float advance;
+  float x0, y0, x1, y1;
+  float s0, t0, s1, t1;     // atlas uvs
+};
+
+/**
+ * @brief Extra advance between two glyphs, in pixels at the bake size
+ */
+struct SdfKerning {
+  uint32_t pair;            // first << 16 | second
+  float advance;
+};
+
+/**
+ * @brief A font rendered once into a signed distance field atlas
+ *
+ * Each texel stores the distance to the nearest glyph edge (128 on the
+ * edge, larger inside), so one small atlas draws sharp text at any size:
+ * the text shader thresholds the interpolated distance instead of sampling
+ * coverage. Nothing is rasterized while drawing and the atlas never
+ * changes.
+ *
+ * The first load of a font renders the printable ASCII glyphs and writes
+ * them with their metrics to <font dir>/cache/<file>.sdf; later loads map
+ * that file. The cache is rebuilt when the ttf file changes (see
+ * isSourceUnchanged()), and the assetcook tool builds it ahead of time.
+ *
+ * Loading only touches files, so it can run on any thread.
+ * @see Renderer::text()
+ */
+class SdfFont {
+ public:
+  SdfFont();
+
+  /**
+   * @brief Map the cache of a ttf font, building it if needed
+   * @return false if the font could not be loaded
+   */
+  bool load(const std::string& filename);
+
+  /**
+   * @brief Unmap the atlas pixels, e.g. once they are uploaded
+   *
+   * The glyphs and metrics stay available for layout.
+   */
+  void release();
+
+  /**
+   * @brief Return whether the glyphs are available
+   */
+  bool valid() const { return !_glyphs.empty(); }
+
+  /**
+   * @brief Return whether the atlas pixels are available
+   */
+  bool loaded() const { return _file != nullptr; }
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+  /**
+   * @brief Return the distance field, one byte per texel, rows top first
+   */
+  const unsigned char* pixels() const;
+
+  /**
+   * @brief Return the hash of the ttf the cache was built from
+   */
+  uint64_t sourceHash() const { return _sourceHash; }
+
+  /**
+   * @brief Append the quads of text at the given pixel size
+   *
+   * The pen starts at (0, 0) on the baseline with y down. Each glyph adds
+   * x0, y0, s0, t0, x1, y1, s1, t1. Codepoints missing from the atlas are
+   * drawn as '?'.
+   */
+  void layout(const std::string& text, float size,
+      std::vector<float>* quads) const;
+
+  /**
+   * @brief Return the advance of text at the given pixel size
+   */
+  float textWidth(const std::string& text, float size) const;
+
+  /**
+   * @brief Return the distance between baselines at the given pixel size
+   */
+  float lineHeight(float size) const;
+
+  /**
+   * @brief Return the cache file used for a font
+   */
+  static std::string cachePath(const std::string& filename);
+
+  /**
+   * @brief Return whether the cache of a font exists and is up to date
+   */
+  static bool isCacheCurrent(const std::string& filename);
+
+ private:
+  static std::shared_ptr<MappedFile> openCache(const std::string& filename);
+  static std::shared_ptr<MappedFile> buildCache(const std::string& filename);
+  const SdfGlyph* glyph(uint32_t codepoint) const;
+  float kerning(uint32_t first, uint32_t second) const;
+
+  template <typename F>
+  void forEachGlyph(const std::string& text, float size, F f) const;
+
+  std::shared_ptr<MappedFile> _file;
+  std::vector<SdfGlyph> _glyphs;
+  std::vector<SdfKerning> _kerning;
+  uint32_t _firstCodepoint;
+  int _width;
+  int _height;
+  float _bakeSize;
+  float _lineHeight;        // at bakeSize
+  uint64_t _sourceHash;
+};
+
+}  // namespace agl
+#endif  // AGL_SDF_FONT_H_
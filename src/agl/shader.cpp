@@ -207,6 +207,7 @@ void Shader::link() {
     throw GLSLProgramException(message);
   } else {
     findUniformLocations();
+    findStorageBlocks();
     linked = true;
   }
 }
@@ -378,6 +379,36 @@ void Shader::printActiveUniforms() {
 #endif
 }
 
+void Shader::findStorageBlocks() {
+  storageBlocks.clear();
+#ifndef __APPLE__
+  // OpenGL 4.1 has no shader storage buffers
+  if (!GLEW_VERSION_4_3 && !GLEW_ARB_program_interface_query) return;
+
+  GLint numBlocks = 0;
+  glGetProgramInterfaceiv(handle, GL_SHADER_STORAGE_BLOCK,
+      GL_ACTIVE_RESOURCES, &numBlocks);
+
+  GLenum properties[] = {GL_NAME_LENGTH};
+  for (GLint i = 0; i < numBlocks; ++i) {
+    GLint nameLength = 0;
+    glGetProgramResourceiv(handle, GL_SHADER_STORAGE_BLOCK,
+        i, 1, properties, 1, NULL, &nameLength);
+
+    GLint nameBufSize = nameLength + 1;
+    char * name = new char[nameBufSize];
+    glGetProgramResourceName(handle, GL_SHADER_STORAGE_BLOCK,
+        i, nameBufSize, NULL, name);
+    storageBlocks.insert(name);
+    delete [] name;
+  }
+#endif
+}
+
+bool Shader::hasStorageBlock(const char *name) const {
+  return storageBlocks.count(name) > 0;
+}
+
 void Shader::printActiveUniformBlocks() {
 #ifdef __APPLE__
   // For OpenGL 4.1, use glGetActiveUniformBlockiv
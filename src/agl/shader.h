@@ -9,6 +9,7 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <stdexcept>
 #include "agl/agl.h"
 #include "agl/aglm.h"
@@ -67,6 +68,11 @@ class Shader {
   void setUniform(const char *name, GLuint val);
 
   void findUniformLocations();
+  void findStorageBlocks();
+
+  // Return true if the program declares the named shader storage block.
+  // The blocks are looked up once, when the program is linked
+  bool hasStorageBlock(const char *name) const;
 
   void printActiveUniforms();
   void printActiveUniformBlocks();
@@ -78,6 +84,7 @@ class Shader {
   GLuint handle;
   bool linked;
   std::map<std::string, int> uniformLocations;
+  std::set<std::string> storageBlocks;
 
   GLint getUniformLocation(const char *name);
   bool fileExists(const std::string &fileName);
@@ -0,0 +1,251 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+#include "agl/texture_residency.h"
+#include <algorithm>
+#include <cassert>
+
+namespace agl {
+
+TextureResidency::TextureResidency(size_t budget) {
+  _budget = budget;
+  _frame = 1;  // lastUsed 0 means never drawn
+  _numReloadable = 0;
+}
+
+size_t TextureResidency::residentBytes() const {
+  size_t bytes = 0;
+  for (const Entry& e : _entries) bytes += e.bytes;
+  return bytes;
+}
+
+TextureResidency::Entry& TextureResidency::entry(TextureId id) {
+  assert(id.valid());
+  if (id.index >= static_cast<int>(_entries.size())) {
+    _entries.resize(id.index + 1);
+  }
+  return _entries[id.index];
+}
+
+void TextureResidency::replace(Entry& e) {
+  // the renderer deleted the old texture, but a reload may still write to
+  // its own texture object
+  if (e.pendingTexId != 0 && e.pendingTexId != e.texId) {
+    _orphans.push_back(Orphan{e.pending, e.pendingTexId});
+  }
+  if (e.reloadable) _numReloadable--;
+  e = Entry();
+}
+
+void TextureResidency::add(TextureId id, GLuint texId, size_t bytes) {
+  Entry& e = entry(id);
+  replace(e);
+  e.texId = texId;
+  e.bytes = bytes;
+  e.lastUsed = _frame;
+}
+
+void TextureResidency::add(TextureId id, GLuint texId, int slot,
+    const CachedTexture& tex) {
+  Entry& e = entry(id);
+  replace(e);
+  e.reloadable = !tex.filename().empty();
+  if (e.reloadable) _numReloadable++;
+  e.texId = texId;
+  e.slot = slot;
+  e.filename = tex.filename();
+  e.flip = tex.flipped();
+  e.compress = tex.compressed();
+  e.width = tex.width();
+  e.height = tex.height();
+  e.numLevels = tex.numLevels();
+  e.format = tex.format();
+  e.bytes = tex.dataSize();
+  e.lastUsed = _frame;
+}
+
+void TextureResidency::add(TextureId id, GLuint texId, int slot,
+    const std::string& filename, bool flip, bool compress,
+    const TextureHandle& handle) {
+  Entry& e = entry(id);
+  replace(e);
+  e.reloadable = true;
+  _numReloadable++;
+  e.texId = texId;
+  e.slot = slot;
+  e.filename = filename;
+  e.flip = flip;
+  e.compress = compress;
+  e.lastUsed = _frame;
+
+  // the first load fills in the size, like any other reload
+  e.pending = handle;
+  e.pendingTexId = texId;
+  e.pendingLevel = 0;
+}
+
+size_t TextureResidency::levelBytes(const Entry& e, int firstLevel) const {
+  size_t bytes = 0;
+  for (int level = firstLevel; level < e.numLevels; level++) {
+    bytes += textureLevelSize(e.format, std::max(1, e.width >> level),
+        std::max(1, e.height >> level));
+  }
+  return bytes;
+}
+
+size_t TextureResidency::projectedBytes(const Entry& e) const {
+  return e.pendingTexId != 0 ? levelBytes(e, e.pendingLevel) : e.bytes;
+}
+
+int TextureResidency::lowLevel(const Entry& e) const {
+  int level = 0;
+  while (level < e.numLevels - 1 &&
+      std::max(e.width >> level, e.height >> level) > LOW_MIP_SIZE) {
+    level++;
+  }
+  return level;
+}
+
+void TextureResidency::finishReloads(std::vector<Swap>* swaps) {
+  for (size_t i = 0; i < _orphans.size();) {
+    TextureHandle::Status status = _orphans[i].handle.status();
+    if (status == TextureHandle::RESIDENT || status == TextureHandle::FAILED) {
+      glDeleteTextures(1, &_orphans[i].texId);
+      _orphans[i] = _orphans.back();
+      _orphans.pop_back();
+    } else {
+      i++;
+    }
+  }
+
+  for (size_t i = 0; i < _entries.size(); i++) {
+    Entry& e = _entries[i];
+    if (e.pendingTexId == 0) continue;
+
+    TextureHandle::Status status = e.pending.status();
+    if (status == TextureHandle::RESIDENT) {
+      if (e.texId != 0 && e.texId != e.pendingTexId) {
+        glDeleteTextures(1, &e.texId);
+      }
+      e.texId = e.pendingTexId;
+      e.firstLevel = e.pendingLevel;
+      e.width = e.pending.width();
+      e.height = e.pending.height();
+      e.numLevels = e.pending.numLevels();
+      e.format = e.pending.format();
+      e.bytes = e.pending.bytes();
+
+      TextureId id;
+      id.index = static_cast<int>(i);
+      swaps->push_back(Swap{id, e.texId});
+    } else if (status == TextureHandle::FAILED) {
+      // the file is gone, keep whatever is resident
+      if (e.pendingTexId != e.texId) glDeleteTextures(1, &e.pendingTexId);
+      e.reloadable = false;
+      _numReloadable--;
+    } else {
+      continue;
+    }
+    e.pending = TextureHandle();
+    e.pendingTexId = 0;
+  }
+}
+
+void TextureResidency::reload(Entry& e, int level,
+    TextureStreamer& streamer) {
+  GLuint texId;
+  glGenTextures(1, &texId);
+  e.pending = streamer.request(texId, e.slot, e.filename, e.flip, e.compress,
+      level);
+  e.pendingTexId = texId;
+  e.pendingLevel = level;
+}
+
+size_t TextureResidency::reclaim(size_t bytes, uint64_t drawn,
+    TextureStreamer& streamer, std::vector<Swap>* swaps) {
+  std::vector<Entry*> lru;
+  for (Entry& e : _entries) {
+    if (e.reloadable && e.pendingTexId == 0 && e.texId != 0 &&
+        e.numLevels > 0 && e.lastUsed + RECENT_FRAMES <= drawn) {
+      lru.push_back(&e);
+    }
+  }
+  std::sort(lru.begin(), lru.end(), [](const Entry* a, const Entry* b) {
+    return a->lastUsed < b->lastUsed;
+  });
+
+  // first keep only the small mip levels, so the texture can still be drawn
+  size_t freed = 0;
+  for (Entry* e : lru) {
+    if (freed >= bytes) return freed;
+    int low = lowLevel(*e);
+    if (e->firstLevel >= low) continue;
+    freed += e->bytes - std::min(e->bytes, levelBytes(*e, low));
+    reload(*e, low, streamer);
+  }
+
+  // then evict textures that are already small
+  for (Entry* e : lru) {
+    if (freed >= bytes) break;
+    if (e->pendingTexId != 0) continue;
+    glDeleteTextures(1, &e->texId);
+    e->texId = 0;
+    e->firstLevel = e->numLevels;
+    freed += e->bytes;
+    e->bytes = 0;
+
+    TextureId id;
+    id.index = static_cast<int>(e - _entries.data());
+    swaps->push_back(Swap{id, 0});
+  }
+  return freed;
+}
+
+void TextureResidency::update(TextureStreamer& streamer,
+    std::vector<Swap>* swaps) {
+  finishReloads(swaps);
+  uint64_t drawn = _frame;  // touch() stamps of the frame just drawn
+
+  size_t projected = 0;
+  for (const Entry& e : _entries) projected += projectedBytes(e);
+
+  // textures drawn last frame get their full resolution back if it fits,
+  // evicted ones come back small at least
+  for (Entry& e : _entries) {
+    if (!e.reloadable || e.pendingTexId != 0 || e.lastUsed != drawn ||
+        e.numLevels == 0 || (e.texId != 0 && e.firstLevel == 0)) {
+      continue;
+    }
+    size_t full = levelBytes(e, 0);
+    size_t needed = full - std::min(full, e.bytes);
+    if (projected + needed > _budget) {
+      projected -= std::min(projected,
+          reclaim(projected + needed - _budget, drawn, streamer, swaps));
+    }
+    if (projected + needed <= _budget) {
+      reload(e, 0, streamer);
+      projected += needed;
+    } else if (e.texId == 0) {
+      int low = lowLevel(e);
+      reload(e, low, streamer);
+      projected += levelBytes(e, low);
+    }
+  }
+
+  if (projected > _budget) {
+    reclaim(projected - _budget, drawn, streamer, swaps);
+  }
+  _frame++;
+}
+
+void TextureResidency::clear() {
+  for (Entry& e : _entries) {
+    if (e.pendingTexId != 0 && e.pendingTexId != e.texId) {
+      glDeleteTextures(1, &e.pendingTexId);
+    }
+  }
+  for (Orphan& orphan : _orphans) glDeleteTextures(1, &orphan.texId);
+  _entries.clear();
+  _orphans.clear();
+  _numReloadable = 0;
+}
+
+}  // namespace agl
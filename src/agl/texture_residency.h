@@ -0,0 +1,151 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+
+#ifndef AGL_TEXTURE_RESIDENCY_H_
+#define AGL_TEXTURE_RESIDENCY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "agl/agl.h"
+#include "agl/resource_registry.h"
+#include "agl/texture_streamer.h"
+
+namespace agl {
+
+/**
+ * @brief Keeps the textures of a Renderer within a memory budget
+ *
+ * Every texture the renderer creates is counted here. Textures that were
+ * loaded from a file can be reloaded from their cache at any mip level, so
+ * when the total goes over the budget the least recently drawn ones are
+ * first reduced to their small mip levels (at most LOW_MIP_SIZE pixels on
+ * a side) and then evicted. A texture that is drawn again is streamed back
+ * at full resolution once it fits. Textures drawn within the last
+ * RECENT_FRAMES frames are never reduced.
+ *
+ * Reloads go through the TextureStreamer into a new texture object, which
+ * replaces the old one once it is resident, so drawing never waits on
+ * them. Textures made from an Image or rendered to cannot be reloaded and
+ * are only counted.
+ *
+ * Users do not normally create this class, see Renderer::setTextureBudget().
+ */
+class TextureResidency {
+ public:
+  static const int LOW_MIP_SIZE = 64;
+  static const int RECENT_FRAMES = 60;
+
+  /**
+   * @brief A texture object that replaced the one of a texture id
+   *
+   * texId is 0 for evicted textures. The old object is already deleted.
+   */
+  struct Swap {
+    TextureId id;
+    GLuint texId;
+  };
+
+  explicit TextureResidency(size_t budget = 256 * 1024 * 1024);
+
+  /**
+   * @brief Set the bytes textures may use
+   */
+  void setBudget(size_t bytes) { _budget = bytes; }
+  size_t budget() const { return _budget; }
+
+  /**
+   * @brief Return the bytes of every texture currently on the GPU
+   */
+  size_t residentBytes() const;
+
+  /**
+   * @brief Count a texture that cannot be reloaded
+   */
+  void add(TextureId id, GLuint texId, size_t bytes);
+
+  /**
+   * @brief Track a texture uploaded with all the levels of tex
+   */
+  void add(TextureId id, GLuint texId, int slot, const CachedTexture& tex);
+
+  /**
+   * @brief Track a texture being loaded by the streamer
+   */
+  void add(TextureId id, GLuint texId, int slot, const std::string& filename,
+      bool flip, bool compress, const TextureHandle& handle);
+
+  /**
+   * @brief Record that a texture is drawn this frame
+   */
+  void touch(TextureId id) {
+    if (id.index >= 0 && id.index < static_cast<int>(_entries.size())) {
+      _entries[id.index].lastUsed = _frame;
+    }
+  }
+
+  /**
+   * @brief Return whether any texture can be reloaded
+   */
+  bool hasReloadable() const { return _numReloadable > 0; }
+
+  /**
+   * @brief Finish reloads and start new ones, once per frame
+   *
+   * Must be called from the thread that owns the GL context.
+   * @param swaps Gets the texture objects that changed this frame
+   */
+  void update(TextureStreamer& streamer, std::vector<Swap>* swaps);
+
+  /**
+   * @brief Forget every texture, e.g. when the renderer is cleaned up
+   */
+  void clear();
+
+ private:
+  struct Entry {
+    bool reloadable = false;
+    GLuint texId = 0;        // 0 when evicted
+    int slot = 0;
+    std::string filename;
+    bool flip = false;
+    bool compress = true;
+    int width = 0;
+    int height = 0;
+    int numLevels = 0;       // 0 until the image was loaded once
+    TextureFormat format = TEXTURE_RGBA8;
+    int firstLevel = 0;      // largest level on the GPU
+    size_t bytes = 0;        // of the levels on the GPU
+    uint64_t lastUsed = 0;
+
+    // reload in progress, replaces texId once resident
+    TextureHandle pending;
+    GLuint pendingTexId = 0;
+    int pendingLevel = 0;
+  };
+
+  // reloads of textures that were replaced before they finished
+  struct Orphan {
+    TextureHandle handle;
+    GLuint texId;
+  };
+
+  Entry& entry(TextureId id);
+  void replace(Entry& e);
+  void finishReloads(std::vector<Swap>* swaps);
+  void reload(Entry& e, int level, TextureStreamer& streamer);
+  size_t reclaim(size_t bytes, uint64_t drawn, TextureStreamer& streamer,
+      std::vector<Swap>* swaps);
+  size_t levelBytes(const Entry& e, int firstLevel) const;
+  size_t projectedBytes(const Entry& e) const;
+  int lowLevel(const Entry& e) const;
+
+  std::vector<Entry> _entries;  // indexed by TextureId
+  std::vector<Orphan> _orphans;
+  size_t _budget;
+  uint64_t _frame;
+  int _numReloadable;
+};
+
+}  // namespace agl
+#endif  // AGL_TEXTURE_RESIDENCY_H_
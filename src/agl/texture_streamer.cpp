@@ -0,0 +1,244 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+#include "agl/texture_streamer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace agl {
+
+static const GLsizeiptr RING_ALIGNMENT = 16;
+
+bool isTextureFormatSupported(TextureFormat format) {
+  switch (format) {
+    case TEXTURE_BC1:
+    case TEXTURE_BC3:
+      return GLEW_EXT_texture_compression_s3tc;
+    case TEXTURE_BC4:
+      return GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc;
+    default:
+      return true;
+  }
+}
+
+static GLenum internalFormat(TextureFormat format) {
+  switch (format) {
+    case TEXTURE_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TEXTURE_BC4: return GL_COMPRESSED_RED_RGTC1;
+    default: return GL_RGBA8;
+  }
+}
+
+void allocateTextureStorage(const CachedTexture& tex, int firstLevel) {
+  glTexStorage2D(GL_TEXTURE_2D, tex.numLevels() - firstLevel,
+      internalFormat(tex.format()), tex.levelWidth(firstLevel),
+      tex.levelHeight(firstLevel));
+  if (tex.format() == TEXTURE_BC4) {
+    GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+  }
+}
+
+void uploadTextureLevel(const CachedTexture& tex, int level,
+    const void* pixels, int firstLevel) {
+  if (isBlockCompressed(tex.format())) {
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level - firstLevel, 0, 0,
+        tex.levelWidth(level), tex.levelHeight(level),
+        internalFormat(tex.format()),
+        static_cast<GLsizei>(tex.levelSize(level)), pixels);
+  } else {
+    glTexSubImage2D(GL_TEXTURE_2D, level - firstLevel, 0, 0,
+        tex.levelWidth(level), tex.levelHeight(level), GL_RGBA,
+        GL_UNSIGNED_BYTE, pixels);
+  }
+}
+
+TextureStreamer::TextureStreamer(GLsizeiptr ringSize) : _loader(1) {
+  _ringSize = ringSize;
+  _head = 0;
+  _map = 0;
+  _maxBytesPerUpdate = 8 * 1024 * 1024;
+  _numLoading = 0;
+
+  glGenBuffers(1, &_pbo);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+  if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+        GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, _ringSize, NULL, flags);
+    _map = static_cast<unsigned char*>(glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, _ringSize, flags));
+  } else {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, _ringSize, NULL, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer() {
+  for (InFlight& entry : _inFlight) {
+    glDeleteSync(entry.fence);
+  }
+  if (_map) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &_pbo);
+}
+
+TextureHandle TextureStreamer::request(GLuint texId, int slot,
+    const std::string& filename, bool flip, bool compress, int firstLevel) {
+  TextureHandle handle;
+  handle._state = std::make_shared<TextureHandle::State>();
+  handle._state->texId = texId;
+  handle._state->slot = slot;
+  handle._state->firstLevel = firstLevel;
+  _numLoading++;
+
+  std::shared_ptr<TextureHandle::State> state = handle._state;
+  _loader.add([state, filename, flip, compress]() {
+    if (state->texture.load(filename, flip, compress)) {
+      CachedTexture& tex = state->texture;
+      if (!isTextureFormatSupported(tex.format())) tex.decompress();
+      state->firstLevel = std::min(state->firstLevel, tex.numLevels() - 1);
+      state->numLevels = tex.numLevels();
+      state->format = tex.format();
+      state->bytes = tex.dataSize(state->firstLevel);
+      state->width = tex.width();
+      state->height = tex.height();
+    }
+  }, [this, state, filename]() {
+    if (!state->texture.loaded()) {
+      std::cout << "WARNING: cannot load texture " << filename << std::endl;
+      state->status = TextureHandle::FAILED;
+      _numLoading--;
+    } else {
+      _decoded.push_back(state);
+    }
+  });
+  return handle;
+}
+
+bool TextureStreamer::allocate(GLsizeiptr size, GLsizeiptr* offset) {
+  size = (size + RING_ALIGNMENT - 1) / RING_ALIGNMENT * RING_ALIGNMENT;
+
+  // the oldest upload still using the ring
+  GLsizeiptr tail = -1;
+  for (const InFlight& entry : _inFlight) {
+    if (entry.size > 0) {
+      tail = entry.offset;
+      break;
+    }
+  }
+
+  if (tail < 0) {
+    *offset = 0;
+  } else if (_head > tail) {
+    // free space is [head, end) and [0, tail)
+    if (_head + size <= _ringSize) {
+      *offset = _head;
+    } else if (size <= tail) {
+      *offset = 0;
+    } else {
+      return false;
+    }
+  } else {
+    // free space is [head, tail)
+    if (_head + size > tail) return false;
+    *offset = _head;
+  }
+
+  if (*offset + size > _ringSize) return false;
+  _head = *offset + size;
+  return true;
+}
+
+void TextureStreamer::upload(
+    const std::shared_ptr<TextureHandle::State>& state,
+    GLsizeiptr offset, bool useRing) {
+  const CachedTexture& tex = state->texture;
+  int firstLevel = state->firstLevel;
+  GLsizeiptr size = tex.dataSize(firstLevel);
+
+  glActiveTexture(GL_TEXTURE0 + state->slot);
+  glBindTexture(GL_TEXTURE_2D, state->texId);
+  allocateTextureStorage(tex, firstLevel);
+
+  if (useRing) {
+    // the copy into the texture reads from the ring on the GPU timeline
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+    unsigned char* dst = _map ? _map + offset :
+        static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+            offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT));
+    GLsizeiptr levelOffset = 0;
+    for (int level = firstLevel; level < tex.numLevels(); level++) {
+      memcpy(dst + levelOffset, tex.levelData(level), tex.levelSize(level));
+      levelOffset += tex.levelSize(level);
+    }
+    if (!_map) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    levelOffset = offset;
+    for (int level = firstLevel; level < tex.numLevels(); level++) {
+      uploadTextureLevel(tex, level,
+          reinterpret_cast<const GLvoid*>(levelOffset), firstLevel);
+      levelOffset += tex.levelSize(level);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  } else {
+    for (int level = firstLevel; level < tex.numLevels(); level++) {
+      uploadTextureLevel(tex, level, tex.levelData(level), firstLevel);
+    }
+  }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+      tex.numLevels() - firstLevel > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+  InFlight entry;
+  entry.offset = useRing ? offset : -1;
+  entry.size = useRing ? size : 0;
+  entry.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  entry.state = state;
+  _inFlight.push_back(entry);
+
+  state->status = TextureHandle::UPLOADING;
+  state->texture.release();  // the pixels are in the ring now
+}
+
+void TextureStreamer::retire() {
+  while (!_inFlight.empty()) {
+    InFlight& entry = _inFlight.front();
+    GLenum result = glClientWaitSync(entry.fence, 0, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    glDeleteSync(entry.fence);
+    entry.state->status = TextureHandle::RESIDENT;
+    _numLoading--;
+    _inFlight.pop_front();
+  }
+}
+
+void TextureStreamer::update() {
+  _loader.poll();
+  retire();
+
+  // always start at least one upload, even if it is over the budget
+  GLsizeiptr budget = _maxBytesPerUpdate;
+  while (!_decoded.empty()) {
+    const TextureHandle::State& next = *_decoded.front();
+    GLsizeiptr size = next.texture.dataSize(next.firstLevel);
+    if (size > budget && budget < _maxBytesPerUpdate) break;
+
+    GLsizeiptr offset = 0;
+    bool useRing = size <= _ringSize;
+    if (useRing && !allocate(size, &offset)) break;  // wait for space
+
+    upload(_decoded.front(), offset, useRing);
+    _decoded.pop_front();
+    budget -= size;
+  }
+}
+
+}  // namespace agl
@@ -0,0 +1,203 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+
+#ifndef AGL_TEXTURE_STREAMER_H_
+#define AGL_TEXTURE_STREAMER_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include "agl/agl.h"
+#include "agl/asset_loader.h"
+#include "agl/cached_texture.h"
+
+namespace agl {
+
+/**
+ * @brief Residency of a texture loaded with Renderer::streamTexture()
+ *
+ * Handles are cheap to copy and can be queried from any thread. A default
+ * constructed handle is never resident.
+ */
+class TextureHandle {
+ public:
+  /**
+   * @brief Load states
+   *
+   * * *PENDING* The file is being decoded or waits for space to upload
+   * * *UPLOADING* The copy to the texture is queued on the GPU
+   * * *RESIDENT* The texture is complete and can be drawn without stalling
+   * * *FAILED* The file could not be loaded
+   */
+  enum Status {
+    PENDING,
+    UPLOADING,
+    RESIDENT,
+    FAILED
+  };
+
+  TextureHandle() {}
+
+  /**
+   * @brief Return the current load state
+   */
+  Status status() const {
+    return _state ? static_cast<Status>(_state->status.load()) : FAILED;
+  }
+
+  /**
+   * @brief Return whether the texture can be used for drawing
+   */
+  bool isResident() const { return status() == RESIDENT; }
+
+  /**
+   * @brief Return the image size, valid once the status is UPLOADING
+   */
+  int width() const { return _state ? _state->width.load() : 0; }
+  int height() const { return _state ? _state->height.load() : 0; }
+
+  /**
+   * @brief Return the mip levels of the image and the format they were
+   * uploaded in, valid once the status is UPLOADING
+   */
+  int numLevels() const { return _state ? _state->numLevels.load() : 0; }
+  TextureFormat format() const {
+    return _state ? static_cast<TextureFormat>(_state->format.load()) :
+        TEXTURE_RGBA8;
+  }
+
+  /**
+   * @brief Return the size of the uploaded levels, valid once the status is
+   * UPLOADING
+   */
+  size_t bytes() const { return _state ? _state->bytes.load() : 0; }
+
+ private:
+  friend class TextureStreamer;
+
+  struct State {
+    std::atomic<int> status{PENDING};
+    std::atomic<int> width{0};
+    std::atomic<int> height{0};
+    std::atomic<int> numLevels{0};
+    std::atomic<int> format{TEXTURE_RGBA8};
+    std::atomic<size_t> bytes{0};
+    GLuint texId = 0;
+    int slot = 0;
+    int firstLevel = 0;     // levels above it are not uploaded
+    CachedTexture texture;  // mapped pixels, released once copied
+  };
+  std::shared_ptr<State> _state;
+};
+
+/**
+ * @brief Return whether the GPU can sample a texture format
+ *
+ * BC1 and BC3 need EXT_texture_compression_s3tc, BC4 is core since GL 3.0.
+ * Only reads what glewInit() found, so it can be called from any thread.
+ */
+bool isTextureFormatSupported(TextureFormat format);
+
+/**
+ * @brief Allocate storage for the levels of tex from firstLevel on in the
+ * bound texture
+ *
+ * firstLevel becomes level 0 of the texture, so a texture can hold only the
+ * small mip levels of an image and still be sampled with the same uvs. BC4
+ * textures are swizzled so that they sample as gray.
+ */
+void allocateTextureStorage(const CachedTexture& tex, int firstLevel = 0);
+
+/**
+ * @brief Copy a level of tex into the bound texture
+ * @param pixels The level data, or its offset in the bound pixel buffer
+ * @param firstLevel The level of tex the storage starts at
+ */
+void uploadTextureLevel(const CachedTexture& tex, int level,
+    const void* pixels, int firstLevel = 0);
+
+/**
+ * @brief Uploads textures without blocking the frame
+ *
+ * Files are loaded through their texture cache (see CachedTexture) on a
+ * worker thread. Each frame, update() copies the mip levels into a ring of
+ * pixel buffer memory and issues glTexSubImage2D from that buffer, so the
+ * driver copies to the texture asynchronously. A fence
+ * marks when the copy is done; the texture then becomes RESIDENT and its
+ * part of the ring can be reused.
+ *
+ * The ring is persistently mapped when GL 4.4 (ARB_buffer_storage) is
+ * available and mapped per upload otherwise. Images larger than the ring
+ * are uploaded directly from client memory. Block compressed caches are
+ * copied as they are, or decompressed on the worker if the GPU cannot
+ * sample their format.
+ *
+ * Users do not normally create this class, see Renderer::streamTexture().
+ */
+class TextureStreamer {
+ public:
+  /**
+   * @brief Create the streamer
+   * @param ringSize Size of the pixel buffer ring in bytes
+   */
+  explicit TextureStreamer(GLsizeiptr ringSize = 32 * 1024 * 1024);
+  ~TextureStreamer();
+
+  /**
+   * @brief Start loading a file into the texture texId
+   *
+   * The texture should be a new texture object without storage.
+   * @param flip, compress See CachedTexture::load()
+   * @param firstLevel The largest mip level to upload, see
+   * allocateTextureStorage()
+   */
+  TextureHandle request(GLuint texId, int slot, const std::string& filename,
+      bool flip, bool compress, int firstLevel = 0);
+
+  /**
+   * @brief Start uploads and retire finished ones
+   *
+   * Must be called from the thread that owns the GL context, once per frame.
+   */
+  void update();
+
+  /**
+   * @brief Limit the bytes copied into the ring per update
+   *
+   * Copying a large image takes time on the CPU too, so spreading the
+   * uploads over frames keeps frame times even.
+   */
+  void setMaxBytesPerUpdate(GLsizeiptr bytes) { _maxBytesPerUpdate = bytes; }
+
+  /**
+   * @brief Return whether any texture is still loading
+   */
+  bool busy() const { return _numLoading > 0; }
+
+ private:
+  struct InFlight {
+    GLsizeiptr offset;
+    GLsizeiptr size;
+    GLsync fence;
+    std::shared_ptr<TextureHandle::State> state;
+  };
+
+  bool allocate(GLsizeiptr size, GLsizeiptr* offset);
+  void upload(const std::shared_ptr<TextureHandle::State>& state,
+      GLsizeiptr offset, bool useRing);
+  void retire();
+
+  GLuint _pbo;
+  GLsizeiptr _ringSize;
+  GLsizeiptr _head;     // next free byte in the ring
+  unsigned char* _map;  // persistent mapping, or null
+  GLsizeiptr _maxBytesPerUpdate;
+  int _numLoading;
+
+  std::deque<std::shared_ptr<TextureHandle::State>> _decoded;
+  std::deque<InFlight> _inFlight;
+  AssetLoader _loader;  // last so that its jobs finish before the queues go
+};
+
+}  // namespace agl
+#endif  // AGL_TEXTURE_STREAMER_H_
@@ -0,0 +1,72 @@
+// Copyright 2020, Savvy Sine, Aline Normoyle
+
+#ifndef AGL_TRIPLE_BUFFER_H_
+#define AGL_TRIPLE_BUFFER_H_
+
+#include <atomic>
+
+namespace agl {
+
+/**
+ * @brief Lock-free hand-off of state from one writer thread to one reader
+ *
+ * The writer fills writeBuffer() and calls publish(). The reader calls
+ * fetch() and then uses readBuffer(), which always holds the most recently
+ * published state. Neither side ever blocks: the three slots are swapped
+ * with a single atomic exchange, so the writer can produce frame N+1 while
+ * the reader is still using frame N.
+ *
+ * T must be default constructible and copy assignable. Slots are reused, so
+ * containers inside T keep their capacity between frames.
+ *
+ * @see Window::update()
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : _shared(1), _write(0), _read(2) {}
+
+  /**
+   * @brief Return the slot owned by the writer
+   */
+  T& writeBuffer() { return _slots[_write]; }
+
+  /**
+   * @brief Make the writer slot visible to the reader
+   *
+   * The writer receives the previously shared slot, whose contents are
+   * stale; writers should overwrite every field before publishing again.
+   */
+  void publish() {
+    int prev = _shared.exchange(_write | DIRTY, std::memory_order_acq_rel);
+    _write = prev & INDEX;
+  }
+
+  /**
+   * @brief Swap in the latest published state, if any
+   * @return true if readBuffer() changed
+   */
+  bool fetch() {
+    if (!(_shared.load(std::memory_order_relaxed) & DIRTY)) return false;
+    int prev = _shared.exchange(_read, std::memory_order_acq_rel);
+    _read = prev & INDEX;
+    return true;
+  }
+
+  /**
+   * @brief Return the slot owned by the reader
+   */
+  const T& readBuffer() const { return _slots[_read]; }
+
+ private:
+  static const int INDEX = 3;
+  static const int DIRTY = 4;
+
+  T _slots[3];
+  std::atomic<int> _shared;  // slot index in transit, plus the DIRTY flag
+  int _write;                // only touched by the writer
+  int _read;                 // only touched by the reader
+};
+
+}  // namespace agl
+#endif  // AGL_TRIPLE_BUFFER_H_
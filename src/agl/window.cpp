@@ -3,6 +3,10 @@
 #include "agl/window.h"
 #include <string>
 #include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace agl {
@@ -13,6 +17,8 @@ using glm::mat3;
 using glm::mat4;
 
 static Window* theInstance = 0;
+static thread_local bool isUpdateThread = false;
+static thread_local bool inFixedUpdate = false;
 
 static void error_callback(int error, const char* description) {
   fputs("\n", stderr);
@@ -26,7 +32,24 @@ Window::Window() :
   _backgroundColor(0.0f),
   _elapsedTime(0.0),
   _lastx(0), _lasty(0),
-  _dt(-1.0) {
+  _dt(-1.0),
+  _smoothDt(-1.0),
+  _frameRateLimit(0.0f),
+  _frameIndex(0),
+  _fixedUpdate(false),
+  _threadedUpdate(false),
+  _updateRate(120.0f),
+  _updateDt(0.0f),
+  _simTime(0.0),
+  _frameTime(0.0),
+  _updateRunning(false),
+  _eventHead(0),
+  _eventTail(0),
+  _mouseX(0.0f),
+  _mouseY(0.0f) {
+  _frameTimes.reserve(FrameHistorySize);
+  for (int i = 0; i <= GLFW_KEY_LAST; i++) _keys[i] = false;
+  for (int i = 0; i <= GLFW_MOUSE_BUTTON_LAST; i++) _buttons[i] = false;
   init();
 }
 
@@ -113,20 +136,191 @@ void Window::run() {
 
   setup();
 
+  _simTime = glfwGetTime();
+  _frameTime = _simTime;
+  if (_threadedUpdate) {
+    _updateRunning = true;
+    _updateThread = std::thread(&Window::updateLoop, this);
+  }
+
+  double frameStart = glfwGetTime();
+  bool firstFrame = true;
   while (!glfwWindowShouldClose(_window)) {
-    float time = glfwGetTime();
-    _dt = time - _elapsedTime;
-    _elapsedTime = time;
+    double time = glfwGetTime();
+    _dt = static_cast<float>(time - frameStart);
+    _elapsedTime = static_cast<float>(time);
+    _frameTime = time;
+    frameStart = time;
+
+    // the first frame includes setup(), so it is not a real frame time
+    if (firstFrame) {
+      firstFrame = false;
+    } else {
+      recordFrameTime(_dt);
+    }
+
+    if (_threadedUpdate) {
+      // the update thread steps on its own
+    } else if (_fixedUpdate) {
+      runFixedUpdates(time);
+    } else {
+      update();  // user function
+    }
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    renderer.updateTextures();
     renderer.identity();
     draw();  // user function
+    renderer.flushBatches();
+    renderer.flushText();
     renderer.cleanupShaders();
 
+    waitForFrame(frameStart);
     glfwSwapBuffers(_window);
     glfwPollEvents();
   }
+
+  if (_updateThread.joinable()) {
+    _updateRunning = false;
+    _updateThread.join();
+  }
+}
+
+void Window::updateLoop() {
+  isUpdateThread = true;
+
+  while (_updateRunning) {
+    dispatchEvents();
+    runFixedUpdates(glfwGetTime());
+
+    // sleep until the next step is due
+    double remaining = _simTime + 1.0 / _updateRate - glfwGetTime();
+    if (remaining > 0.0) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+    }
+  }
+}
+
+void Window::runFixedUpdates(double time) {
+  double step = 1.0 / _updateRate;
+  _updateDt = static_cast<float>(step);
+
+  inFixedUpdate = true;
+  int steps = 0;
+  while (_simTime + step <= time && steps < MaxUpdatesPerFrame) {
+    update();  // user function
+    _simTime += step;
+    steps++;
+  }
+  inFixedUpdate = false;
+
+  // after a stall, skip ahead rather than spend the next frames catching up
+  if (time - _simTime > step) {
+    _simTime = time - step;
+  }
+}
+
+double Window::stepTime() const {
+  if (isUpdateThread || inFixedUpdate) return _simTime + 1.0 / _updateRate;
+  return _frameTime;
+}
+
+float Window::interpolationAlpha(double stepTime) const {
+  if (!_threadedUpdate && !_fixedUpdate) return 1.0f;
+  double step = 1.0 / _updateRate;
+  float alpha = static_cast<float>((_frameTime - stepTime) / step);
+  return std::min(std::max(alpha, 0.0f), 1.0f);
+}
+
+void Window::pushEvent(const InputEvent& event) {
+  unsigned head = _eventHead.load(std::memory_order_relaxed);
+  if (head - _eventTail.load(std::memory_order_acquire) >= EventQueueSize) {
+    return;  // the update thread is far behind, drop the event
+  }
+  _events[head % EventQueueSize] = event;
+  _eventHead.store(head + 1, std::memory_order_release);
+}
+
+void Window::dispatchEvents() {
+  unsigned head = _eventHead.load(std::memory_order_acquire);
+  unsigned tail = _eventTail.load(std::memory_order_relaxed);
+  while (tail != head) {
+    InputEvent e = _events[tail % EventQueueSize];
+    _eventTail.store(++tail, std::memory_order_release);
+
+    switch (e.type) {  // user hooks
+      case InputEvent::KEY_DOWN: keyDown(e.a, e.b); break;
+      case InputEvent::KEY_UP: keyUp(e.a, e.b); break;
+      case InputEvent::MOUSE_DOWN: mouseDown(e.a, e.b); break;
+      case InputEvent::MOUSE_UP: mouseUp(e.a, e.b); break;
+      case InputEvent::MOUSE_MOTION: mouseMotion(e.a, e.b, e.c, e.d); break;
+      case InputEvent::SCROLL: scroll(e.x, e.y); break;
+    }
+  }
+}
+
+void Window::setFixedUpdate(float updateRate) {
+  _fixedUpdate = updateRate > 0.0f;
+  if (_fixedUpdate) _updateRate = std::max(updateRate, 1.0f);
+}
+
+void Window::setThreadedUpdate(bool enabled, float updateRate) {
+  assert(!_updateThread.joinable());  // call from setup()
+  _threadedUpdate = enabled;
+  _updateRate = std::max(updateRate, 1.0f);
+}
+
+void Window::waitForFrame(double frameStart) {
+  if (_frameRateLimit <= 0.0f) return;
+
+  // sleep until shortly before the deadline, then spin the rest of the way
+  const double spinTime = 0.002;
+  double deadline = frameStart + 1.0 / _frameRateLimit;
+  double remaining = deadline - glfwGetTime();
+  if (remaining > spinTime) {
+    std::this_thread::sleep_for(
+        std::chrono::duration<double>(remaining - spinTime));
+  }
+  while (glfwGetTime() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+void Window::recordFrameTime(float frameTime) {
+  if (static_cast<int>(_frameTimes.size()) < FrameHistorySize) {
+    _frameTimes.push_back(frameTime);
+  } else {
+    _frameTimes[_frameIndex] = frameTime;
+  }
+  _frameIndex = (_frameIndex + 1) % FrameHistorySize;
+
+  // exponential moving average over roughly the last 10 frames
+  if (_smoothDt < 0.0f) {
+    _smoothDt = frameTime;
+  } else {
+    _smoothDt += 0.1f * (frameTime - _smoothDt);
+  }
+}
+
+void Window::setVSync(VSync mode) {
+  int interval = 1;
+  if (mode == VSYNC_OFF) {
+    interval = 0;
+
+  } else if (mode == VSYNC_ADAPTIVE) {
+    if (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+        glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+      interval = -1;
+    } else {
+      std::cout << "Adaptive vsync is not supported. Using vsync instead\n";
+    }
+  }
+  glfwSwapInterval(interval);
+}
+
+void Window::setFrameRateLimit(float fps) {
+  _frameRateLimit = std::max(fps, 0.0f);
 }
 
 bool Window::screenshot(const std::string& filename) {
@@ -138,24 +332,12 @@ bool Window::screenshot(const std::string& filename) {
   int width = viewport[2];
   int height = viewport[3];
 
-  size_t size = static_cast<size_t>(width * height * 4);
-  unsigned char *data = static_cast<unsigned char*>(malloc(size));
-
-  if (!data) {
-    return false;
-  }
-
+  // read straight into the image, which keeps all stb code referenced from
+  // a single file (needed for header-only include)
+  Image image(width, height);
   glPixelStorei(GL_PACK_ALIGNMENT, 1);
-  glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
-
-  // Using Image introduces another copy but makes it easier to keep all
-  // stb code referenced from a single file (needed for header-only include)
-  Image image;
-  image.set(width, height, data);
-  bool result = image.save(filename);
-
-  free(data);
-  return result;
+  glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+  return image.save(filename);
 }
 
 float Window::height() const {
@@ -167,25 +349,58 @@ float Window::width() const {
 }
 
 float Window::dt() const {
-  return _dt;
+  return isUpdateThread || inFixedUpdate ? _updateDt : _dt;
 }
 
 float Window::elapsedTime() const {
   return _elapsedTime;
 }
 
+float Window::smoothDt() const {
+  // fixed updates need no smoothing
+  if (isUpdateThread || inFixedUpdate) return _updateDt;
+  return _smoothDt < 0.0f ? _dt : _smoothDt;
+}
+
+float Window::frameTimePercentile(float percentile) const {
+  if (_frameTimes.empty()) return 0.0f;
+
+  std::vector<float> sorted = _frameTimes;
+  float p = std::min(std::max(percentile, 0.0f), 100.0f) / 100.0f;
+  size_t n = static_cast<size_t>(p * (sorted.size() - 1) + 0.5f);
+  std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+  return sorted[n];
+}
+
+std::vector<int> Window::frameTimeHistogram(float binWidth, int numBins) const {
+  std::vector<int> bins(std::max(numBins, 1), 0);
+  for (float frameTime : _frameTimes) {
+    int bin = static_cast<int>(frameTime / binWidth);
+    bins[std::min(bin, static_cast<int>(bins.size()) - 1)]++;
+  }
+  return bins;
+}
+
 glm::vec2 Window::mousePosition() const {
+  if (_threadedUpdate) return glm::vec2(_mouseX.load(), _mouseY.load());
+
   double xpos, ypos;
   glfwGetCursorPos(_window, &xpos, &ypos);
   return glm::vec2(static_cast<float>(xpos), static_cast<float>(ypos));
 }
 
 bool Window::keyIsDown(int key) const {
+  if (_threadedUpdate) return key >= 0 && key <= GLFW_KEY_LAST && _keys[key];
+
   int state = glfwGetKey(_window, key);
   return (state == GLFW_PRESS);
 }
 
 bool Window::mouseIsDown(int button) const {
+  if (_threadedUpdate) {
+    return button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST && _buttons[button];
+  }
+
   int state = glfwGetMouseButton(_window, button);
   return (state == GLFW_PRESS);
 }
@@ -221,6 +436,7 @@ void Window::init() {
   }
 
   glfwMakeContextCurrent(_window);
+  glfwSwapInterval(1);
   glfwSetKeyCallback(_window, Window::onKeyboardCb);
   glfwSetFramebufferSizeCallback(_window, Window::onResizeCb);
   glfwSetMouseButtonCallback(_window, Window::onMouseButtonCb);
@@ -246,10 +462,19 @@ void Window::onMouseMotionCb(GLFWwindow* win, double pX, double pY) {
 }
 
 void Window::onMouseMotion(int pX, int pY) {
-  glm::vec2 mousePos = mousePosition();
+  double xpos, ypos;
+  glfwGetCursorPos(_window, &xpos, &ypos);
+  glm::vec2 mousePos(static_cast<float>(xpos), static_cast<float>(ypos));
+  _mouseX = mousePos.x;
+  _mouseY = mousePos.y;
+
   int dx = mousePos.x - _lastx;
   int dy = mousePos.y - _lasty;
-  mouseMotion(pX, pY, dx, dy);  // user hook
+  if (_threadedUpdate) {
+    pushEvent({InputEvent::MOUSE_MOTION, pX, pY, dx, dy, 0.0f, 0.0f});
+  } else {
+    mouseMotion(pX, pY, dx, dy);  // user hook
+  }
   _lastx = mousePos.x;
   _lasty = mousePos.y;
 }
@@ -263,13 +488,25 @@ void Window::onMouseButton(int button, int action, int mods) {
   double xpos, ypos;
   glfwGetCursorPos(_window, &xpos, &ypos);
 
+  if (button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST) {
+    _buttons[button] = (action == GLFW_PRESS);
+  }
+
   if (action == GLFW_PRESS) {
     _lastx = xpos;
     _lasty = ypos;
-    mouseDown(button, mods);
+    if (_threadedUpdate) {
+      pushEvent({InputEvent::MOUSE_DOWN, button, mods, 0, 0, 0.0f, 0.0f});
+    } else {
+      mouseDown(button, mods);
+    }
 
   } else if (action == GLFW_RELEASE) {
-    mouseUp(button, mods);
+    if (_threadedUpdate) {
+      pushEvent({InputEvent::MOUSE_UP, button, mods, 0, 0, 0.0f, 0.0f});
+    } else {
+      mouseUp(button, mods);
+    }
   }
 
   onMouseMotion(static_cast<float>(xpos), static_cast<float>(ypos));
@@ -286,10 +523,22 @@ void Window::onKeyboard(int key, int scancode, int action, int mods) {
     glfwSetWindowShouldClose(_window, GL_TRUE);
   }
 
+  if (key >= 0 && key <= GLFW_KEY_LAST) {
+    _keys[key] = (action != GLFW_RELEASE);
+  }
+
   if (action == GLFW_PRESS) {
-    keyDown(key, mods);
+    if (_threadedUpdate) {
+      pushEvent({InputEvent::KEY_DOWN, key, mods, 0, 0, 0.0f, 0.0f});
+    } else {
+      keyDown(key, mods);
+    }
   } else if (action == GLFW_RELEASE) {
-    keyUp(key, mods);
+    if (_threadedUpdate) {
+      pushEvent({InputEvent::KEY_UP, key, mods, 0, 0, 0.0f, 0.0f});
+    } else {
+      keyUp(key, mods);
+    }
   }
 }
 
@@ -300,7 +549,11 @@ void Window::onScrollCb(GLFWwindow* win, double xoffset, double yoffset) {
 }
 
 void Window::onScroll(float xoffset, float yoffset) {
-  scroll(xoffset, yoffset);  // user hook
+  if (_threadedUpdate) {
+    pushEvent({InputEvent::SCROLL, 0, 0, 0, 0, xoffset, yoffset});
+  } else {
+    scroll(xoffset, yoffset);  // user hook
+  }
 }
 
 void Window::onResizeCb(GLFWwindow* window, int width, int height) {
@@ -3,14 +3,33 @@
 #ifndef AGL_WINDOW_H_
 #define AGL_WINDOW_H_
 
+#include <atomic>
 #include <string>
 #include <map>
+#include <thread>
+#include <vector>
 #include "agl/agl.h"
 #include "agl/aglm.h"
 #include "agl/renderer.h"
 
 namespace agl {
 
+/**
+ * @brief Swap interval modes
+ *
+ * * *VSYNC_OFF* Swap buffers immediately (may tear)
+ * * *VSYNC_ON* Wait for the vertical blank before swapping
+ * * *VSYNC_ADAPTIVE* Wait for the vertical blank unless the frame is late, in
+ *   which case swap immediately. Falls back to VSYNC_ON when the driver does
+ *   not support swap control tear.
+ * @see Window::setVSync(VSync)
+ */
+enum VSync {
+  VSYNC_OFF,
+  VSYNC_ON,
+  VSYNC_ADAPTIVE
+};
+
 /**
  * @brief Manages the window and user input.
  *
@@ -75,9 +94,31 @@ class Window {
    */
   virtual void setup() {}
 
+  /**
+   * @brief Override this method to update the simulation
+   *
+   * update() is called once per frame before draw(). With a fixed update
+   * rate, it is instead called as many times as the elapsed time requires
+   * (possibly zero) and dt() returns the fixed step, so the simulation
+   * advances the same way at any frame rate. When threaded updates are
+   * enabled, the fixed steps run on their own thread, concurrently with
+   * draw(). In that case, update() must not call the renderer and should
+   * hand its results to draw() through a TripleBuffer. Input hooks
+   * (keyDown, mouseMotion, etc.) are called on the update thread before
+   * update().
+   *
+   * @see setFixedUpdate(float)
+   * @see setThreadedUpdate(bool, float)
+   * @see TripleBuffer
+   */
+  virtual void update() {}
+
   /**
    * @brief Override this method to draw
    *
+   * With a fixed update rate, draw state that moves should be interpolated
+   * between the last two updates by interpolationAlpha(double).
+   *
    * @verbinclude plane.cpp
    */
   virtual void draw() {}
@@ -189,7 +230,8 @@ class Window {
    * @brief Return the amount of time since the previous frame (in seconds)
    *
    * If the frame rate is 30 frames per second, dt would be approximately 1/30
-   * = 0.033333 seconds each frame
+   * = 0.033333 seconds each frame. When called from update() with a fixed
+   * update rate, returns the fixed step.
    */
   float dt() const;  // amount of time since last frame
 
@@ -198,6 +240,50 @@ class Window {
    */
   float elapsedTime() const;  // amount of time since start (can be reset)
 
+  /** 
+   * @brief Return dt averaged over the last few frames (in seconds)
+   *
+   * The smoothed value follows the frame rate but filters out single slow or
+   * fast frames, which makes it better suited for camera smoothing and other
+   * frame-rate independent interpolation.
+   * @see dt()
+   */
+  float smoothDt() const;
+
+  /** 
+   * @brief Return the given percentile of recent frame times (in seconds)
+   * @param percentile The percentile in [0, 100], e.g. 99
+   *
+   * Frame times are kept for the last 512 frames.
+   * @see frameTimeHistogram(float, int)
+   */
+  float frameTimePercentile(float percentile) const;
+
+  /** 
+   * @brief Return the median frame time of recent frames (in seconds)
+   */
+  float frameTimeP50() const { return frameTimePercentile(50.0f); }
+
+  /** 
+   * @brief Return the 95th percentile frame time of recent frames (in seconds)
+   */
+  float frameTimeP95() const { return frameTimePercentile(95.0f); }
+
+  /** 
+   * @brief Return the 99th percentile frame time of recent frames (in seconds)
+   */
+  float frameTimeP99() const { return frameTimePercentile(99.0f); }
+
+  /** 
+   * @brief Return a histogram of recent frame times
+   * @param binWidth The width of each bin (in seconds)
+   * @param numBins The number of bins. The last bin also counts all longer
+   * frames.
+   * @return The number of frames in each bin
+   */
+  std::vector<int> frameTimeHistogram(float binWidth = 0.001f,
+      int numBins = 50) const;
+
   /** 
    * @brief Return the window height in pixels
    */
@@ -236,6 +322,73 @@ class Window {
    */
   void setWindowSize(int w, int h);
 
+  /**
+   * @brief Set the swap interval used when presenting frames
+   *
+   * The default is VSYNC_ON.
+   * @see VSync
+   */
+  void setVSync(VSync mode);
+
+  /**
+   * @brief Cap the frame rate
+   * @param fps The maximum number of frames per second (0 for no cap)
+   *
+   * The main loop sleeps for most of the remaining frame time and spins for
+   * the last few milliseconds, since sleeping alone is not precise enough to
+   * deliver evenly spaced frames.
+   */
+  void setFrameRateLimit(float fps);
+
+  /**
+   * @brief Run update() in fixed steps
+   * @param updateRate The number of updates per second, 0 to call update()
+   * once per frame (the default)
+   *
+   * The simulation then gives the same results at 30 and 240 frames per
+   * second, and can run at a lower rate than drawing. At most
+   * MaxUpdatesPerFrame steps run per frame; after a longer stall the
+   * simulation skips ahead instead of catching up.
+   * @see update()
+   * @see interpolationAlpha(double)
+   */
+  void setFixedUpdate(float updateRate);
+
+  /**
+   * @brief Run update() on its own thread
+   * @param enabled Whether update() runs on a separate thread
+   * @param updateRate The number of updates per second
+   *
+   * Call this from setup(). The simulation then overlaps with drawing and
+   * GPU submission instead of adding to the frame time. Threaded updates
+   * always run in fixed steps.
+   * @see update()
+   */
+  void setThreadedUpdate(bool enabled, float updateRate = 120.0f);
+
+  /**
+   * @brief Return the time (see glfwGetTime()) the current update() step
+   * simulates up to
+   *
+   * Store it with the state update() hands to draw(), and pass it back to
+   * interpolationAlpha(double). Outside of fixed updates, returns the start
+   * time of the current frame.
+   */
+  double stepTime() const;
+
+  /**
+   * @brief Return where the frame falls between a state and the one before
+   * @param stepTime The stepTime() of the update that produced the state
+   *
+   * With a fixed update rate, the frame being drawn is up to one step past
+   * the latest update. Drawing mix(previous, latest, alpha) of positions
+   * and orientations shows the simulation one step late but without the
+   * stutter of updates landing unevenly on frames. The alpha must come from
+   * the time of the state being drawn: with threaded updates, a newer state
+   * may be published at any moment. Returns 1 when updates are not fixed.
+   */
+  float interpolationAlpha(double stepTime) const;
+
   /**
    * @brief Initialize the projection and camera to fit the given dimensions
    * and center using an orthographic projection
@@ -306,6 +459,20 @@ class Window {
   void onKeyboard(int key, int scancode, int action, int mods);
   void onResize(int width, int height);
   void onScroll(float xoffset, float yoffset);
+  void waitForFrame(double frameStart);
+  void updateLoop();
+  void runFixedUpdates(double time);
+
+  // Input events are queued for the update thread when updates are threaded
+  struct InputEvent {
+    enum Type { KEY_DOWN, KEY_UP, MOUSE_DOWN, MOUSE_UP, MOUSE_MOTION, SCROLL };
+    Type type;
+    int a, b, c, d;
+    float x, y;
+  };
+  void pushEvent(const InputEvent& event);
+  void dispatchEvents();
+  void recordFrameTime(float frameTime);
 
  protected:
   Renderer renderer;
@@ -314,6 +481,31 @@ class Window {
   int _windowWidth, _windowHeight;
   float _elapsedTime;
   float _dt;
+  float _smoothDt;
+  float _frameRateLimit;
+  static const int FrameHistorySize = 512;
+  std::vector<float> _frameTimes;  // ring buffer of recent frame times
+  int _frameIndex;
+
+  static const int MaxUpdatesPerFrame = 8;
+  bool _fixedUpdate;
+  bool _threadedUpdate;
+  float _updateRate;
+  float _updateDt;
+  double _simTime;    // time the simulation has reached
+  double _frameTime;  // start of the frame being drawn
+  std::thread _updateThread;
+  std::atomic<bool> _updateRunning;
+
+  // single producer (GLFW callbacks), single consumer (update thread)
+  static const unsigned EventQueueSize = 256;
+  InputEvent _events[EventQueueSize];
+  std::atomic<unsigned> _eventHead;
+  std::atomic<unsigned> _eventTail;
+  std::atomic<bool> _keys[GLFW_KEY_LAST + 1];
+  std::atomic<bool> _buttons[GLFW_MOUSE_BUTTON_LAST + 1];
+  std::atomic<float> _mouseX;
+  std::atomic<float> _mouseY;
   float _lastx, _lasty;
   glm::vec3 _backgroundColor;
   struct GLFWwindow* _window = 0;
@@ -0,0 +1,319 @@
+// Bryn Mawr College, alinen, 2020
+//
+
+/**
+ * Offline asset cooker for Slenderman.
+ *
+ * Walks the models, textures and shaders directories and builds the caches
+ * the game loads at runtime, so that players never parse a PLY file or
+ * decode an image:
+ *   - models/<name>.ply -> models/cache/<name>.ply.mesh (see CachedMesh)
+ *   - images -> <dir>/cache/<name>[.flip][.rgba].tex with mip levels (see
+ *     CachedTexture), with the options the game loads them with (see
+ *     textureOptions())
+ *   - fonts/<name>.ttf -> fonts/cache/<name>.ttf.sdf, a distance field atlas
+ *     (see SdfFont)
+ *   - shaders are compiled in a hidden GL context to catch errors early
+ *   - everything is listed with its size, bounds and hash in assets.manifest
+ *
+ * Caches are only rebuilt when their source changed (size and time, then
+ * content hash), so running the cooker again is cheap.
+ *
+ * Usage: assetcook [--force] [--no-shaders] [root]
+ *   root defaults to "..", the same directory the game loads from
+ *
+ * Author: David Dinh
+ * Date: April 27, 2023
+*/
+
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "agl/agl.h"
+#include "agl/asset_loader.h"
+#include "agl/asset_manifest.h"
+#include "agl/cache_file.h"
+#include "agl/cached_texture.h"
+#include "agl/sdf_font.h"
+#include "agl/shader.h"
+#include "cachedmesh.h"
+#include "osutils.h"
+#include "textureoptions.h"
+
+using namespace std;
+using namespace agl;
+
+struct CookStats {
+	int cooked= 0;
+	int current= 0;
+	int failed= 0;
+};
+
+static string lowerExtension(const string& filename) {
+	size_t dot= filename.rfind('.');
+	if (dot == string::npos) return "";
+	string ext= filename.substr(dot);
+	std::transform(ext.begin(), ext.end(), ext.begin(),
+		[](unsigned char c) { return (char) std::tolower(c); });
+	return ext;
+}
+
+// Collects the files in dir and its subdirectories with one of the given
+// extensions, skipping the cache directories
+static void findFiles(const string& dir, const vector<string>& extensions,
+	vector<string>& files) {
+	for (const string& name : GetFilenamesInDir(dir, ".")) {
+		string ext= lowerExtension(name);
+		if (std::find(extensions.begin(), extensions.end(), ext) != extensions.end()) {
+			files.push_back(dir + "/" + name);
+		}
+	}
+	for (const string& sub : GetSubdirsInDir(dir)) {
+		if (sub != "cache") findFiles(dir + "/" + sub, extensions, files);
+	}
+}
+
+// Stores the size and time of the source with its hash, so that the game
+// only hashes sources whose time changed (see AssetManifest::findCurrent())
+static void stampSource(AssetInfo& info) {
+	fileTimeAndSize(info.path, &info.size, &info.time);
+}
+
+static void cookMeshes(AssetLoader& loader, const vector<string>& files,
+	bool force, AssetManifest& manifest, CookStats& stats) {
+	for (const string& path : files) {
+		std::shared_ptr<CachedMesh> mesh= std::make_shared<CachedMesh>();
+		std::shared_ptr<bool> current= std::make_shared<bool>(false);
+		loader.add([=]() {
+			if (force) std::remove(CachedMesh::cachePath(path).c_str());
+			*current= CachedMesh::isCacheCurrent(path);
+			mesh->load(path);
+		}, [=, &manifest, &stats]() {
+			if (mesh->numVertices() == 0) {
+				cout << "FAILED   " << path << endl;
+				stats.failed++;
+				return;
+			}
+			cout << (*current ? "current  " : "cooked   ") << path << endl;
+			(*current ? stats.current : stats.cooked)++;
+
+			AssetInfo info;
+			info.type= AssetInfo::MESH;
+			info.path= path;
+			info.hash= mesh->sourceHash();
+			stampSource(info);
+			info.boundsMin= mesh->minBounds();
+			info.boundsMax= mesh->maxBounds();
+			manifest.add(info);
+		});
+	}
+}
+
+static void cookTextures(AssetLoader& loader, const vector<string>& files,
+	bool force, AssetManifest& manifest, CookStats& stats) {
+	for (const string& path : files) {
+		std::shared_ptr<CachedTexture> tex= std::make_shared<CachedTexture>();
+		std::shared_ptr<bool> current= std::make_shared<bool>(false);
+		TextureOptions options= textureOptions(path);
+		bool flip= options.flip;
+		bool compress= options.compress;
+		loader.add([=]() {
+			if (force) std::remove(CachedTexture::cachePath(path, flip, compress).c_str());
+			*current= CachedTexture::isCacheCurrent(path, flip, compress);
+			if (tex->load(path, flip, compress)) tex->release();
+		}, [=, &manifest, &stats]() {
+			if (tex->width() == 0) {
+				cout << "FAILED   " << path << endl;
+				stats.failed++;
+				return;
+			}
+			cout << (*current ? "current  " : "cooked   ") << path << endl;
+			(*current ? stats.current : stats.cooked)++;
+
+			AssetInfo info;
+			info.type= AssetInfo::TEXTURE;
+			info.path= path;
+			info.hash= tex->sourceHash();
+			stampSource(info);
+			info.width= tex->width();
+			info.height= tex->height();
+			info.aspect= tex->aspect();
+			manifest.add(info);
+		});
+	}
+}
+
+static void cookFonts(AssetLoader& loader, const vector<string>& files,
+	bool force, AssetManifest& manifest, CookStats& stats) {
+	for (const string& path : files) {
+		std::shared_ptr<SdfFont> font= std::make_shared<SdfFont>();
+		std::shared_ptr<bool> current= std::make_shared<bool>(false);
+		loader.add([=]() {
+			if (force) std::remove(SdfFont::cachePath(path).c_str());
+			*current= SdfFont::isCacheCurrent(path);
+			if (font->load(path)) font->release();
+		}, [=, &manifest, &stats]() {
+			if (!font->valid()) {
+				cout << "FAILED   " << path << endl;
+				stats.failed++;
+				return;
+			}
+			cout << (*current ? "current  " : "cooked   ") << path << endl;
+			(*current ? stats.current : stats.cooked)++;
+
+			AssetInfo info;
+			info.type= AssetInfo::FONT;
+			info.path= path;
+			info.hash= font->sourceHash();
+			stampSource(info);
+			info.width= font->width();
+			info.height= font->height();
+			info.aspect= (float) font->width() / font->height();
+			manifest.add(info);
+		});
+	}
+}
+
+// Creates an invisible window with the same context as the game
+static GLFWwindow* createHiddenContext() {
+	if (!glfwInit()) return nullptr;
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow* window= glfwCreateWindow(64, 64, "assetcook", NULL, NULL);
+	if (!window) return nullptr;
+	glfwMakeContextCurrent(window);
+#ifndef APPLE
+	glewExperimental= GL_TRUE;
+	if (glewInit() != GLEW_OK) return nullptr;
+#endif
+	return window;
+}
+
+// Returns the #version of a shader file (e.g. 410), or 0 if it has none
+static int shaderVersion(const string& path) {
+	std::ifstream in(path);
+	string line;
+	while (std::getline(in, line)) {
+		size_t pos= line.find("#version");
+		if (pos != string::npos) return std::atoi(line.c_str() + pos + 8);
+	}
+	return 0;
+}
+
+// Compiles every shader, and links the vertex and fragment shaders that
+// share a name. Shaders for a newer GLSL than the context (e.g. the
+// multi-draw indirect variants, which the game only loads on GL 4.3) are
+// skipped, since they cannot compile here.
+static void validateShaders(const vector<string>& files,
+	AssetManifest& manifest, CookStats& stats) {
+	int major= 0, minor= 0;
+	const char* glsl= (const char*) glGetString(GL_SHADING_LANGUAGE_VERSION);
+	if (glsl) std::sscanf(glsl, "%d.%d", &major, &minor);
+	int contextVersion= major * 100 + minor;
+
+	for (const string& path : files) {
+		int version= shaderVersion(path);
+		if (version > contextVersion) {
+			cout << "skipped  " << path << " (needs GLSL " << version << ")" << endl;
+			continue;
+		}
+
+		bool ok= true;
+		try {
+			Shader shader;
+			shader.compileShader(path);
+			string ext= lowerExtension(path);
+			string fs= path.substr(0, path.size() - ext.size()) + ".fs";
+			if (ext == ".vs" && std::find(files.begin(), files.end(), fs) != files.end()) {
+				shader.compileShader(fs);
+				shader.link();
+			}
+		} catch (const GLSLProgramException& e) {
+			cout << "FAILED   " << path << "\n" << e.what() << endl;
+			stats.failed++;
+			ok= false;
+		}
+		if (!ok) continue;
+
+		cout << "valid    " << path << endl;
+		stats.current++;
+		AssetInfo info;
+		info.type= AssetInfo::SHADER;
+		info.path= path;
+		SourceStamp stamp;
+		if (stamp.read(path)) {
+			info.hash= stamp.hash;
+			info.size= stamp.size;
+			info.time= stamp.time;
+		}
+		manifest.add(info);
+	}
+}
+
+int main(int argc, char** argv) {
+	bool force= false;
+	bool shaders= true;
+	string root= "..";
+	for (int i= 1; i < argc; i++) {
+		string arg= argv[i];
+		if (arg == "--force") {
+			force= true;
+		} else if (arg == "--no-shaders") {
+			shaders= false;
+		} else if (!arg.empty() && arg[0] == '-') {
+			cout << "Usage: assetcook [--force] [--no-shaders] [root]" << endl;
+			return 1;
+		} else {
+			root= arg;
+		}
+	}
+
+	vector<string> meshFiles;
+	vector<string> textureFiles;
+	vector<string> fontFiles;
+	vector<string> shaderFiles;
+	findFiles(root + "/models", { ".ply" }, meshFiles);
+	findFiles(root + "/textures", { ".png", ".jpg", ".jpeg", ".bmp", ".tga" },
+		textureFiles);
+	findFiles(root + "/fonts", { ".ttf" }, fontFiles);
+	findFiles(root + "/shaders", { ".vs", ".fs", ".gs", ".tcs", ".tes", ".cs" },
+		shaderFiles);
+
+	// the manifest is rebuilt every time so that deleted assets drop out
+	string manifestPath= root + "/assets.manifest";
+	AssetManifest manifest;
+
+	CookStats stats;
+	{
+		AssetLoader loader;
+		cookMeshes(loader, meshFiles, force, manifest, stats);
+		cookTextures(loader, textureFiles, force, manifest, stats);
+		cookFonts(loader, fontFiles, force, manifest, stats);
+		loader.wait();
+	}
+
+	if (shaders) {
+		GLFWwindow* window= createHiddenContext();
+		if (window) {
+			validateShaders(shaderFiles, manifest, stats);
+			glfwDestroyWindow(window);
+		} else {
+			cout << "WARNING: no OpenGL context, shaders were not validated" << endl;
+		}
+		glfwTerminate();
+	}
+
+	if (!manifest.save(manifestPath)) stats.failed++;
+	cout << stats.cooked << " cooked, " << stats.current << " up to date, "
+		<< stats.failed << " failed" << endl;
+	return stats.failed > 0 ? 1 : 0;
+}
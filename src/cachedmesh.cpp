@@ -0,0 +1,291 @@
+//--------------------------------------------------
+// Author: David Dinh
+// Date: March 2. 2023
+// Description: Triangle mesh loaded from a memory-mapped binary cache
+//--------------------------------------------------
+
+#include "cachedmesh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include "agl/cache_file.h"
+#include "agl/renderer.h"
+#include "plymesh.h"
+
+using namespace std;
+using namespace glm;
+
+namespace agl {
+
+  static const char MESH_MAGIC[8]= "AGLMESH";
+  static const uint32_t MESH_VERSION= 2;
+  static const uint32_t HAS_NORMALS= 1;
+  static const uint32_t HAS_UV= 2;
+
+  static size_t align16(size_t n) {
+    return (n + 15) & ~(size_t) 15;
+  }
+
+  static const MeshCacheHeader& header(const MappedFile& file) {
+    return *(const MeshCacheHeader*) file.data();
+  }
+
+  // Checks that the header and every blob fit inside the file
+  static bool isValidCache(const MappedFile& file) {
+    if (file.size() < sizeof(MeshCacheHeader)) return false;
+    const MeshCacheHeader& header= agl::header(file);
+    if (memcmp(header.magic, MESH_MAGIC, sizeof(MESH_MAGIC)) != 0) return false;
+    if (header.version != MESH_VERSION) return false;
+
+    uint64_t nv= header.numVertices;
+    uint64_t blobs[][2]= {
+      {header.positionsOffset, nv * 3 * sizeof(GLfloat)},
+      {header.normalsOffset, (header.flags & HAS_NORMALS) ? nv * 3 * sizeof(GLfloat) : 0},
+      {header.texCoordsOffset, (header.flags & HAS_UV) ? nv * 2 * sizeof(GLfloat) : 0},
+      {header.indicesOffset, header.numIndices * sizeof(GLuint)},
+      {header.lodsOffset, header.numLods * sizeof(MeshLod)}
+    };
+    for (auto& blob : blobs) {
+      if (blob[0] > file.size() || blob[1] > file.size() - blob[0]) return false;
+    }
+    return true;
+  }
+
+  CachedMesh::CachedMesh(const std::string& filename) {
+    _residency= RELEASE_CPU_DATA;
+    load(filename);
+  }
+
+  CachedMesh::CachedMesh() {
+    // the cache file is the CPU copy, so nothing needs to stay mapped
+    _residency= RELEASE_CPU_DATA;
+  }
+
+  CachedMesh::~CachedMesh() {
+  }
+
+  std::string CachedMesh::cachePath(const std::string& filename) {
+    return cacheFilePath(filename, ".mesh");
+  }
+
+  bool CachedMesh::isCacheCurrent(const std::string& filename) {
+    return openCache(filename) != nullptr;
+  }
+
+  std::shared_ptr<MappedFile> CachedMesh::openCache(const std::string& filename) {
+    std::shared_ptr<MappedFile> file= std::make_shared<MappedFile>();
+    if (!file->map(cachePath(filename)) || !isValidCache(*file)) return nullptr;
+
+    const MeshCacheHeader& cached= header(*file);
+    int64_t time;
+    if (!isSourceUnchanged(filename, cached.source, &time)) return nullptr;
+
+    if (time != cached.source.time) {
+      // store the new time so that the next load skips the hash
+      if (!updateCacheTime(cachePath(filename), offsetof(MeshCacheHeader, source),
+          time, &file)) return nullptr;
+    }
+    return file;
+  }
+
+  std::shared_ptr<MappedFile> CachedMesh::buildCache(const std::string& filename) {
+    PLYMesh ply;
+    if (!ply.load(filename)) return nullptr;
+
+    const vector<GLfloat>& positions= ply.positions();
+    const vector<GLfloat>& normals= ply.normals();
+    const vector<GLfloat>& texCoords= ply.texCoords();
+    const vector<GLuint>& indices= ply.indices();
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_MAGIC, sizeof(MESH_MAGIC));
+    header.version= MESH_VERSION;
+    header.source.read(filename);
+    header.numVertices= (uint32_t) (positions.size() / 3);
+    header.numIndices= (uint32_t) indices.size();
+    if (normals.size() == positions.size()) header.flags|= HAS_NORMALS;
+    if (texCoords.size() == header.numVertices * 2) header.flags|= HAS_UV;
+
+    const Bounds& bounds= ply.bounds();
+    memcpy(header.boundsMin, &bounds.min[0], sizeof(header.boundsMin));
+    memcpy(header.boundsMax, &bounds.max[0], sizeof(header.boundsMax));
+    memcpy(header.sphere, &bounds.sphere.center[0], 3 * sizeof(float));
+    header.sphere[3]= bounds.sphere.radius;
+    memcpy(header.boxCenter, &bounds.box.center[0], sizeof(header.boxCenter));
+    memcpy(header.boxHalfExtents, &bounds.box.halfExtents[0], sizeof(header.boxHalfExtents));
+    memcpy(header.boxAxes, &bounds.box.axes[0][0], sizeof(header.boxAxes));
+
+    // only the full mesh for now, simplified levels can be appended later
+    MeshLod lod= {0, header.numIndices, FLT_MAX, 0};
+    header.numLods= 1;
+
+    // lay out the blobs after the header
+    size_t offset= align16(sizeof(header));
+    auto place= [&offset](uint64_t* blobOffset, size_t size) {
+      *blobOffset= offset;
+      offset= align16(offset + size);
+    };
+    place(&header.positionsOffset, positions.size() * sizeof(GLfloat));
+    place(&header.normalsOffset, (header.flags & HAS_NORMALS) ? normals.size() * sizeof(GLfloat) : 0);
+    place(&header.texCoordsOffset, (header.flags & HAS_UV) ? texCoords.size() * sizeof(GLfloat) : 0);
+    place(&header.indicesOffset, indices.size() * sizeof(GLuint));
+    place(&header.lodsOffset, sizeof(MeshLod));
+
+    vector<char> bytes(offset, 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    memcpy(&bytes[header.positionsOffset], positions.data(), positions.size() * sizeof(GLfloat));
+    if (header.flags & HAS_NORMALS) {
+      memcpy(&bytes[header.normalsOffset], normals.data(), normals.size() * sizeof(GLfloat));
+    }
+    if (header.flags & HAS_UV) {
+      memcpy(&bytes[header.texCoordsOffset], texCoords.data(), texCoords.size() * sizeof(GLfloat));
+    }
+    memcpy(&bytes[header.indicesOffset], indices.data(), indices.size() * sizeof(GLuint));
+    memcpy(&bytes[header.lodsOffset], &lod, sizeof(lod));
+
+    string path= cachePath(filename);
+    std::shared_ptr<MappedFile> file= std::make_shared<MappedFile>();
+    if (!writeCacheFile(path, bytes) || !file->map(path)) {
+      return std::make_shared<MappedFile>(std::move(bytes));
+    }
+    return file;
+  }
+
+  bool CachedMesh::load(const std::string& filename) {
+    if (_file || _initialized) {
+      std::cout << "WARNING: Cannot load different files with the same cached mesh\n";
+      return false;
+    }
+
+    _file= openCache(filename);
+    if (!_file) _file= buildCache(filename);
+    if (!_file) return false;
+
+    const MeshCacheHeader& header= agl::header(*_file);
+    _bounds.valid= true;
+    memcpy(&_bounds.min[0], header.boundsMin, sizeof(header.boundsMin));
+    memcpy(&_bounds.max[0], header.boundsMax, sizeof(header.boundsMax));
+    memcpy(&_bounds.sphere.center[0], header.sphere, 3 * sizeof(float));
+    _bounds.sphere.radius= header.sphere[3];
+    memcpy(&_bounds.box.center[0], header.boxCenter, sizeof(header.boxCenter));
+    memcpy(&_bounds.box.halfExtents[0], header.boxHalfExtents, sizeof(header.boxHalfExtents));
+    memcpy(&_bounds.box.axes[0][0], header.boxAxes, sizeof(header.boxAxes));
+    _numVertices= header.numVertices;
+    _numIndices= header.numIndices;
+    _sourceHash= header.source.hash;
+    const MeshLod* lods= (const MeshLod*) (_file->data() + header.lodsOffset);
+    _lods.assign(lods, lods + header.numLods);
+    return true;
+  }
+
+  // Creates a buffer from a blob of the mapped file, immutable if supported
+  static GLuint uploadBlob(GLenum target, const char* data, size_t size) {
+    GLuint buffer= 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+      glBufferStorage(target, size, data, 0);
+    } else {
+      glBufferData(target, size, data, GL_STATIC_DRAW);
+    }
+    return buffer;
+  }
+
+  void CachedMesh::init() {
+    if (_initialized || !_file) return;
+    const MeshCacheHeader& header= agl::header(*_file);
+    const char* base= _file->data();
+
+    _initialized= true;
+    _hasUV= (header.flags & HAS_UV) != 0;
+    _gpuBytes= header.numIndices * sizeof(GLuint) + header.numVertices * 3 * sizeof(GLfloat);
+    if (header.flags & HAS_NORMALS) _gpuBytes+= header.numVertices * 3 * sizeof(GLfloat);
+    if (header.flags & HAS_UV) _gpuBytes+= header.numVertices * 2 * sizeof(GLfloat);
+    _nIndices= header.numIndices;
+    _nVerts= header.numVertices;
+
+    // buffers are stored in the same order as TriangleMesh::initBuffers
+    GLuint indexBuf= uploadBlob(GL_ELEMENT_ARRAY_BUFFER,
+      base + header.indicesOffset, header.numIndices * sizeof(GLuint));
+    GLuint posBuf= uploadBlob(GL_ARRAY_BUFFER,
+      base + header.positionsOffset, header.numVertices * 3 * sizeof(GLfloat));
+    _buffers.push_back(indexBuf);
+    _buffers.push_back(posBuf);
+
+    glGenVertexArrays(1, &_vao);
+    glBindVertexArray(_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+
+    glBindBuffer(GL_ARRAY_BUFFER, posBuf);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);  // Vertex position
+
+    if (header.flags & HAS_NORMALS) {
+      GLuint normBuf= uploadBlob(GL_ARRAY_BUFFER,
+        base + header.normalsOffset, header.numVertices * 3 * sizeof(GLfloat));
+      _buffers.push_back(normBuf);
+      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+      glEnableVertexAttribArray(1);  // Normal
+    }
+
+    if (header.flags & HAS_UV) {
+      GLuint tcBuf= uploadBlob(GL_ARRAY_BUFFER,
+        base + header.texCoordsOffset, header.numVertices * 2 * sizeof(GLfloat));
+      _buffers.push_back(tcBuf);
+      glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+      glEnableVertexAttribArray(2);  // Tex coord
+    }
+
+    glBindVertexArray(0);
+  }
+
+  void CachedMesh::releaseCpuData() {
+    if (_residency == KEEP_CPU_DATA || !_file) return;
+    if (_residency == KEEP_POSITIONS) {
+      const GLfloat* p= positions();
+      _positions.assign(p, p + _numVertices * 3);
+    }
+    _file.reset();
+  }
+
+  const GLfloat* CachedMesh::positions() const {
+    if (_file) return (const GLfloat*) (_file->data() + agl::header(*_file).positionsOffset);
+    return _positions.empty() ? nullptr : _positions.data();
+  }
+
+  int CachedMesh::loadStatic(Renderer& renderer) const {
+    if (!_file) {
+      std::cout << "WARNING: The mesh cache is already released\n";
+      return -1;
+    }
+    const MeshCacheHeader& header= agl::header(*_file);
+    const char* base= _file->data();
+    if (!(header.flags & HAS_NORMALS)) {
+      std::cout << "WARNING: Static meshes need normals\n";
+      return -1;
+    }
+
+    const GLuint* indices= (const GLuint*) (base + header.indicesOffset);
+    const GLfloat* points= (const GLfloat*) (base + header.positionsOffset);
+    const GLfloat* normals= (const GLfloat*) (base + header.normalsOffset);
+    size_t nv= header.numVertices;
+    vector<GLfloat> texCoords;
+    if (header.flags & HAS_UV) {
+      const GLfloat* uvs= (const GLfloat*) (base + header.texCoordsOffset);
+      texCoords.assign(uvs, uvs + nv * 2);
+    }
+    return renderer.loadStaticMesh(
+      vector<GLuint>(indices, indices + header.numIndices),
+      vector<GLfloat>(points, points + nv * 3),
+      vector<GLfloat>(normals, normals + nv * 3),
+      texCoords.empty() ? nullptr : &texCoords);
+  }
+
+  size_t CachedMesh::cpuBytes() const {
+    return Mesh::cpuBytes() + (_file ? _file->size() : 0) +
+      _positions.capacity() * sizeof(GLfloat);
+  }
+}
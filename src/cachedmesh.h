@@ -0,0 +1,139 @@
+//--------------------------------------------------
+// Author: David Dinh
+// Date: March 2 2023
+// Description: Triangle mesh loaded from a memory-mapped binary cache
+//--------------------------------------------------
+
+#ifndef cachedmesh_H_
+#define cachedmesh_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "agl/aglm.h"
+#include "agl/cache_file.h"
+#include "agl/mesh/triangle_mesh.h"
+
+namespace agl {
+
+   class Renderer;
+
+   // Layout of a mesh cache file. All blobs start on a 16 byte boundary and
+   // are stored exactly as they are uploaded to the GPU.
+   struct MeshCacheHeader {
+      char magic[8];             // "AGLMESH"
+      uint32_t version;
+      uint32_t flags;            // HAS_NORMALS, HAS_UV
+      SourceStamp source;        // the ply file this was built from
+      uint32_t numVertices;
+      uint32_t numIndices;
+      float boundsMin[3];
+      float boundsMax[3];
+      float sphere[4];           // center xyz, radius
+      float boxCenter[3];        // oriented box, see OrientedBox
+      float boxHalfExtents[3];
+      float boxAxes[9];          // column major
+      uint32_t numLods;
+      uint32_t padding[2];
+      uint64_t positionsOffset;  // numVertices * 3 floats
+      uint64_t normalsOffset;    // numVertices * 3 floats
+      uint64_t texCoordsOffset;  // numVertices * 2 floats
+      uint64_t indicesOffset;    // numIndices uints
+      uint64_t lodsOffset;       // numLods MeshLod entries
+   };
+
+   // A level of detail is a range of the index buffer
+   struct MeshLod {
+      uint32_t firstIndex;
+      uint32_t numIndices;
+      float maxDistance;         // use this level up to this camera distance
+      uint32_t padding;
+   };
+
+   /**
+    * Loads a PLY model through a binary cache in <model dir>/cache/<file>.mesh
+    *
+    * The first load parses the PLY file and writes the cache, later loads map
+    * the cache into memory and init() uploads the blobs directly to the GPU,
+    * so no float vectors are built. The cache is rebuilt when the size and
+    * timestamp of the PLY file no longer match, unless its contents (hash)
+    * are unchanged.
+    *
+    * By default the mapping is released once the mesh is uploaded, only the
+    * header values (counts, bounds and levels of detail) are kept; see
+    * setResidency(). The bounds are computed when the cache is built, so
+    * loading never scans the vertices.
+    */
+   class CachedMesh : public TriangleMesh
+   {
+   public:
+
+      CachedMesh(const std::string& filename);
+      CachedMesh();
+
+      virtual ~CachedMesh();
+
+      // Initialize this object with the given ply file
+      // Returns true if successfull. false otherwise.
+      bool load(const std::string& filename);
+
+      // Return the minimum point of the axis-aligned bounding box
+      glm::vec3 minBounds() const { return _bounds.min; }
+
+      // Return the maximum point of the axis-aligned bounding box
+      glm::vec3 maxBounds() const { return _bounds.max; }
+
+      // Return number of vertices in this model
+      int numVertices() const { return _numVertices; }
+
+      // Return number of faces in this model
+      int numTriangles() const { return _numIndices / 3; }
+
+      // xyz positions while the residency policy keeps them, null otherwise
+      const GLfloat* positions() const;
+
+      // Bytes of vertex data held in main memory (the mapped cache)
+      virtual size_t cpuBytes() const;
+
+      // Levels of detail, the first one is the full mesh
+      const std::vector<MeshLod>& lods() const { return _lods; }
+
+      // Hash of the ply file the cache was built from
+      uint64_t sourceHash() const { return _sourceHash; }
+
+      // Copies the mesh into the shared static mesh buffers of renderer and
+      // returns the id for Renderer::staticMesh(), or -1 on error. Call it
+      // before the first render, which releases the cache
+      int loadStatic(Renderer& renderer) const;
+
+      // Path of the cache file used for the given ply file
+      static std::string cachePath(const std::string& filename);
+
+      // Returns true if the cache exists and matches the ply file
+      static bool isCacheCurrent(const std::string& filename);
+
+   protected:
+      void init();
+
+      // Unmaps the cache, keeping a copy of the positions if asked to
+      virtual void releaseCpuData();
+
+   private:
+      // Maps the cache for filename, returns nullptr if it is missing or stale
+      static std::shared_ptr<MappedFile> openCache(const std::string& filename);
+
+      // Parses filename and writes its cache, if the cache cannot be written
+      // the returned data lives in memory instead
+      static std::shared_ptr<MappedFile> buildCache(const std::string& filename);
+
+      std::shared_ptr<MappedFile> _file;  // released after upload
+      std::vector<GLfloat> _positions;    // kept with KEEP_POSITIONS
+      int _numVertices= 0;
+      int _numIndices= 0;
+      uint64_t _sourceHash= 0;
+      std::vector<MeshLod> _lods;
+   };
+}
+
+#endif
@@ -27,11 +27,20 @@
 #include <deque>
 #include <algorithm>
 #include <map>
+#include <memory>
+#include <functional>
+#include <random>
 #include "agl/window.h"
-#include "plymesh.h"
+#include "agl/asset_loader.h"
+#include "agl/asset_manifest.h"
+#include "agl/mesh/static_mesh_buffer.h"
+#include "agl/triple_buffer.h"
+#include "meshregistry.h"
 #include "osutils.h"
+#include "textureoptions.h"
 #include "entities/player.h"
 #include "objects/object.h"
+#include "objects/grass.h"
 #include <set>
 #include "fmod_errors.h"
 #include <cstdlib>
@@ -67,28 +76,15 @@ struct Billboard : public RenderingItem {
 
 	vec3 headingAxis= vec3(0, 1, 0);
 
-	float calculateHeading(vec3 playerPos) {
-		vec3 n= normalize(playerPos - this->pos);
-		float thetaY= atan2(n.x, n.z);
-		return thetaY;
-	}
-
+	// the vertex shader turns the quad around headingAxis to face the camera
 	void render(Renderer& renderer, float planeLocationY, vec3 playerPos) {
 		if (isVisible) {
-			renderer.push();
-				renderer.translate(this->pos);
-				renderer.rotate(this->calculateHeading(playerPos), headingAxis);
-				renderer.scale(vec3(this->widthRatio * this->yScale, this->yScale, 1));
-				renderer.translate(vec3(-0.5, -0.5, 0));
-				renderer.quad();
-			renderer.pop();
+			renderer.billboard(this->pos, 
+				vec2(this->widthRatio * this->yScale, this->yScale), vec3(0), headingAxis);
 		}
 	}
 };
 
-// grass class that inherits from the Billboard class
-struct Grass: public Billboard {};
-
 // Tree class that inherits from the Billboard class
 struct Tree: public Billboard {};
 
@@ -100,17 +96,16 @@ struct Page : public RenderingItem {
 	float widthRatio;
 
 	vec3 headingAxis= vec3(0, 1, 0);
+
+	// the page texture is streamed in, so it is only drawn once it is loaded
+	TextureHandle textureHandle;
+
+	// rotates with the parent tree, pos is the offset in the tree's frame
 	void render(Renderer& renderer, float planeLocationY, vec3 playerPos) {
-		if (isVisible) {
-			renderer.push();
-				renderer.translate(parent->pos);
-				renderer.rotate(parent->calculateHeading(playerPos), headingAxis);
-
-				renderer.translate(this->pos);
-				renderer.scale(vec3(this->widthRatio * this->yScale * 0.75, this->yScale, 1));
-				renderer.translate(vec3(-0.5, -0.5, 0));
-				renderer.quad();
-			renderer.pop();
+		if (isVisible && textureHandle.isResident()) {
+			widthRatio= ((float) textureHandle.width() / textureHandle.height());
+			renderer.billboard(parent->pos, 
+				vec2(this->widthRatio * this->yScale * 0.75, this->yScale), this->pos, headingAxis);
 		}
 	}
 
@@ -171,21 +166,56 @@ class Viewer : public Window {
     	return rand() / float(RAND_MAX) * (upperBound - lowerBound) + lowerBound;
   	}
 
+	// Same as above with the given generator, for the jobs of the loader
+	// which must not share rand() with each other or the main thread
+	float randBound(std::mt19937& rng, float lowerBound, float upperBound) {
+		return std::uniform_real_distribution<float>(lowerBound, upperBound)(rng);
+	}
+
+	/*
+		Loads an image through its texture cache on a worker of the loader and
+		uploads it as the texture name on this thread. onLoaded gets the texture
+		(e.g. for its aspect ratio) after the upload. Returns the id of the job.
+		The image is loaded with its textureOptions(), like assetcook cooks it.
+	*/
+	int loadTextureAsync(AssetLoader& loader, const string& name, const string& filename,
+		std::function<void(const CachedTexture&)> onLoaded= nullptr) {
+		std::shared_ptr<CachedTexture> tex= std::make_shared<CachedTexture>();
+		TextureOptions options= textureOptions(filename);
+		return loader.add([tex, filename, options]() {
+				// compressed caches are decoded here if the GPU lacks the format
+				if (tex->load(filename, options.flip, options.compress) &&
+					!isTextureFormatSupported(tex->format())) {
+					tex->decompress();
+				}
+			}, [this, tex, name, filename, onLoaded]() {
+				if (!tex->loaded()) {
+					std::cout << "cannot load texture " << filename << std::endl;
+					return;
+				}
+				renderer.loadTexture(name, *tex, 0);
+				tex->release();
+				if (onLoaded) onLoaded(*tex);
+			});
+	}
+
 	void initPages() {
-		Image img;
 		// names are 1-8
 		for (int i= 1; i <= 8; i++) {
 			string filename= std::to_string(i) + ".png";
-			img.load("../textures/pages/" + filename, true);
-			renderer.loadTexture(filename, img, 0);
 			Page page;
+			string path= "../textures/pages/" + filename;
+			TextureOptions options= textureOptions(path);
+			page.textureHandle= renderer.streamTexture(filename, path, 0,
+				options.flip, options.compress);
+			const AssetInfo* info= manifest.findCurrent(path);
+			page.widthRatio= info ? info->aspect : 1.0f;
 
 
 			page.yScale= 0.3f;
-			page.widthRatio= ((float) img.width() / img.height());
 
 			page.pos= vec3(0, -0.50, 0.1f); // local to tree, so we want it to be in front
-			page.texture= filename;
+			page.texture= renderer.textureId(filename);
 			page.usesHeading= false;
 
 
@@ -197,14 +227,15 @@ class Viewer : public Window {
 	* Initializes the flashlight texture
 	*/
 	void initPlayerFlashlight() {
-		Image img;
-		img.load("../textures/flashlight/flashlight.jpg", true);
-		renderer.loadTexture("flashlightTex", img, 0);
-
 		vec3 pos= vec3(-0.11, -0.11, 0.15);
 		vec3 scale= vec3(0.15);
 
-		Object flashlight= Object(models["flashlight-uv"], "flashlightTex", pos, scale);
+		Object flashlight= Object(models.get("flashlight-uv"),
+			renderer.textureId("flashlightTex"), pos, scale);
+		flashlight.staticMesh= flashlight.getMesh().loadStatic(renderer);
+		if (flashlight.staticMesh < 0) {
+			std::cout << "WARNING: Drawing the flashlight as a regular mesh\n";
+		}
 
 		player.appendChild(flashlight);
 	}
@@ -212,12 +243,14 @@ class Viewer : public Window {
 	/*
 	*	Initializes the meshes of the program, i.e. Slenderman and flashlight
 	*/
-	void initModels() {
+	void initModels(AssetLoader& loader) {
+		// the directory is always scanned, so models added after the last cook
+		// are loaded too (their caches are built on the first load)
 		std::vector<string> modelStrings= GetFilenamesInDir("../models", "ply");
 		for (int i= 0; i < modelStrings.size(); i++) {
 			string s= modelStrings[i];
 			// does not get the extension for the key value
-			models[s.substr(0, s.size()-4)]= PLYMesh("../models/" + s);
+			models.loadAsync(loader, s.substr(0, s.size()-4), "../models/" + s);
 		}
 	}
 		
@@ -228,9 +261,9 @@ class Viewer : public Window {
 		return vec2(x, z);
 	}
 
-	Tree createTree(vec2 point, float widthRatio, string tex) {
+	Tree createTree(std::mt19937& rng, vec2 point, float widthRatio, TextureId tex) {
 		Tree tree;
-		tree.yScale= randBound(1.5, 2);
+		tree.yScale= randBound(rng, 1.5, 2);
 		tree.yTranslate= -0.5 + 0.5 * tree.yScale;
 		tree.pos= vec3(point.x, tree.yTranslate, point.y);
 
@@ -240,9 +273,9 @@ class Viewer : public Window {
 		return tree;
 	}
 
-	vec2 generateRandomPointAround(vec2 point, float minDist) {
-		float r1= randBound(0.0, 1.0);
-		float r2= randBound(0.0f, 1.0f);
+	vec2 generateRandomPointAround(std::mt19937& rng, vec2 point, float minDist) {
+		float r1= randBound(rng, 0.0, 1.0);
+		float r2= randBound(rng, 0.0f, 1.0f);
 
 		// random radius
 		float radius= minDist * (r1 + 1);
@@ -321,63 +354,50 @@ class Viewer : public Window {
 		This initializes the billboards such as the grass and trees, loading
 		their assets and randomizing their location on the grid.
 	*/
-	void initBillboards() {
-
-		// this is used to init the grass textures, but they were laggy
-		// and unnecessary imo
-		Image img;
-		float grassRatios[4];
-		img.load("../textures/grass_billboards/n_grass_diff_0_18.png", true);
-		renderer.loadTexture("grass0", img, 0);
-		grassRatios[0]= float(img.width()) / img.height();
-
-		img.load("../textures/grass_billboards/n_grass_diff_0_19.png", true);
-		renderer.loadTexture("grass1", img, 0);
-		grassRatios[1]= float(img.width()) / img.height();
-			
-		img.load("../textures/grass_billboards/n_grass_diff_0_52.png", true);
-		renderer.loadTexture("grass2", img, 0);
-		grassRatios[2]= float(img.width()) / img.height();
-			
-		img.load("../textures/grass_billboards/n_grass_diff_0_53.png", true);
-		renderer.loadTexture("grass3", img, 0);
-		grassRatios[3]= float(img.width()) / img.height();
+	void initBillboards(AssetLoader& loader) {
+
+		// the grass is instanced in chunks, so it can be dense without lag
+		grass.init(renderer, loader, "../textures/grass_billboards", "grass",
+			vec2(planeScale.x * 0.5f, planeScale.z * 0.5f), planeLocation.y, numGrass);
 
 		renderer.blendMode(agl::BLEND);
 
-		std::string grassTextures[4];
-		grassTextures[0]= "grass0";
-		grassTextures[1]= "grass1";
-		grassTextures[2]= "grass2";
-		grassTextures[3]= "grass3";
-		
-		for (int i= 0; i < numGrass; i++) {
-			Grass grass= grassParticles[i];
-			grass.yScale= randBound(0.10, 0.20);
-			grass.yTranslate= -0.5 + 0.5 * grass.yScale;
-			grass.pos= vec3(randBound(-planeScale.x * 0.40, planeScale.x * 0.40),
-				grass.yTranslate, randBound(-planeScale.z * 0.40, planeScale.z * 0.40));
-			int texIndex= rand() % 4;
-			grass.texture= grassTextures[texIndex];
-			grass.widthRatio= grassRatios[texIndex];
-
-			grassParticles[i]= grass;
+		// this is to init the tree textures, the ids are taken here because
+		// the forest is generated on a worker
+		treeTextures[0]= renderer.textureId("fir");
+		treeTextures[1]= renderer.textureId("pine");
+		const string treePaths[2]= {
+			"../textures/tree_billboards/fir.png",
+			"../textures/tree_billboards/pine.png"
+		};
+		const AssetInfo* treeInfos[2]= { manifest.findCurrent(treePaths[0]), 
+			manifest.findCurrent(treePaths[1]) };
+		if (treeInfos[0] && treeInfos[1]) {
+			// the ratios come from the manifest, so the forest does not have to
+			// wait for the images to be decoded
+			treeRatios[0]= treeInfos[0]->aspect;
+			treeRatios[1]= treeInfos[1]->aspect;
+			loadTextureAsync(loader, "fir", treePaths[0]);
+			loadTextureAsync(loader, "pine", treePaths[1]);
+			loader.add([this]() { initForest(); });
+			return;
 		}
 
-		// this is to init the tree textures
-		float treeRatios[2];
-		img.load("../textures/tree_billboards/fir.png", true);
-		renderer.loadTexture("fir", img, 0);
-		treeRatios[0]= float(img.width()) / img.height();
-
-		img.load("../textures/tree_billboards/pine.png", true);
-		renderer.loadTexture("pine", img, 0);
-		treeRatios[1]= float(img.width()) / img.height();
+		int fir= loadTextureAsync(loader, "fir", treePaths[0],
+			[this](const CachedTexture& tex) { treeRatios[0]= tex.aspect(); });
+		int pine= loadTextureAsync(loader, "pine", treePaths[1],
+			[this](const CachedTexture& tex) { treeRatios[1]= tex.aspect(); });
 
-		std::string treeTextures[2];
-		treeTextures[0]= "fir";
-		treeTextures[1]= "pine";
+		// the forest is generated on a worker once the tree ratios are known
+		loader.add([this]() { initForest(); }, nullptr, {fir, pine});
+	}
 
+	/*
+		Places the trees with Poisson's disk algorithm
+	*/
+	void initForest() {
+		// runs on a worker of the loader, so it has its own generator
+		std::mt19937 rng(forestSeed);
 
 		// this is the start of Poisson's disk algorithm
 		numXCells= ceil(xDim/treeCellSize);
@@ -388,7 +408,7 @@ class Viewer : public Window {
 		deque<vec2> treeCellProcessor= deque<vec2>();
 		vector<vec2> samplePoints= vector<vec2>();
 
-		vec2 firstPoint= vec2(randBound(0, xDim-1), randBound(0, zDim-1));
+		vec2 firstPoint= vec2(randBound(rng, 0, xDim-1), randBound(rng, 0, zDim-1));
 
 		treeCellProcessor.push_back(firstPoint);
 		samplePoints.push_back(firstPoint);
@@ -402,7 +422,7 @@ class Viewer : public Window {
 
 			for (int i= 0; i < numPointsAround; i++) {
 				float minDist= treeCellSize;
-				vec2 newPoint= generateRandomPointAround(p, minDist);
+				vec2 newPoint= generateRandomPointAround(rng, p, minDist);
 
 				if (inRectangle(newPoint) && !inNeighborhood(gridTrees, newPoint, minDist)) {
 					treeCellProcessor.push_back(newPoint);
@@ -418,12 +438,12 @@ class Viewer : public Window {
 		for (int i= 0; i < samplePoints.size(); i++) {
 			vec2 point= samplePoints[i];
 			Tree tree;
-			tree.yScale= randBound(1.5, 2);
+			tree.yScale= randBound(rng, 1.5, 2);
 			tree.yTranslate= -0.5 + 0.5 * tree.yScale;
 			tree.pos= vec3(point.x - xDim * 0.5,
 				tree.yTranslate, point.y - zDim * 0.5);
 
-			int texIndex= rand() % 2;
+			int texIndex= std::uniform_int_distribution<int>(0, 1)(rng);
 			tree.texture= treeTextures[texIndex];
 			tree.widthRatio= treeRatios[texIndex];
 
@@ -449,11 +469,11 @@ class Viewer : public Window {
 		});
 
 
-		renderer.beginShader("spotlight");
+		renderer.beginShader(spotlightShader);
 			for (auto* item : renderingItems) {
 				if (item->isVisible) {
 					initSpotlightShader(item->texture, vec2(1), item->useAlpha, item->useFog);
-					item->render(renderer, planeLocation.y, player.getPos());
+					item->render(renderer, planeLocation.y, renderFrame.eye);
 				}	
 			}
 		renderer.endShader();
@@ -468,15 +488,33 @@ class Viewer : public Window {
 	*/
     void setup() {
 		setWindowSize(1000, 1000);
+		setVSync(VSYNC_ADAPTIVE);
 
 		xDim= planeScale.x;
 		zDim= planeScale.z;
 
 
-		renderer.loadShader("spotlight",
+		spotlightShader= renderer.loadShader("spotlight",
 		"../shaders/spotlight.vs",
 		"../shaders/spotlight.fs");
 
+		grassShader= renderer.loadShader("grass",
+		"../shaders/grass.vs",
+		"../shaders/spotlight.fs");
+
+		// static props are drawn with one multi-draw indirect call when the
+		// context supports it, otherwise one at a time with the spotlight shader
+		propShader= spotlightShader;
+		if (StaticMeshBuffer::multiDrawSupported()) {
+			propShader= renderer.loadShader("spotlight-static",
+			"../shaders/spotlight-static.vs",
+			"../shaders/spotlight.fs");
+		}
+
+		// names are looked up once here, drawing uses the ids
+		deadGrassTex= renderer.textureId("dead_grass");
+		grassTex= renderer.textureId("grass");
+
 
 		this->lightPosition= vec4(0.0f, 5.0f, 0.0f, 1.0f); 
 
@@ -484,10 +522,22 @@ class Viewer : public Window {
 		this->lightIntensityDiffuse= vec3(0.825f);
 		this->lightIntensitySpecular= vec3(0.5f);
 
-		renderer.loadTexture("dead_grass", "../textures/dead_grass.png", 0);
+		// sizes come from the manifest written by assetcook, without it or
+		// for assets changed since the cook they are measured instead
+		if (!manifest.load("../assets.manifest")) {
+			std::cout << "no asset manifest, run assetcook to speed up loading" << std::endl;
+		}
+
+		// textures are decoded, models parsed and the forest generated on worker
+		// threads, only the GL uploads happen here in loader.wait()
+		AssetLoader loader;
+		loadTextureAsync(loader, "dead_grass", "../textures/dead_grass.png");
+		loadTextureAsync(loader, "flashlightTex", "../textures/flashlight/flashlight.jpg");
+		loadTextureAsync(loader, "slenderman_base", "../textures/slenderman.PNG");
 
-		initBillboards();
+		initBillboards(loader);
 		initPages();
+		initModels(loader);
 
 		// init camera
 		CameraInfo camera;
@@ -506,13 +556,11 @@ class Viewer : public Window {
 		player= Player(vec3(0), vec3(0,0,1), camera);
 
 
-		initModels();
+		loader.wait();
+
 		initPlayerFlashlight();
 
-		Image img;
-		img.load("../textures/slenderman.PNG", true);
-		renderer.loadTexture("slenderman_base", img, 0);
-		slenderman= Object(models["slenderman"], "slenderman_base", vec3(0, 0, 0), 
+		slenderman= Object(models.get("slenderman"), renderer.textureId("slenderman_base"), vec3(0, 0, 0), 
 		vec3(0.283), quat(vec3(0, 0, 0)));
 			
 		slenderman.isVisible= false;
@@ -520,14 +568,15 @@ class Viewer : public Window {
 
 		slenderman.pos= vec3(0, -0.5 + slenderman.getDimensions().y / 2, 0);
 
+		slenderSim.pos= slenderman.pos;
+		slenderSim.isVisible= false;
+		slenderSim.useGlitch= false;
+		pagesVisible.assign(pages.size(), true);
+
 		for (int i= 0; i < treeParticles.size(); i++) {
 			renderingItems.push_back(&treeParticles[i]);
 		}
 
-		for (int i= 0; i < numGrass; i++) {
-			renderingItems.push_back(&grassParticles[i]);
-		}
-
 		renderingItems.push_back(&slenderman);
 
 		// ensure that a tree does not have multiple pages
@@ -546,6 +595,9 @@ class Viewer : public Window {
 		// SOUNDS ------------------------------------
 		initSounds();
 
+		// the simulation runs on its own thread and draw() uses its latest state
+		setThreadedUpdate(true);
+
     }
 
 	// Checks whether there is an error with any sound function
@@ -645,7 +697,7 @@ class Viewer : public Window {
 
 
 			// make him appear 
-			if (timeSinceLastSpawn >= slendermanSpawnTime && !slenderman.isVisible) {
+			if (timeSinceLastSpawn >= slendermanSpawnTime && !slenderSim.isVisible) {
 				// want the position to be behind the player
 				vec3 v= normalize(player.getZAxis());
 				vec3 k= vec3(0, 1, 0);
@@ -661,19 +713,19 @@ class Viewer : public Window {
 				vec3 pPos= player.getPos();
 
 				vec3 newSlenderPos= pPos + vRot * randRadius;
-				newSlenderPos.y= slenderman.pos.y; // y should stay static
-				slenderman.pos= newSlenderPos;
+				newSlenderPos.y= slenderSim.pos.y; // y should stay static
+				slenderSim.pos= newSlenderPos;
 
-				slenderman.isVisible= true;
+				slenderSim.isVisible= true;
 				slendermanSpawnTime= -1.0f;
 				timeSinceVisibility= 0.0f;
 			}
 
 
 			// make him disappear when the player is not looking at him
-			if (timeSinceVisibility >= slendermanVisibleTime && slenderman.isVisible) {
+			if (timeSinceVisibility >= slendermanVisibleTime && slenderSim.isVisible) {
 					
-				vec3 toSlender= slenderman.pos - player.getPos();
+				vec3 toSlender= slenderSim.pos - player.getPos();
 				// get rid of the y axis, since his midpoint is higher anyway
 				toSlender.y= 0;
 				vec3 playerForward= player.getZAxis();
@@ -681,13 +733,13 @@ class Viewer : public Window {
 					
 				if (slenderDotPlayer < 0) {	
 						
-					slenderman.isVisible= false;
+					slenderSim.isVisible= false;
 					slendermanVisibleTime= -1.0f;
 					timeSinceLastSpawn= 0.0f;
 				}
 			}
 
-			if (!slenderman.isVisible) {
+			if (!slenderSim.isVisible) {
 				timeSinceLastSpawn+= dt();	
 			} else {
 				timeSinceVisibility+= dt();
@@ -705,8 +757,8 @@ class Viewer : public Window {
 	
 	*/
 	void checkPlayerLookingAtSlender() {
-		if (slenderman.isVisible) {
-			vec3 toSlender= slenderman.pos - player.getPos();
+		if (slenderSim.isVisible) {
+			vec3 toSlender= slenderSim.pos - player.getPos();
 			// get rid of the y axis, since his midpoint is higher anyway
 			toSlender.y= 0;
 
@@ -724,8 +776,8 @@ class Viewer : public Window {
 
 				// fov of 50 to get hurt
 				if (angle < hurtAngle) {
-					if (angle < glitchAngle) slenderman.useGlitch= true; // want to glitch it here
-					else slenderman.useGlitch= false;
+					if (angle < glitchAngle) slenderSim.useGlitch= true; // want to glitch it here
+					else slenderSim.useGlitch= false;
 
 					// currently getting damaged
 					timeSinceDamage= 0.0f;
@@ -755,7 +807,7 @@ class Viewer : public Window {
 
 
 				} else {
-					slenderman.useGlitch= false;
+					slenderSim.useGlitch= false;
 					if (timeSinceDamage >= timeToRecover) { 
 						player.increaseHealth(HPS * dt());
 					} else {
@@ -764,7 +816,7 @@ class Viewer : public Window {
 
 				}
 			} else {
-				slenderman.useGlitch= false;
+				slenderSim.useGlitch= false;
 				if (timeSinceDamage >= timeToRecover) { 
 					player.increaseHealth(HPS * dt());
 				} else {
@@ -776,10 +828,10 @@ class Viewer : public Window {
 
 	// Checks if a player ic lose to a page or not to be collected
 	void checkPageProximity() {
-		for (auto& page: pages) {
+		for (int i= 0; i < pages.size(); i++) {
 			// collect a page
-			if (page.isPlayerClose(player.getPos()) && keyIsDown(GLFW_KEY_E) && page.isVisible) {
-				page.isVisible= false;
+			if (pages[i].isPlayerClose(player.getPos()) && keyIsDown(GLFW_KEY_E) && pagesVisible[i]) {
+				pagesVisible[i]= false;
 				player.incrementPagesCollected();
 				cout << player.getPagesCollected() << endl;
 			}
@@ -799,7 +851,7 @@ class Viewer : public Window {
 			gameStatus= LOSE;
 			player.setPos(vec3(0, 0, 0));
 			player.setLookPos(vec3(0, 0, 1));
-			slenderman.pos = player.getLookPos() + vec3(0, -0.3f, 0);
+			slenderSim.pos = player.getLookPos() + vec3(0, -0.3f, 0);
 		}
 	}
 
@@ -942,16 +994,16 @@ class Viewer : public Window {
 	// Initializes the shader information of each object given these paramters
 	// Texture of the item can be specified, along with their uv, if you want to use their alpha
 	// and if you want fog to affect it.
-    void initSpotlightShader(const std::string& texture, vec2 uvScale, bool useAlpha, bool useFog) {
+    void initSpotlightShader(TextureId texture, vec2 uvScale, bool useAlpha, bool useFog) {
 		vec3 Ka= vec3(0.1f);
 		vec3 Kd= vec3(0.775f, 0.0f, 0.0f);
 		vec3 Ks= vec3(0.1f, 0.1f, 0.1f);
 
 		float shininess= 128.0f * 0.10f;
 
-		vec4 lightPos_eye= renderer.viewMatrix() * vec4(player.getPos(), 1.0f);
-		vec3 lightDir= renderer.viewMatrix() * vec4(normalize(player.getLookPos() - 
-			player.getPos()), 0.0f);
+		vec4 lightPos_eye= renderer.viewMatrix() * vec4(renderFrame.eye, 1.0f);
+		vec3 lightDir= renderer.viewMatrix() * vec4(normalize(renderFrame.look - 
+			renderFrame.eye), 0.0f);
 
 		float lightExp= 1.0f;
 		float innerCutOff= cos(radians(7.5f));
@@ -960,8 +1012,8 @@ class Viewer : public Window {
 
 		renderer.setUniform("Spot.pos", lightPos_eye);
 		renderer.setUniform("Spot.intensityAmbient", lightIntensityAmbient);
-		renderer.setUniform("Spot.intensityDiffuse", lightIntensityDiffuse);
-		renderer.setUniform("Spot.intensitySpecular", lightIntensitySpecular);
+		renderer.setUniform("Spot.intensityDiffuse", renderFrame.lightDiffuse);
+		renderer.setUniform("Spot.intensitySpecular", renderFrame.lightSpecular);
 		renderer.setUniform("Spot.dir", lightDir);
 		renderer.setUniform("Spot.exp", lightExp);
 		renderer.setUniform("Spot.innerCutOff", innerCutOff);
@@ -1008,16 +1060,16 @@ class Viewer : public Window {
 		// cout << "timeGlitch: " << randTimeGlitching << endl;
 		// cout << "timeGlitchDuring: " << timeGlitching << endl;
 
-		if (timeGlitching >= randTimeGlitching && slenderman.useGlitch) {
+		if (timeGlitching >= randTimeGlitching && slenderSim.useGlitch) {
 			randTimeGlitching= -1.0f;
 			timeSinceLoseGlitch= 0.0f;
-			slenderman.useGlitch= false;
+			slenderSim.useGlitch= false;
 		}
 
-		if (timeSinceLoseGlitch >= randTimeLoseGlitch && !slenderman.useGlitch) {
+		if (timeSinceLoseGlitch >= randTimeLoseGlitch && !slenderSim.useGlitch) {
 			randTimeLoseGlitch= -1.0f;
 			timeGlitching= 0.0f;
-			slenderman.useGlitch= true;
+			slenderSim.useGlitch= true;
 
 			result = system->playSound(staticNoise, 0, true, &backgroundChannel);
 			ERRCHECK(result);
@@ -1029,20 +1081,24 @@ class Viewer : public Window {
 			ERRCHECK(result);
 		}
 
-		if (slenderman.useGlitch) {
+		if (slenderSim.useGlitch) {
 			timeGlitching+= dt();
 		} else {
 			timeSinceLoseGlitch+= dt();
 		}
 	}
 
-	// This is the game loop where everything is updated based on gameStatus
-    void draw() {
+	/*
+		This is the game loop where everything is updated based on gameStatus.
+		It runs on its own thread (see setup), so it must not use the renderer.
+		The results are handed to draw() through frameStates.
+	*/
+	void update() {
 		if (gameStatus == ONGOING) {
 			// update player position
 			updateLookPos();
 
-			mat4 VM= renderer.viewMatrix();
+			mat4 VM= glm::lookAt(player.getPos(), player.getLookPos(), player.getCameraUp());
 			vec3 xAxis= vec3(VM[0][0], VM[1][0], VM[2][0]);
 			vec3 yAxis= vec3(VM[0][1], VM[1][1], VM[2][1]);
 			vec3 zAxis= vec3(VM[0][2], VM[1][2], VM[2][2]);
@@ -1051,9 +1107,6 @@ class Viewer : public Window {
 			player.setCameraYAxis(yAxis);
 			player.setCameraZAxis(zAxis);
 
-			quat orientation= quat(vec3(-player.getCameraElevation(), player.getCameraAzimuth(), 0));
-			orientation= normalize(orientation);
-
 			checkPageProximity();
 
 			checkPlayerLookingAtSlender();
@@ -1068,17 +1121,91 @@ class Viewer : public Window {
 
 			timeSinceJumpScareSound += dt();
 
-			player.setCameraAspect(((float) width()) / height());
-			renderer.perspective(player.getCameraFOV(), player.getCameraAspect(), 
-				player.getCameraNear(), player.getCameraFar());
+			isLose();
+		} else if (gameStatus == LOSE) {
+			randomLosingGlitches();
+			slenderSim.isVisible= true;
+		}
+
+		publishFrameState();
+	}
+
+	// Copies what draw() needs from the simulation into the next frame state
+	void publishFrameState() {
+		FrameState& frame= frameStates.writeBuffer();
+		frame.valid= true;
+		frame.status= gameStatus;
+		frame.stepTime= stepTime();
+
+		frame.eye= player.getPos();
+		frame.look= player.getLookPos();
+		frame.up= player.getCameraUp();
+		frame.fov= player.getCameraFOV();
+		frame.cameraNear= player.getCameraNear();
+		frame.cameraFar= player.getCameraFar();
+		frame.orientation= normalize(quat(vec3(-player.getCameraElevation(), 
+			player.getCameraAzimuth(), 0)));
+
+		// the previous step, so draw() can interpolate between the two
+		if (!hasPublished) {
+			publishedEye= frame.eye;
+			publishedLook= frame.look;
+			publishedOrientation= frame.orientation;
+			hasPublished= true;
+		}
+		frame.prevEye= publishedEye;
+		frame.prevLook= publishedLook;
+		frame.prevOrientation= publishedOrientation;
+		publishedEye= frame.eye;
+		publishedLook= frame.look;
+		publishedOrientation= frame.orientation;
+
+		frame.lightDiffuse= lightIntensityDiffuse;
+		frame.lightSpecular= lightIntensitySpecular;
+
+		frame.slenderPos= slenderSim.pos;
+		frame.slenderVisible= slenderSim.isVisible;
+		frame.slenderGlitch= slenderSim.useGlitch;
+		frame.pagesVisible= pagesVisible;
+
+		frameStates.publish();
+	}
+
+	// Draws the latest frame state published by update()
+    void draw() {
+		frameStates.fetch();
+		renderFrame= frameStates.readBuffer();
+		if (!renderFrame.valid) return;
+
+		// the camera moves smoothly between the fixed update steps, the alpha
+		// comes from the state fetched above so it matches its step
+		float alpha= interpolationAlpha(renderFrame.stepTime);
+		renderFrame.eye= mix(renderFrame.prevEye, renderFrame.eye, alpha);
+		renderFrame.look= mix(renderFrame.prevLook, renderFrame.look, alpha);
+		renderFrame.orientation= slerp(renderFrame.prevOrientation, 
+			renderFrame.orientation, alpha);
+
+		// the rendering items are only touched by this thread
+		slenderman.pos= renderFrame.slenderPos;
+		slenderman.isVisible= renderFrame.slenderVisible;
+		slenderman.useGlitch= renderFrame.slenderGlitch;
+		for (int i= 0; i < pages.size(); i++) {
+			pages[i].isVisible= renderFrame.pagesVisible[i];
+		}
+
+		float aspect= ((float) width()) / height();
+
+		if (renderFrame.status == ONGOING) {
+			renderer.perspective(renderFrame.fov, aspect, 
+				renderFrame.cameraNear, renderFrame.cameraFar);
 				
-			renderer.lookAt(player.getPos(), player.getLookPos(), player.getCameraUp());
+			renderer.lookAt(renderFrame.eye, renderFrame.look, renderFrame.up);
 
 
 			// draw plane
 				
-			renderer.beginShader("spotlight");
-				initSpotlightShader("dead_grass", vec2(planeScale.x, planeScale.z), false, true);
+			renderer.beginShader(spotlightShader);
+				initSpotlightShader(deadGrassTex, vec2(planeScale.x, planeScale.z), false, true);
 				renderer.push();
 					renderer.translate(planeLocation);
 					renderer.scale(planeScale);
@@ -1086,40 +1213,37 @@ class Viewer : public Window {
 				renderer.pop();
 			renderer.endShader();
 
+			// draw grass, alpha tested so it does not need sorting
+			renderer.beginShader(grassShader);
+				initSpotlightShader(grassTex, vec2(1), true, true);
+				renderer.setUniform("AlphaCutoff", 0.5f);
+				grass.render(renderer, elapsedTime());
+			renderer.endShader();
 
 			drawRenderingItems();
 
-				
-			renderer.beginShader("spotlight");
-				renderer.push();
-				renderer.translate(player.getPos());
-				renderer.rotate(orientation);
-				for (Object &child: player.getChildren()) {
+			// the children are not changed after setup, so they are safe to read here.
+			// Children without a static mesh (see initPlayerFlashlight) are drawn
+			// as regular meshes, which the static prop shader cannot draw
+			for (Object &child: player.getChildren()) {
+				bool isStatic= child.staticMesh >= 0;
+				renderer.beginShader(isStatic ? propShader : spotlightShader);
 					initSpotlightShader(child.getTexture(), vec2(1), false, true);
-						renderer.push();
-							renderer.translate(child.pos);
-							renderer.scale(child.scale);
-							renderer.translate((-child.getMidPoint()));
+					renderer.push();
+						renderer.translate(renderFrame.eye);
+						renderer.rotate(renderFrame.orientation);
+						renderer.translate(child.pos);
+						renderer.scale(child.scale);
+						renderer.translate((-child.getMidPoint()));
+						if (isStatic) {
+							renderer.staticMesh(child.staticMesh);
+						} else {
 							renderer.mesh(child.getMesh());
-						renderer.pop();
+						}
 					renderer.pop();
-				}
-			renderer.endShader();
-				
-
-			/*	
-			renderer.beginShader("spotlight");
-				initSpotlightShader(slenderman.getTexture(), vec2(1));
-				renderer.push();
-					renderer.translate(slenderman.pos);
-					renderer.rotate(slenderman.calculateHeading(player.getPos()), slenderman.headingAxis);
-					slenderman.render(renderer, planeLocation.y);
-				renderer.pop();
-			renderer.endShader();
-			*/
-
-			isLose();
-		} else if (gameStatus == WIN) {
+				renderer.endShader();
+			}
+		} else if (renderFrame.status == WIN) {
 			renderer.fontColor(glm::vec4(0.95, 1.0, 0, 0.8));
 			std::string message = "YOU WIN! :]";
 			renderer.fontSize(128);
@@ -1127,11 +1251,10 @@ class Viewer : public Window {
 			float y = 500;
 			renderer.text(message, x, y);
 		} else {
-			player.setCameraAspect(((float) width()) / height());
-			renderer.perspective(player.getCameraFOV(), player.getCameraAspect(), 
-				player.getCameraNear(), player.getCameraFar());
+			renderer.perspective(renderFrame.fov, aspect, 
+				renderFrame.cameraNear, renderFrame.cameraFar);
 
-			renderer.lookAt(player.getPos(), player.getLookPos(), player.getCameraUp());
+			renderer.lookAt(renderFrame.eye, renderFrame.look, renderFrame.up);
 
 
 
@@ -1144,16 +1267,14 @@ class Viewer : public Window {
 				renderer.text(message, x, y);
 			*/
 				
-			randomLosingGlitches();
-			slenderman.isVisible = true;
-			renderer.beginShader("spotlight");
+			renderer.beginShader(spotlightShader);
 				initSpotlightShader(slenderman.texture, vec2(1), false, false);
-				slenderman.render(renderer, planeLocation.y, player.getPos());
+				slenderman.render(renderer, planeLocation.y, renderFrame.eye);
 				renderer.push();
-					renderer.texture("diffuseTexture", "dead_grass");
+					renderer.texture("diffuseTexture", deadGrassTex);
 					renderer.setUniform("uvScale", vec2(10));
 					renderer.translate(vec3(0, 0, 0.5));
-					renderer.translate(player.getLookPos());
+					renderer.translate(renderFrame.look);
 					renderer.scale(vec3(10, 10, 0.1f));
 					renderer.cube();
 				renderer.pop();
@@ -1164,8 +1285,10 @@ class Viewer : public Window {
     }
 
 	// This lerps the player movement, so the movement is smoother
+	// dt() is the fixed update step, so the LERP is the same at any frame rate
 	void lateUpdate() {
-		vec3 curPlayerPos= LERP(player.getPos(), player.getTargetPosition(), 0.25);
+		float t= 1.0f - pow(0.75f, dt() * 60.0f);
+		vec3 curPlayerPos= LERP(player.getPos(), player.getTargetPosition(), t);
 		player.setPos(curPlayerPos);
 
 
@@ -1228,8 +1351,8 @@ class Viewer : public Window {
 	float zDim;
 		
 	// grass information
-	const int numGrass= 1;
-	Grass grassParticles[1];
+	const int numGrass= 40000;
+	GrassField grass;
 
 	// tree information
 	vector<Tree> treeParticles;
@@ -1239,11 +1362,59 @@ class Viewer : public Window {
 	vector<RenderingItem*> renderingItems;
 
 	// model information
-	std::map<string, PLYMesh> models;
+	MeshRegistry models;
 
 	enum GameStatus {WIN, LOSE, ONGOING};
 	GameStatus gameStatus= ONGOING;
 
+	/*
+		A copy of everything draw() needs from the simulation. update() fills
+		one in every step and draw() uses the latest one, so the two threads
+		never share the game state.
+	*/
+	struct FrameState {
+		bool valid= false;
+		GameStatus status= ONGOING;
+		double stepTime= 0; // see Window::stepTime()
+
+		vec3 eye;
+		vec3 look;
+		vec3 up;
+		float fov;
+		float cameraNear;
+		float cameraFar;
+		quat orientation;
+		vec3 prevEye;
+		vec3 prevLook;
+		quat prevOrientation;
+
+		vec3 lightDiffuse;
+		vec3 lightSpecular;
+
+		vec3 slenderPos;
+		bool slenderVisible;
+		bool slenderGlitch;
+		vector<bool> pagesVisible;
+	};
+	TripleBuffer<FrameState> frameStates;
+	FrameState renderFrame; // used by draw()
+
+	// the camera of the last published frame state
+	bool hasPublished= false;
+	vec3 publishedEye;
+	vec3 publishedLook;
+	quat publishedOrientation;
+
+	// the simulation copy of Slenderman and the pages, the rendering items
+	// are only updated from the frame state
+	struct SlenderState {
+		vec3 pos;
+		bool isVisible;
+		bool useGlitch;
+	};
+	SlenderState slenderSim;
+	vector<bool> pagesVisible;
+
 	// pages
 	vector<Page> pages;
 
@@ -1256,6 +1427,17 @@ class Viewer : public Window {
 	int numZCells;
 	float treeCellSize= 1.85f;
 	int numPointsAround= 15;
+	unsigned int forestSeed= 1; // the same seed gives the same forest
+	AssetManifest manifest; // sizes of the cooked assets, empty if not cooked
+	float treeRatios[2]= {1, 1}; // width / height of the fir and pine textures
+	TextureId treeTextures[2];
+
+	// resources used every frame
+	ShaderId spotlightShader;
+	ShaderId propShader; // spotlight-static if supported, see setup()
+	ShaderId grassShader;
+	TextureId deadGrassTex;
+	TextureId grassTex;
 
 	// sounds
 	FMOD_RESULT result;
@@ -0,0 +1,78 @@
+//--------------------------------------------------
+// Author: David Dinh
+// Date: May 2 2023
+// Description: Shared, reference-counted meshes looked up by name
+//--------------------------------------------------
+
+#include "meshregistry.h"
+#include <iostream>
+
+using namespace std;
+
+namespace agl {
+
+  MeshHandle MeshRegistry::load(const std::string& name, const std::string& path) {
+    std::shared_ptr<CachedMesh>& mesh= _meshes[name];
+    if (!mesh) {
+      mesh= std::make_shared<CachedMesh>();
+      if (!mesh->load(path)) {
+        std::cout << "WARNING: Cannot load mesh " << path << endl;
+      }
+    }
+    return mesh;
+  }
+
+  MeshHandle MeshRegistry::loadAsync(AssetLoader& loader, const std::string& name,
+    const std::string& path) {
+    std::shared_ptr<CachedMesh>& mesh= _meshes[name];
+    if (!mesh) {
+      mesh= std::make_shared<CachedMesh>();
+      // the job keeps its own reference in case the entry is released early
+      std::shared_ptr<CachedMesh> job= mesh;
+      loader.add([job, path]() {
+        if (!job->load(path)) {
+          std::cout << "WARNING: Cannot load mesh " << path << endl;
+        }
+      });
+    }
+    return mesh;
+  }
+
+  MeshHandle MeshRegistry::get(const std::string& name) const {
+    auto it= _meshes.find(name);
+    if (it == _meshes.end()) {
+      std::cout << "WARNING: No mesh named " << name << endl;
+      return nullptr;
+    }
+    return it->second;
+  }
+
+  bool MeshRegistry::contains(const std::string& name) const {
+    return _meshes.count(name) > 0;
+  }
+
+  void MeshRegistry::release(const std::string& name) {
+    _meshes.erase(name);
+  }
+
+  int MeshRegistry::collect() {
+    int released= 0;
+    for (auto it= _meshes.begin(); it != _meshes.end();) {
+      if (it->second.use_count() == 1) {
+        it= _meshes.erase(it);
+        released++;
+      } else {
+        ++it;
+      }
+    }
+    return released;
+  }
+
+  size_t MeshRegistry::gpuBytes() const {
+    size_t bytes= 0;
+    for (const auto& entry : _meshes) {
+      bytes+= entry.second->gpuBytes();
+    }
+    return bytes;
+  }
+}
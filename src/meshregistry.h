@@ -0,0 +1,67 @@
+//--------------------------------------------------
+// Author: David Dinh
+// Date: May 2 2023
+// Description: Shared, reference-counted meshes looked up by name
+//--------------------------------------------------
+
+#ifndef meshregistry_H_
+#define meshregistry_H_
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include "agl/asset_loader.h"
+#include "cachedmesh.h"
+
+namespace agl {
+
+   // Meshes are shared between every object that draws them, copying a
+   // handle copies a pointer and never the vertex buffers
+   typedef std::shared_ptr<const CachedMesh> MeshHandle;
+
+   /**
+    * Owns one CachedMesh per model, so N objects using the same model share
+    * a single set of GPU buffers.
+    *
+    * Handles keep their mesh alive, the buffers are deleted when the last
+    * handle and the registry entry are gone (see release() and collect()).
+    * Like other GL resources, the registry and its handles must be used and
+    * destroyed on the thread that owns the GL context.
+    */
+   class MeshRegistry
+   {
+   public:
+      // Returns the mesh for name, loading path the first time
+      MeshHandle load(const std::string& name, const std::string& path);
+
+      // Same as load(), but path is read on a worker of loader; the handle
+      // is returned right away and is usable once loader.wait() returns
+      MeshHandle loadAsync(AssetLoader& loader, const std::string& name,
+         const std::string& path);
+
+      // Returns the mesh registered as name, or nullptr with a warning
+      MeshHandle get(const std::string& name) const;
+
+      // Returns true if a mesh is registered as name
+      bool contains(const std::string& name) const;
+
+      // Drops the registry's reference, the mesh lives on while handles do
+      void release(const std::string& name);
+
+      // Releases every mesh no object holds a handle to
+      // Returns the number of meshes released
+      int collect();
+
+      // Returns the number of registered meshes
+      size_t size() const { return _meshes.size(); }
+
+      // Returns the bytes uploaded to the GPU for all registered meshes
+      size_t gpuBytes() const;
+
+   private:
+      std::map<std::string, std::shared_ptr<CachedMesh>> _meshes;
+   };
+}
+
+#endif
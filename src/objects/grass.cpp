@@ -0,0 +1,264 @@
+#include "objects/grass.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include "agl/asset_loader.h"
+#include "agl/cache_file.h"
+#include "agl/image.h"
+#include "agl/pixel_ops.h"
+#include "osutils.h"
+#include "textureoptions.h"
+
+using namespace agl;
+using namespace glm;
+using namespace std;
+
+GrassField::~GrassField() {
+	for (Chunk& chunk : chunks) {
+		glDeleteBuffers(1, &chunk.vbo);
+		glDeleteVertexArrays(1, &chunk.vao);
+	}
+	glDeleteBuffers(1, &cornerVbo);
+}
+
+// Returns a random number between lowerBound and upperBound
+float GrassField::randBound(std::mt19937& rng, float lowerBound, float upperBound) {
+	return std::uniform_real_distribution<float>(lowerBound, upperBound)(rng);
+}
+
+void GrassField::init(Renderer& renderer, const string& textureDir,
+	const string& textureName, vec2 halfExtent, float groundY,
+	int numBlades, float chunkSize) {
+	AssetLoader loader;
+	init(renderer, loader, textureDir, textureName, halfExtent, groundY,
+		numBlades, chunkSize);
+	loader.wait();
+}
+
+int GrassField::init(Renderer& renderer, AssetLoader& loader,
+	const string& textureDir, const string& textureName, vec2 halfExtent,
+	float groundY, int numBlades, float chunkSize) {
+
+	vector<string> filenames= GetFilenamesInDir(textureDir, "png");
+	std::sort(filenames.begin(), filenames.end());
+	vector<string> paths;
+	for (const string& filename : filenames) {
+		paths.push_back(textureDir + "/" + filename);
+	}
+
+	// the atlas is cached with its mip levels like any other texture, and
+	// rebuilt when a grass texture is added, removed or changed
+	string cachePath= cacheFilePath(textureDir + "/" + textureName, ".atlas.tex");
+	bool compress= textureOptions(cachePath).compress;
+
+	// the atlas and the blades are built off the main thread and only the
+	// texture and the buffers are created on it
+	return loader.add([=]() {
+			layoutAtlas(paths);
+			if (uvRects.empty()) {
+				std::cout << "GrassField: no grass textures found in " << textureDir << std::endl;
+				return;
+			}
+			if (!atlas.loadGenerated(cachePath, hashFileStamps(cellPaths),
+				[this](Image* image) { return buildAtlas(image); }, compress)) {
+				std::cout << "GrassField: cannot build the atlas for " << textureDir << std::endl;
+				uvRects.clear();
+				return;
+			}
+			scatter(halfExtent, groundY, numBlades, chunkSize);
+		}, [this, &renderer, textureName]() {
+			upload(renderer, textureName);
+		});
+}
+
+void GrassField::layoutAtlas(const vector<string>& paths) {
+	// the sizes are read from the file headers, so a current atlas cache
+	// needs no decoding at all. Files that are not images are skipped
+	vector<ivec2> sizes;
+	cellPaths.clear();
+	for (const string& path : paths) {
+		ivec2 size;
+		if (!Image::readSize(path, &size.x, &size.y) || size.x <= 0 || size.y <= 0) {
+			continue;
+		}
+		cellPaths.push_back(path);
+		sizes.push_back(size);
+	}
+
+	cellSize= 1;
+	for (const ivec2& size : sizes) {
+		cellSize= std::max(cellSize, std::max(size.x, size.y));
+	}
+
+	uvRects.clear();
+	widthRatios.clear();
+	if (sizes.empty()) {
+		return;
+	}
+
+	cols= (int) ceil(sqrt((float) sizes.size()));
+	rows= ((int) sizes.size() + cols - 1) / cols;
+	vec2 texel= vec2(1.0f / (cols * cellSize), 1.0f / (rows * cellSize));
+	for (int i= 0; i < sizes.size(); i++) {
+		int x= (i % cols) * cellSize;
+		int y= (i / cols) * cellSize;
+
+		// inset by half a texel so neighbors do not bleed in
+		vec2 offset= vec2(x, y) * texel + 0.5f * texel;
+		vec2 size= vec2(sizes[i]) * texel - texel;
+		uvRects.push_back(vec4(offset, size));
+		widthRatios.push_back(float(sizes[i].x) / sizes[i].y);
+	}
+}
+
+bool GrassField::buildAtlas(Image* image) {
+	*image= Image(cols * cellSize, rows * cellSize);
+	memset(image->data(), 0, 4 * image->width() * image->height());
+
+	for (int i= 0; i < cellPaths.size(); i++) {
+		Image cell;
+		if (!cell.load(cellPaths[i], textureOptions(cellPaths[i]).flip)) {
+			return false;
+		}
+		int x= (i % cols) * cellSize;
+		int y= (i / cols) * cellSize;
+		copyPixels(cell.view(), image->view().region(x, y, cell.width(), cell.height()));
+	}
+	return true;
+}
+
+void GrassField::scatter(vec2 halfExtent, float groundY, int numBlades,
+	float chunkSize) {
+	// runs on a worker of the loader, so it has its own generator
+	std::mt19937 rng(seed);
+
+	// scatter the blades into chunks
+	int numXChunks= std::max(1, (int) ceil(2.0f * halfExtent.x / chunkSize));
+	int numZChunks= std::max(1, (int) ceil(2.0f * halfExtent.y / chunkSize));
+	vector<vector<Blade>> chunkBlades(numXChunks * numZChunks);
+
+	for (int i= 0; i < numBlades; i++) {
+		vec2 p= vec2(randBound(rng, -halfExtent.x, halfExtent.x),
+			randBound(rng, -halfExtent.y, halfExtent.y));
+		int texIndex= std::uniform_int_distribution<int>(0, (int) uvRects.size() - 1)(rng);
+		float height= randBound(rng, 0.10, 0.20);
+
+		Blade blade;
+		blade.posRank= vec4(p.x, groundY, p.y, randBound(rng, 0, 1));
+		blade.uvRect= uvRects[texIndex];
+		blade.sizePhase= vec4(widthRatios[texIndex] * height, height,
+			randBound(rng, 0, 6.2831853f), 0);
+
+		int cx= std::min(numXChunks - 1, (int) ((p.x + halfExtent.x) / chunkSize));
+		int cz= std::min(numZChunks - 1, (int) ((p.y + halfExtent.y) / chunkSize));
+		chunkBlades[cx * numZChunks + cz].push_back(blade);
+	}
+
+	pendingChunks.clear();
+	for (int cx= 0; cx < numXChunks; cx++) {
+		for (int cz= 0; cz < numZChunks; cz++) {
+			vector<Blade>& blades= chunkBlades[cx * numZChunks + cz];
+			if (blades.empty()) continue;
+
+			// sorting by rank means that the first n blades are a random subset,
+			// so a thinned out chunk only draws a prefix of its buffer
+			std::sort(blades.begin(), blades.end(), [](const Blade& a, const Blade& b) {
+				return a.posRank.w < b.posRank.w;
+			});
+
+			Chunk chunk;
+			chunk.center= vec3(-halfExtent.x + (cx + 0.5f) * chunkSize, groundY,
+				-halfExtent.y + (cz + 0.5f) * chunkSize);
+			chunk.radius= chunkSize * 0.5f * sqrt(2.0f);
+			chunk.count= (int) blades.size();
+			chunks.push_back(chunk);
+			pendingChunks.push_back(std::move(blades));
+		}
+	}
+
+	totalBlades= numBlades;
+}
+
+void GrassField::upload(Renderer& renderer, const string& textureName) {
+	if (chunks.empty()) return;
+	renderer.loadTexture(textureName, atlas, 0);
+	atlas.release();
+
+	// the corners of a blade, x is across and y is up the blade
+	float corners[]= {
+		-0.5f, 0.0f,  0.5f, 0.0f,  0.5f, 1.0f,
+		-0.5f, 0.0f,  0.5f, 1.0f, -0.5f, 1.0f
+	};
+	glGenBuffers(1, &cornerVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, cornerVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+	for (int i= 0; i < chunks.size(); i++) {
+		Chunk& chunk= chunks[i];
+		const vector<Blade>& blades= pendingChunks[i];
+
+		glGenVertexArrays(1, &chunk.vao);
+		glBindVertexArray(chunk.vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, cornerVbo);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
+
+		glGenBuffers(1, &chunk.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+		glBufferData(GL_ARRAY_BUFFER, blades.size() * sizeof(Blade),
+			blades.data(), GL_STATIC_DRAW);
+
+		for (int attr= 0; attr < 3; attr++) {
+			glEnableVertexAttribArray(1 + attr);
+			glVertexAttribPointer(1 + attr, 4, GL_FLOAT, GL_FALSE, sizeof(Blade),
+				(const GLvoid*) (attr * sizeof(vec4)));
+			glVertexAttribDivisor(1 + attr, 1);
+		}
+	}
+	glBindVertexArray(0);
+	pendingChunks.clear();
+}
+
+void GrassField::render(Renderer& renderer, float time) {
+	if (chunks.empty() || cornerVbo == 0) return;
+	renderer.flushBatches();
+
+	vec3 cameraPos= renderer.cameraPosition();
+	mat4 V= renderer.viewMatrix();
+	vec3 forward= -vec3(V[0][2], V[1][2], V[2][2]);
+
+	// positions are already in world space
+	renderer.setUniform("MVP", renderer.projectionMatrix() * V);
+	renderer.setUniform("ModelViewMatrix", V);
+	renderer.setUniform("NormalMatrix", mat3(V));
+	renderer.setUniform("CameraPos", cameraPos);
+	renderer.setUniform("HasUV", true);
+	renderer.setUniform("Time", time);
+	renderer.setUniform("WindDir", normalize(windDir));
+	renderer.setUniform("WindStrength", windStrength);
+	renderer.setUniform("DensityNear", densityNear);
+	renderer.setUniform("DensityFar", densityFar);
+
+	for (const Chunk& chunk : chunks) {
+		vec3 toChunk= chunk.center - cameraPos;
+		toChunk.y= 0;
+		float nearest= std::max(0.0f, length(toChunk) - chunk.radius);
+
+		// skip chunks that are too far or behind the camera
+		if (nearest >= densityFar) continue;
+		if (dot(toChunk, forward) < -chunk.radius) continue;
+
+		// the vertex shader removes the blades beyond the density at their own
+		// distance, here we only skip the ones beyond the nearest density
+		float density= 1.0f - smoothstep(densityNear, densityFar, nearest);
+		int count= std::min(chunk.count, (int) ceil(chunk.count * density));
+		if (count <= 0) continue;
+
+		glBindVertexArray(chunk.vao);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+	}
+	glBindVertexArray(0);
+}
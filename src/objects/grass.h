@@ -0,0 +1,122 @@
+/**
+ * This program acts as the class for the grass field
+*/
+
+#ifndef grass_H
+#define grass_H
+
+#include <random>
+#include <string>
+#include <vector>
+#include "agl/asset_loader.h"
+#include "agl/cached_texture.h"
+#include "agl/image.h"
+#include "agl/renderer.h"
+
+/**
+ * The grass field scatters a large number of grass billboards over the plane.
+ *
+ * All the grass textures are packed into one atlas and the blades are split
+ * into square chunks, each with its own instance buffer. A chunk is drawn
+ * with one instanced draw call, so the CPU cost per frame only depends on the
+ * number of chunks, not on the number of blades.
+ *
+ * The atlas is cached with its mip levels like any other texture (see
+ * CachedTexture::loadGenerated()), so the textures are only decoded when
+ * one of them changed.
+ *
+ * The vertex shader (grass.vs) turns each blade towards the camera, thins out
+ * blades with distance and sways the top of the blade with the wind.
+*/
+class GrassField {
+	public:
+		GrassField() {};
+		~GrassField();
+
+		/*
+			Loads the grass textures in textureDir into an atlas called textureName
+			and scatters numBlades blades over the rectangle [-halfExtent, halfExtent]
+			at height groundY. chunkSize is the side length of a chunk.
+		*/
+		void init(agl::Renderer& renderer, const std::string& textureDir,
+			const std::string& textureName, glm::vec2 halfExtent, float groundY,
+			int numBlades, float chunkSize= 2.0f);
+
+		/*
+			Same as above, but the atlas is loaded and the blades scattered by a
+			job of the loader. The GL objects are created when the loader runs the
+			uploads, so the field can be drawn after loader.wait(). Returns the id
+			of the last job.
+		*/
+		int init(agl::Renderer& renderer, agl::AssetLoader& loader,
+			const std::string& textureDir, const std::string& textureName,
+			glm::vec2 halfExtent, float groundY, int numBlades,
+			float chunkSize= 2.0f);
+
+		/*
+			Draws the grass with the active shader (which should be grass.vs), the
+			texture and lighting uniforms should already be set.
+		*/
+		void render(agl::Renderer& renderer, float time);
+
+		// blades are drawn at full density until densityNear and fade out
+		// completely by densityFar
+		float densityNear= 2.0f;
+		float densityFar= 6.0f;
+
+		glm::vec2 windDir= glm::vec2(1, 0.3f);
+		float windStrength= 0.15f;
+
+		// the blades are placed with their own generator, the same seed gives
+		// the same field
+		unsigned int seed= 1;
+
+		int numBlades() const { return totalBlades; };
+
+	private:
+		// per blade instance data, see grass.vs
+		struct Blade {
+			glm::vec4 posRank; // base position and a random rank in [0, 1]
+			glm::vec4 uvRect; // offset and size of the texture in the atlas
+			glm::vec4 sizePhase; // width, height and the wind phase
+		};
+
+		struct Chunk {
+			glm::vec3 center;
+			float radius;
+			int count;
+			GLuint vao= 0;
+			GLuint vbo= 0;
+		};
+
+		float randBound(std::mt19937& rng, float lowerBound, float upperBound);
+
+		// places the textures in the cells of the atlas, from their sizes only
+		void layoutAtlas(const std::vector<std::string>& paths);
+
+		// decodes the textures into their cells, when the atlas is not cached
+		bool buildAtlas(agl::Image* image);
+
+		// fills the chunks and their blades
+		void scatter(glm::vec2 halfExtent, float groundY, int numBlades,
+			float chunkSize);
+
+		// creates the texture and the buffers, must run on the GL thread
+		void upload(agl::Renderer& renderer, const std::string& textureName);
+
+		// loading state, freed once the field is uploaded
+		std::vector<std::string> cellPaths;
+		int cellSize= 1;
+		int cols= 1;
+		int rows= 1;
+		agl::CachedTexture atlas;
+		std::vector<glm::vec4> uvRects;
+		std::vector<float> widthRatios;
+		std::vector<std::vector<Blade>> pendingChunks;
+
+		std::vector<Chunk> chunks;
+		GLuint cornerVbo= 0;
+		int totalBlades= 0;
+};
+
+#endif
@@ -6,8 +6,10 @@
 #ifndef object_H
 #define object_H
 
+#include <cassert>
 #include "agl/aglm.h"
-#include "plymesh.h"
+#include "agl/resource_registry.h"
+#include "meshregistry.h"
 
 using namespace agl;
 using namespace glm;
@@ -23,13 +25,7 @@ struct RenderingItem {
 	RenderingItem() {};
 
 	RenderingItem(vec3 pos, quat rot, vec3 scale) :
-		pos(pos), rot(rot), scale(scale), texture("") {};
-
-	virtual float calculateHeading(vec3 playerPos) {
-		vec3 n= normalize(playerPos - this->pos);
-		float thetaY= atan2(n.x, n.z);
-		return thetaY;
-	}
+		pos(pos), rot(rot), scale(scale) {};
 
 	// must implement render
 	virtual void render(Renderer& renderer, float planeLocationY, vec3 playerPos) {
@@ -43,7 +39,7 @@ struct RenderingItem {
 	quat rot= quat(vec3(0, 0, 0));
 	vec3 scale= vec3(1);
 	vec3 headingAxis= vec3(0, 1, 0);
-	std::string texture;
+	TextureId texture;  // see Renderer::textureId()
 	bool useAlpha= true;
 	bool useFog= true;
 	bool isVisible= true;
@@ -62,13 +58,16 @@ struct Object : public RenderingItem{
   public:
 		Object() : RenderingItem(vec3(0), quat(vec3(0)), vec3(1)), pos(vec3(0)), scale(vec3(1)) {};
 
-    Object(PLYMesh mesh, std::string texture, vec3 pos= vec3(0, 0, 0), 
+		// the mesh is shared, so copies of an object (e.g. children) are cheap
+		// and draw from the same GPU buffers
+    Object(MeshHandle mesh, TextureId texture, vec3 pos= vec3(0, 0, 0), 
 			vec3 scale= vec3(1), quat rot= quat(vec3(0, 0, 0))) : 
 			RenderingItem(pos, rot, scale), pos(pos), rot(rot), 
 			scale(scale), mesh(mesh)  
 			{
-				this->minBounds= mesh.minBounds() * scale;
-				this->maxBounds= mesh.maxBounds() * scale;
+				assert(mesh);
+				this->minBounds= mesh->minBounds() * scale;
+				this->maxBounds= mesh->maxBounds() * scale;
 				this->texture= texture;
 				this->useAlpha= false;
 
@@ -91,8 +90,9 @@ struct Object : public RenderingItem{
 		void setZAxis(vec3 newAxis) { this->zAxis= newAxis; }
 		void appendChild(Object obj) { children.push_back(obj); }
 
-		PLYMesh& getMesh() { return this->mesh; };
-		std::string& getTexture() { return this->texture; };
+		const CachedMesh& getMesh() const { return *this->mesh; };
+		MeshHandle getMeshHandle() const { return this->mesh; };
+		TextureId getTexture() const { return this->texture; };
 
 		vec3 getMinBounds() { return this->minBounds; };
 		vec3 getMaxBounds() { return this->maxBounds; };
@@ -109,23 +109,16 @@ struct Object : public RenderingItem{
 			finalRot= rot * quat(vec3(0, heading, 0));
 		}
 
-		float calculateHeading(vec3 playerPos) {
-			vec3 n= normalize(playerPos - this->pos);
-			float thetaY= atan2(n.x, n.z);
-			return thetaY;
-		}
-
-
+		// the mesh is turned around headingAxis to face the camera in the
+		// vertex shader, the matrix stack only holds its local transform
 		void render(Renderer& renderer, float planeLocationY, vec3 playerPos) {
-			if (isVisible) {
+			if (isVisible && mesh) {
+				vec3 pivot= this->pos + vec3(0, -(planeLocationY + this->dimensions.y * 0.5f), 0);
 				renderer.push();
-					renderer.translate(vec3(0, -(planeLocationY + this->dimensions.y * 0.5f), 0));
-					renderer.translate(this->pos);
-					renderer.rotate(this->calculateHeading(playerPos), this->headingAxis);
 					renderer.scale(this->scale);
 					renderer.rotate(this->getRot());
 					renderer.translate(-this->getMidPoint());
-					renderer.mesh(this->getMesh());
+					renderer.billboard(this->getMesh(), pivot, this->headingAxis);
 				renderer.pop();
 			}
 		}
@@ -137,12 +130,13 @@ struct Object : public RenderingItem{
 
 		bool useGlitch= false;	
 		bool visible= false;
+		int staticMesh= -1;  // see Renderer::staticMesh(), -1 if not loaded
 
 
 	private:
 		vec3 minBounds;
 		vec3 maxBounds;
-		PLYMesh mesh;
+		MeshHandle mesh;
 		vec3 dimensions= vec3(0);
 		// initial rot to get mesh upright
 		quat rot= quat(vec3(0, 0, 0));
@@ -47,19 +47,18 @@ std::vector<std::string> GetFilenamesInDir(const std::string& dirname,
 {
 	DIR *dir;
 	struct dirent *ent;
-	cout << dirname.c_str() << endl;
 	vector<string> files;
 	if ((dir = opendir (dirname.c_str())) != NULL) 
 	{
   		while ((ent = readdir (dir)) != NULL) 
   		{
-    		cout << ent->d_name << endl;
          string name = ent->d_name;
          if (filter.size() > 0 && name.find(filter) != std::string::npos)
          {
 			     files.push_back(ent->d_name);
          } 
   		}
+		closedir(dir);
 	}
 	return files;
 }
@@ -101,19 +100,18 @@ std::vector<std::string> GetFilenamesInDir(const std::string& dirname, const std
 {
 	DIR *dir;
 	struct dirent *ent;
-	cout << dirname.c_str() << endl;
 	vector<string> files;
 	if ((dir = opendir (dirname.c_str())) != NULL) 
 	{
   		while ((ent = readdir (dir)) != NULL) 
   		{
-    		cout << ent->d_name << endl;
          string name = ent->d_name;
          if (filter.size() > 0 && name.find(filter) != std::string::npos)
          {
 			     files.push_back(ent->d_name);
          } 
   		}
+		closedir(dir);
 	}
 	return files;
 }
@@ -177,13 +175,11 @@ std::string PromptToLoadMotion()
 
 std::vector<std::string> GetFilenamesInDir(const std::string& dirname, const std::string& filter)
 {
-    printf("Target directory is %s\n", dirname.c_str());
     std::string dirnamestr = dirname;
     dirnamestr += "\\*";
 
     WIN32_FIND_DATA ffd;
     HANDLE hFind = INVALID_HANDLE_VALUE;
-    LARGE_INTEGER filesize;
 
     hFind = FindFirstFile((LPCWSTR) s2ws(dirnamestr).c_str(), &ffd);
     if (INVALID_HANDLE_VALUE == hFind) 
@@ -202,10 +198,7 @@ std::vector<std::string> GetFilenamesInDir(const std::string& dirname, const std
       }
       else
       {
-         filesize.LowPart = ffd.nFileSizeLow;
-         filesize.HighPart = ffd.nFileSizeHigh;
          std::string filename = ws2s(ffd.cFileName);
-         printf("  %s   %ld bytes\n", filename.c_str(), filesize.QuadPart);
          if (filter.size() > 0 && filename.find(filter) != std::string::npos)
          {
             names.push_back(filename);
@@ -296,13 +289,11 @@ std::string PromptToLoadDir()
 
 std::vector<std::string> GetFilenamesInDir(const std::string& dirname, const std::string& filter)
 {
-    printf("Target directory is %s\n", dirname.c_str());
     std::string dirnamestr = dirname;
     dirnamestr += "\\*";
 
     WIN32_FIND_DATA ffd;
     HANDLE hFind = INVALID_HANDLE_VALUE;
-    LARGE_INTEGER filesize;
 
     hFind = FindFirstFile(dirnamestr.c_str(), &ffd);
     if (INVALID_HANDLE_VALUE == hFind) 
@@ -321,10 +312,7 @@ std::vector<std::string> GetFilenamesInDir(const std::string& dirname, const std
       }
       else
       {
-         filesize.LowPart = ffd.nFileSizeLow;
-         filesize.HighPart = ffd.nFileSizeHigh;
          std::string filename = ffd.cFileName;
-         //printf("  %s   %ld bytes\n", filename.c_str(), filesize.QuadPart);
          if (filter.size() > 0 && filename.find(filter) != std::string::npos)
          {
             names.push_back(filename);
@@ -341,3 +329,49 @@ std::vector<std::string> GetFilenamesInDir(const std::string& dirname, const std
 
 
 #endif
+
+#ifdef _WIN32
+std::vector<std::string> GetSubdirsInDir(const std::string& dirname)
+{
+    std::vector<std::string> names;
+    WIN32_FIND_DATAA ffd;
+    HANDLE hFind = FindFirstFileA((dirname + "\\*").c_str(), &ffd);
+    if (INVALID_HANDLE_VALUE == hFind) return names;
+    do
+    {
+      std::string name = ffd.cFileName;
+      if ((ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+          name != "." && name != "..")
+      {
+         names.push_back(name);
+      }
+    }
+    while (FindNextFileA(hFind, &ffd) != 0);
+    FindClose(hFind);
+    return names;
+}
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+
+std::vector<std::string> GetSubdirsInDir(const std::string& dirname)
+{
+	std::vector<std::string> names;
+	DIR *dir = opendir(dirname.c_str());
+	if (dir == NULL) return names;
+
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL)
+	{
+		std::string name = ent->d_name;
+		struct stat info;
+		if (name != "." && name != ".." &&
+			stat((dirname + "/" + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+		{
+			names.push_back(name);
+		}
+	}
+	closedir(dir);
+	return names;
+}
+#endif
@@ -1,6 +1,7 @@
 #include <string>
 #include <vector>
 extern std::vector<std::string> GetFilenamesInDir(const std::string& dirname, const std::string& filter);
+extern std::vector<std::string> GetSubdirsInDir(const std::string& dirname);
 extern std::string PromptToLoad();
 extern std::string PromptToLoadDir();
 extern std::string PruneName(const std::string& name);
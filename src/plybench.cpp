@@ -0,0 +1,255 @@
+// Bryn Mawr College, alinen, 2020
+//
+
+/**
+ * Benchmark for the ASCII PLY loader.
+ *
+ * Times the buffered, chunked parser of PLYMesh against the line by line
+ * getline/stringstream/stof loader it replaced, on every ASCII model in
+ * models/. Both loaders must produce the same vertices and faces, so the
+ * benchmark also checks the parser, including files with empty elements
+ * and invalid element counts.
+ *
+ * Usage: plybench [--runs N] [root]
+ *   root defaults to "..", the same directory the game loads from
+ *
+ * Author: David Dinh
+ * Date: May 8, 2023
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "plymesh.h"
+#include "osutils.h"
+
+using namespace std;
+using namespace agl;
+
+struct MeshData {
+	vector<GLfloat> positions;
+	vector<GLfloat> normals;
+	vector<GLfloat> texCoords;
+	vector<GLuint> faces;
+};
+
+// Parses an int or float token like the old loader, false if it is not one
+template <typename T, typename F>
+static bool legacyNumber(const string& token, F convert, T* value) {
+	try {
+		*value= convert(token);
+	} catch (std::invalid_argument const&) {
+		return false;
+	} catch (std::out_of_range const&) {
+		return false;
+	}
+	return true;
+}
+
+// The ASCII loader before the buffered parser: one getline, stringstream
+// and stof/stoi per line and token, and vectors grown one value at a time.
+// Only supports the layout of the shipped models (x y z nx ny nz s t and
+// triangles).
+static bool legacyLoad(const string& filename, MeshData* mesh) {
+	ifstream file(filename);
+	if (!file.is_open()) return false;
+
+	auto toInt= [](const string& s) { return std::stoi(s); };
+	auto toFloat= [](const string& s) { return std::stof(s); };
+
+	string line;
+	string token;
+	int numVertices= 0;
+	int numFaces= 0;
+	while (getline(file, line)) {
+		stringstream streamLine(line);
+		getline(streamLine, token, ' ');
+		if (token == "end_header") break;
+		if (token != "element") continue;
+
+		string name;
+		getline(streamLine, name, ' ');
+		getline(streamLine, token, ' ');
+		int count;
+		if (!legacyNumber(token, toInt, &count)) return false;
+		if (name == "vertex") numVertices= count;
+		else if (name == "face") numFaces= count;
+	}
+
+	for (int i= 0; i < numVertices && getline(file, line); i++) {
+		stringstream streamLine(line);
+		int wordIdx= 0;
+		while (getline(streamLine, token, ' ')) {
+			float num;
+			if (!legacyNumber(token, toFloat, &num)) return false;
+			if (wordIdx < 3) {
+				mesh->positions.push_back(num);
+			} else if (wordIdx < 6) {
+				mesh->normals.push_back(num);
+			} else if (wordIdx < 8) {
+				mesh->texCoords.push_back(num);
+			}
+			wordIdx++;
+		}
+	}
+
+	for (int i= 0; i < numFaces && getline(file, line); i++) {
+		stringstream streamLine(line);
+		getline(streamLine, token, ' ');
+		if (token != "3") return false;
+		while (getline(streamLine, token, ' ')) {
+			int vertex;
+			if (!legacyNumber(token, toInt, &vertex)) return false;
+			mesh->faces.push_back(vertex);
+		}
+	}
+	return true;
+}
+
+static bool bufferedLoad(const string& filename, MeshData* mesh) {
+	PLYMesh ply;
+	if (!ply.load(filename)) return false;
+	mesh->positions= ply.positions();
+	mesh->normals= ply.normals();
+	mesh->texCoords= ply.texCoords();
+	mesh->faces= ply.indices();
+	return true;
+}
+
+static bool sameValues(const vector<GLfloat>& a, const vector<GLfloat>& b) {
+	if (a.size() != b.size()) return false;
+	for (size_t i= 0; i < a.size(); i++) {
+		if (std::abs(a[i] - b[i]) > 1e-6f * std::max(1.0f, std::abs(a[i]))) return false;
+	}
+	return true;
+}
+
+static bool sameMesh(const MeshData& a, const MeshData& b) {
+	return sameValues(a.positions, b.positions) && sameValues(a.normals, b.normals) &&
+		sameValues(a.texCoords, b.texCoords) && a.faces == b.faces;
+}
+
+// Returns the fastest of runs loads, in milliseconds
+template <typename F>
+static double bestTime(int runs, F load) {
+	double best= 1e30;
+	for (int i= 0; i < runs; i++) {
+		auto start= std::chrono::steady_clock::now();
+		load();
+		std::chrono::duration<double, std::milli> ms=
+			std::chrono::steady_clock::now() - start;
+		best= std::min(best, ms.count());
+	}
+	return best;
+}
+
+static bool isAscii(const string& filename) {
+	ifstream file(filename);
+	string line;
+	getline(file, line);
+	getline(file, line);
+	return line.compare(0, 12, "format ascii") == 0;
+}
+
+static size_t fileSize(const string& filename) {
+	ifstream file(filename, ios::binary | ios::ate);
+	return file.is_open() ? (size_t) file.tellg() : 0;
+}
+
+// Files with empty elements are valid and must load without vertices or
+// faces, files with negative element counts must fail, and neither may crash
+static bool checkElementCounts() {
+	struct Case {
+		const char* name;
+		const char* text;
+		bool loads;
+		size_t numVertices;
+	};
+	const char* header= "ply\nformat ascii 1.0\n";
+	const char* vertexProperties= "property float x\nproperty float y\nproperty float z\n";
+	const char* faceProperties= "property list uchar int vertex_indices\n";
+	Case cases[]= {
+		{ "no faces", "element vertex 3\n%selement face 0\n%send_header\n"
+			"0 0 0\n1 0 0\n0 1 0\n", true, 3 },
+		{ "no vertices", "element vertex 0\n%selement face 0\n%send_header\n", true, 0 },
+		{ "negative vertices", "element vertex -3\n%selement face 0\n%send_header\n",
+			false, 0 },
+		{ "negative faces", "element vertex 0\n%selement face -1\n%send_header\n",
+			false, 0 },
+	};
+
+	bool ok= true;
+	string path= "plybench-empty.ply";
+	for (const Case& c : cases) {
+		char body[512];
+		std::snprintf(body, sizeof(body), c.text, vertexProperties, faceProperties);
+		{
+			ofstream out(path, ios::binary);
+			out << header << body;
+		}
+
+		PLYMesh ply;
+		bool loaded= ply.load(path);
+		bool passed= loaded == c.loads && (!loaded ||
+			(ply.positions().size() == c.numVertices * 3 && ply.indices().empty()));
+		cout << (passed ? "ok       " : "FAILED   ") << "ascii ply with " << c.name << endl;
+		ok= ok && passed;
+	}
+	std::remove(path.c_str());
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	int runs= 5;
+	string root= "..";
+	for (int i= 1; i < argc; i++) {
+		string arg= argv[i];
+		if (arg == "--runs" && i + 1 < argc) {
+			runs= std::max(1, std::atoi(argv[++i]));
+		} else if (!arg.empty() && arg[0] == '-') {
+			cout << "Usage: plybench [--runs N] [root]" << endl;
+			return 1;
+		} else {
+			root= arg;
+		}
+	}
+
+	bool ok= checkElementCounts();
+
+	string dir= root + "/models";
+	cout << "best of " << runs << " runs" << endl;
+	printf("%-24s %10s %12s %12s %8s\n", "model", "KB", "legacy ms", "buffered ms", "speedup");
+	for (const string& name : GetFilenamesInDir(dir, ".ply")) {
+		string path= dir + "/" + name;
+		if (!isAscii(path)) continue;
+
+		MeshData legacy;
+		MeshData buffered;
+		if (!legacyLoad(path, &legacy) || !bufferedLoad(path, &buffered) ||
+			!sameMesh(legacy, buffered)) {
+			cout << "FAILED   " << path << ": the loaders do not agree" << endl;
+			ok= false;
+			continue;
+		}
+
+		double legacyMs= bestTime(runs, [&]() {
+			MeshData mesh;
+			legacyLoad(path, &mesh);
+		});
+		double bufferedMs= bestTime(runs, [&]() {
+			PLYMesh ply;
+			ply.load(path);
+		});
+		printf("%-24s %10.1f %12.2f %12.2f %7.1fx\n", name.c_str(),
+			fileSize(path) / 1024.0, legacyMs, bufferedMs, legacyMs / bufferedMs);
+	}
+	return ok ? 0 : 1;
+}
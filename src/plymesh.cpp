@@ -1,13 +1,18 @@
 //--------------------------------------------------
 // Author: David Dinh
 // Date: March 2. 2023
-// Description: Loads PLY files in ASCII format
+// Description: Loads PLY files in ASCII and binary format
 //--------------------------------------------------
 
 #include "plymesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <thread>
 
 using namespace std;
 using namespace glm;
@@ -34,253 +39,659 @@ namespace agl {
   }
 
 
-  // Will return true if a warning occurs... where the condition
-  // wordIdx == correctIdx and token != correctString
-  // This will also print the warningMsg if the condition is true
-  bool warning(int wordIdx, int correctIdx, const string& token, 
-  const string& correctString, const string& warningMsg) {
-    if (wordIdx == correctIdx && token != correctString) {
-      std::cout << warningMsg << std::endl;
-      return true;
-    }
-    return false;
-  }
-
   void PLYMesh::clear() {
     this->_positions.clear();
     this->_normals.clear();
     this->_faces.clear();
 		this->_texCoords.clear();
+    this->_bounds= Bounds();
   }
 
   bool PLYMesh::load(const std::string& filename) {
-    if (_positions.size() != 0) {
+    if (_positions.size() != 0 || _initialized) {
       std::cout << "WARNING: Cannot load different files with the same PLY mesh\n";
       return false;
     }
 
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) {
+      std::cout << "WARNING: cannot open " << filename << std::endl;
+      return false;
+    }
+
+    // the first two lines tell us how the rest of the file is stored
     string line;
+    getline(file, line);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line != "ply") {
+      std::cout << "WARNING: not a ply file" << std::endl;
+      return false;
+    }
+
     string token;
-    ifstream file(filename);
-
-    
-    enum Section{PLY, FORMAT, VERTEX_NUM, VERTEX_PROP, FACE_NUM, FACE_PROP, 
-      END_HEADER, VERTICES, FACES, END};
-
-    // determines which part of the file we're at
-    Section curSection= PLY;
-
-
-    int wordIdx= 0; // indexes words on each line
-    int numVertices= 0;
-    int numFaces= 0;
-    int numVertexComponents= 0; // counts the number of components a vertex line has
-
-
-    if (file.is_open()) {
-      while (getline(file, line)) {
-        // tokenize the line
-        stringstream streamLine(line);
-        if (getline(streamLine, token, ' ')) {
-
-          // if line starts with comment, we continue onto the next
-          if (token == "comment") continue;
-
-          if (curSection == PLY) { // check if the line is ply
-            if (warning(wordIdx, 0, token, "ply", "WARNING: not a ply file"))
-              return false;
-            curSection= FORMAT;
-          } else if (curSection == FORMAT) {
-            // we skip this formatting line
-            curSection= VERTEX_NUM;
-          } else if (curSection == VERTEX_NUM && token == "element") { // # of vertices
-            while (getline(streamLine, token, ' ')) {
-              wordIdx++;
-              if (warning(wordIdx, 1, token, "vertex", "WARNING: invalid vertex number")) {
-                return false;
-              } else if (wordIdx == 2) { // the actual number
-                try {
-                  numVertices= std::stoi(token);
-                } catch (std::invalid_argument const& ex) {
-                  std::cout << "WARNING: cannot get a vertex for the face" << std::endl;
-                  return false;
-                } catch (std::out_of_range const& ex) {
-                  std::cout << "WARNING: cannot get a vertex for the face" << std::endl;
-                  return false;
-                }
-                curSection= VERTEX_PROP;
-                break;
-              }
-            }
-          } else if (curSection == VERTEX_PROP && token == "property") { // verifying vertex / normal properties
-
-            while (getline(streamLine, token, ' ')) {
-              wordIdx++;
-              if (warning(wordIdx, 1, token, "float",  "WARNING: invalid vertex type"))
-                return false;
-              else if (wordIdx == 2) {
-                numVertexComponents++;
-              }
-            }
-
-          } else if (curSection == VERTEX_PROP && token == "element") { // this is essentially the FACE_NUM section now 
-            curSection= FACE_NUM;
-
-            while (getline(streamLine, token, ' ')) {
-              wordIdx++;
-              if (warning(wordIdx, 1, token, "face", "WARNING: invalid face line")) 
-                return false;
-
-              if (wordIdx == 2) { // the actual number
-                try {
-                  numFaces= std::stoi(token);
-                } catch (std::invalid_argument const& ex) {
-                  std::cout << "WARNING: cannot get a vertex for the face" << std::endl;
-                  return false;
-                } catch (std::out_of_range const& ex) {
-                  std::cout << "WARNING: cannot get a vertex for the face" << std::endl;
-                  return false;
-                }
-                curSection= FACE_PROP;
-                break;
-              }
-            }
-
-          } else if (curSection == FACE_PROP && token == "property") {
-            // skip this section, because face vertices should be unsigned int anyway
-            curSection= END_HEADER;
-          } else if (curSection == END_HEADER) { // ends header
-            if (warning(wordIdx, 0, token, "end_header", "WARNING: no header end"))
-              return false;
-            curSection= VERTICES;
-          } else if (curSection == VERTICES && numVertices != 0) { // vertices
-            if (--numVertices == 0) { // if none left, we go onto faces after processing
-              curSection= FACES;
-            }
-
-            // manually handling the first vertex component 
-            try {
-              this->_positions.push_back(std::stof(token));
-            } catch (std::invalid_argument const& ex) {
-              std::cout << "WARNING: vertex component is not a number" << std::endl;
-              return false;
-            } catch (std::out_of_range const& ex) {
-              std::cout << "WARNING: vertex component is not a number" << std::endl;
-              return false;
-            }
-
-            while (getline(streamLine, token, ' ')) {
-              wordIdx++;
-              try {
-                float num= std::stof(token);
-
-                // this will x, y, z
-                if (wordIdx < 3) {
-                  this->_positions.push_back(num);
-                } else if (wordIdx >= 3 && wordIdx < 6) { // nx, ny, nz
-                  this->_normals.push_back(num);
-                } else if (wordIdx >= 6 && wordIdx < 8) { // s and t, but not sure where to put them
-                  this->_texCoords.push_back(num);
-                }
-
-              } catch (std::invalid_argument const& ex) {
-                std::cout << "WARNING: vertex component is not a number" << std::endl;
-                return false;
-              } catch (std::out_of_range const& ex) {
-                std::cout << "WARNING: vertex component is not a number" << std::endl;
-                return false;
-              }
-            }
-            
-
-          } else if (curSection == FACES && numFaces != 0) {
-            if (--numFaces == 0) {
-              curSection= END;
-            }
-            // assures that the polygon starts as a triangle
-            if (warning(wordIdx, 0, token, "3", "WARNING: this face does not contain 3 vertices"))
-              return false;
-            while (getline(streamLine, token, ' ')) { // get the vertices for the face
-              wordIdx++;
-              int vertex;
-              try {
-                vertex= std::stoi(token);
-              } catch (std::invalid_argument const& ex) {
-                std::cout << "WARNING: cannot get a vertex for the face" << std::endl;
-                return false;
-              } catch (std::out_of_range const& ex) {
-                std::cout << "WARNING: cannot get a vertex for the face" << std::endl;
-                return false;
-              }
-              this->_faces.push_back(vertex);
-            }
-            
-          } else {
-            cout << "WARNING: something went wrong with loading PLY file" << std::endl;
-            return false;
-          }
+    string format;
+    getline(file, line);
+    stringstream formatLine(line);
+    formatLine >> token >> format;
+
+    bool loaded= false;
+    if (token == "format" && format == "ascii") {
+      loaded= loadAscii(file);
+    } else if (token == "format" && format == "binary_little_endian") {
+      loaded= loadBinary(file, false);
+    } else if (token == "format" && format == "binary_big_endian") {
+      loaded= loadBinary(file, true);
+    } else {
+      std::cout << "WARNING: unknown ply format " << format << std::endl;
+    }
 
-          wordIdx++;
+    // bounds are computed once here rather than on every query
+    if (loaded) _bounds= Bounds::compute(_positions.data(), _positions.size() / 3);
+    return loaded;
+  }
+  // PLY header ----------------------------------------------------
+
+
+  enum PlyType { PLY_CHAR, PLY_UCHAR, PLY_SHORT, PLY_USHORT, PLY_INT, PLY_UINT, 
+    PLY_FLOAT, PLY_DOUBLE, PLY_INVALID };
+
+  // a property is either a scalar or a list (a count followed by count values)
+  struct PlyProperty {
+    string name;
+    PlyType type;
+    bool isList;
+    PlyType countType;
+  };
+
+  struct PlyElement {
+    string name;
+    int count;
+    vector<PlyProperty> properties;
+  };
+
+  static PlyType plyType(const string& name) {
+    if (name == "char" || name == "int8") return PLY_CHAR;
+    if (name == "uchar" || name == "uint8") return PLY_UCHAR;
+    if (name == "short" || name == "int16") return PLY_SHORT;
+    if (name == "ushort" || name == "uint16") return PLY_USHORT;
+    if (name == "int" || name == "int32") return PLY_INT;
+    if (name == "uint" || name == "uint32") return PLY_UINT;
+    if (name == "float" || name == "float32") return PLY_FLOAT;
+    if (name == "double" || name == "float64") return PLY_DOUBLE;
+    return PLY_INVALID;
+  }
+
+  static int plySize(PlyType type) {
+    switch (type) {
+      case PLY_CHAR: case PLY_UCHAR: return 1;
+      case PLY_SHORT: case PLY_USHORT: return 2;
+      case PLY_INT: case PLY_UINT: case PLY_FLOAT: return 4;
+      case PLY_DOUBLE: return 8;
+      default: return 0;
+    }
+  }
+
+  // Parses the header after the format line, stops after end_header
+  static bool readHeader(istream& file, vector<PlyElement>* elements) {
+    string line;
+    while (getline(file, line)) {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+
+      stringstream streamLine(line);
+      string token;
+      streamLine >> token;
+
+      if (token == "comment" || token == "obj_info" || token.empty()) {
+        continue;
+      } else if (token == "end_header") {
+        return true;
+      } else if (token == "element") {
+        PlyElement element;
+        if (!(streamLine >> element.name >> element.count) || element.count < 0) {
+          std::cout << "WARNING: invalid element line" << std::endl;
+          return false;
         }
+        elements->push_back(element);
+      } else if (token == "property" && !elements->empty()) {
+        PlyProperty property;
+        string type;
+        streamLine >> type;
+        property.isList= (type == "list");
+        property.countType= PLY_INVALID;
+        if (property.isList) {
+          string countType;
+          streamLine >> countType >> type;
+          property.countType= plyType(countType);
+        }
+        property.type= plyType(type);
+        streamLine >> property.name;
 
-        wordIdx= 0; // reset the wordIndex
+        if (property.type == PLY_INVALID || 
+            (property.isList && property.countType == PLY_INVALID)) {
+          std::cout << "WARNING: invalid property type in line: " << line << std::endl;
+          return false;
+        }
+        elements->back().properties.push_back(property);
+      } else {
+        std::cout << "WARNING: invalid header line: " << line << std::endl;
+        return false;
       }
-      file.close();
     }
 
+    std::cout << "WARNING: no header end" << std::endl;
+    return false;
+  }
+
+  // Reads the rest of the file (the body) in one block
+  static bool readBody(istream& file, vector<char>* body) {
+    std::streampos bodyStart= file.tellg();
+    file.seekg(0, ios::end);
+    std::streamoff bodySize= file.tellg() - bodyStart;
+    file.seekg(bodyStart);
+    body->resize(bodySize > 0 ? (size_t) bodySize : 0);
+    file.read(body->data(), body->size());
+    if (file.gcount() != (std::streamsize) body->size()) {
+      std::cout << "WARNING: could not read ply body" << std::endl;
+      return false;
+    }
     return true;
   }
 
-  glm::vec3 PLYMesh::minBounds() const {
-    GLfloat minX= FLT_MAX;
-    GLfloat minY= FLT_MAX;
-    GLfloat minZ= FLT_MAX;
-    int n= this->_positions.size();
-    vector<GLfloat> verts= this->positions();
-    for (int i= 0; i < n; i+= 3) { 
-      if (verts[i] < minX) {
-        minX= verts[i];
+  // where a vertex property goes, e.g. (positions, 1) for y
+  struct VertexTarget {
+    vector<GLfloat>* dest;
+    int component;
+    int numComponents;
+  };
+
+  // Returns one target per vertex property (dest is null for properties we
+  // do not use) and sizes each destination once, missing components stay 0
+  static vector<VertexTarget> vertexTargets(const PlyElement& element, 
+    vector<GLfloat>* positions, vector<GLfloat>* normals, vector<GLfloat>* texCoords) {
+    vector<VertexTarget> targets;
+    for (const PlyProperty& property : element.properties) {
+      const string& n= property.name;
+      VertexTarget target= {nullptr, 0, 0};
+      if (n == "x" || n == "y" || n == "z") {
+        target= {positions, n[0] - 'x', 3};
+      } else if (n == "nx" || n == "ny" || n == "nz") {
+        target= {normals, n[1] - 'x', 3};
+      } else if (n == "s" || n == "u" || n == "texture_u") {
+        target= {texCoords, 0, 2};
+      } else if (n == "t" || n == "v" || n == "texture_v") {
+        target= {texCoords, 1, 2};
       }
+      if (property.isList) target.dest= nullptr;
+      targets.push_back(target);
+    }
 
-      if (verts[i+1] < minY) {
-        minY= verts[i+1];
+    for (const VertexTarget& target : targets) {
+      if (target.dest && target.dest->empty()) {
+        target.dest->resize((size_t) element.count * target.numComponents, 0.0f);
       }
+    }
+    return targets;
+  }
+
+  static bool isFaceIndices(const PlyProperty& property) {
+    return property.isList && 
+      (property.name == "vertex_indices" || property.name == "vertex_index");
+  }
+
+  // Splits a polygon into a triangle fan
+  static void addPolygon(const GLuint* indices, int count, vector<GLuint>* faces) {
+    for (int k= 1; k + 1 < count; k++) {
+      faces->push_back(indices[0]);
+      faces->push_back(indices[k]);
+      faces->push_back(indices[k+1]);
+    }
+  }
 
-      if (verts[i+2] < minZ) {
-        minZ= verts[i+2];
+  // ASCII PLY -----------------------------------------------------
+
+  // bodies are split into chunks of at least this size for parsing in parallel
+  static const size_t MIN_CHUNK_SIZE= 256 * 1024;
+
+  static inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+  }
+
+  static inline const char* nextLine(const char* p, const char* end) {
+    const char* newline= (const char*) memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+  }
+
+  // Parses an integer, returns nullptr if there is no number at p
+  static const char* parseInt(const char* p, const char* end, long long* out) {
+    p= skipSpaces(p, end);
+    bool negative= false;
+    if (p < end && (*p == '-' || *p == '+')) negative= (*p++ == '-');
+
+    const char* start= p;
+    long long value= 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      value= value * 10 + (*p - '0');
+    }
+    if (p == start) return nullptr;
+
+    *out= negative ? -value : value;
+    return p;
+  }
+
+  // Parses a float without going through the C locale (unlike stof),
+  // returns nullptr if there is no number at p
+  static const char* parseFloat(const char* p, const char* end, float* out) {
+    static const double powers[]= {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p= skipSpaces(p, end);
+    bool negative= false;
+    if (p < end && (*p == '-' || *p == '+')) negative= (*p++ == '-');
+
+    // keep up to 18 significant digits, which is plenty for a float
+    const uint64_t maxMantissa= 100000000000000000ULL;
+    uint64_t mantissa= 0;
+    int exponent= 0;
+    bool hasDigits= false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      hasDigits= true;
+      if (mantissa < maxMantissa) {
+        mantissa= mantissa * 10 + (*p - '0');
+      } else {
+        exponent++;
       }
     }
-    return glm::vec3(minX, minY, minZ);
+    if (p < end && *p == '.') {
+      for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+        hasDigits= true;
+        if (mantissa < maxMantissa) {
+          mantissa= mantissa * 10 + (*p - '0');
+          exponent--;
+        }
+      }
+    }
+    if (!hasDigits) return nullptr;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      long long e;
+      const char* q= parseInt(p + 1, end, &e);
+      if (q) {
+        exponent+= (int) std::max(-400LL, std::min(e, 400LL));
+        p= q;
+      }
+    }
+
+    double value= (double) mantissa;
+    if (exponent < 0) {
+      value= (-exponent <= 22) ? value / powers[-exponent] : value * pow(10.0, exponent);
+    } else if (exponent > 0) {
+      value= (exponent <= 22) ? value * powers[exponent] : value * pow(10.0, exponent);
+    }
+    *out= (float) (negative ? -value : value);
+    return p;
   }
 
-  glm::vec3 PLYMesh::maxBounds() const {
-    GLfloat maxX= FLT_MIN;
-    GLfloat maxY= FLT_MIN;
-    GLfloat maxZ= FLT_MIN;
-    int n= this->_positions.size();
-    vector<GLfloat> verts= this->positions();
-    for (int i= 0; i < n; i+= 3) { 
-      if (verts[i] > maxX) {
-        maxX= verts[i];
+  // Finds the start of the lines that begin each chunk of the next numLines
+  // lines. starts gets one entry per chunk, then the end of the last line.
+  static bool splitLines(const char* p, const char* end, int numLines, 
+    int numChunks, vector<const char*>* starts) {
+    int linesPerChunk= (numLines + numChunks - 1) / numChunks;
+    starts->clear();
+    for (int i= 0; i < numLines; i++) {
+      if (p >= end) return false;
+      if (i % linesPerChunk == 0) starts->push_back(p);
+      p= nextLine(p, end);
+    }
+    starts->push_back(p);
+    return true;
+  }
+
+  // Picks how many threads to use for an element, small files use one
+  static int numChunks(size_t bytes, int numLines) {
+    int threads= std::max(1, (int) std::thread::hardware_concurrency());
+    int chunks= (int) std::min<size_t>(threads, bytes / MIN_CHUNK_SIZE + 1);
+    return std::max(1, std::min(chunks, numLines));
+  }
+
+  // Runs parse(chunk) for every chunk, the first one on the calling thread
+  template <typename F>
+  static bool parseChunks(int numChunks, F parse) {
+    vector<char> ok(numChunks, 0);
+    vector<std::thread> workers;
+    for (int c= 1; c < numChunks; c++) {
+      workers.push_back(std::thread([&ok, &parse, c]() { ok[c]= parse(c); }));
+    }
+    ok[0]= parse(0);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+    return std::find(ok.begin(), ok.end(), 0) == ok.end();
+  }
+
+  // Parses one vertex line, returns false if a value is missing
+  static bool parseVertexLine(const char* p, const char* end, const PlyElement& element, 
+    const vector<VertexTarget>& targets, size_t vertex) {
+    float value;
+    for (int j= 0; j < targets.size(); j++) {
+      const PlyProperty& property= element.properties[j];
+      if (property.isList) {
+        long long count;
+        if (!(p= parseInt(p, end, &count))) return false;
+        for (long long k= 0; k < count; k++) {
+          if (!(p= parseFloat(p, end, &value))) return false;
+        }
+      } else {
+        if (!(p= parseFloat(p, end, &value))) return false;
+        const VertexTarget& target= targets[j];
+        if (target.dest) {
+          (*target.dest)[vertex * target.numComponents + target.component]= value;
+        }
       }
+    }
+    return true;
+  }
 
-      if (verts[i+1] > maxY) {
-        maxY= verts[i+1];
+  // Parses one face line and appends its triangles
+  static bool parseFaceLine(const char* p, const char* end, const PlyElement& element, 
+    vector<GLuint>* polygon, vector<GLuint>* faces) {
+    for (const PlyProperty& property : element.properties) {
+      long long value;
+      if (!property.isList) {
+        float skip;
+        if (!(p= parseFloat(p, end, &skip))) return false;
+        continue;
       }
 
-      if (verts[i+2] > maxZ) {
-        maxZ= verts[i+2];
+      long long count;
+      if (!(p= parseInt(p, end, &count)) || count < 0) return false;
+      polygon->clear();
+      for (long long k= 0; k < count; k++) {
+        if (!(p= parseInt(p, end, &value))) return false;
+        polygon->push_back((GLuint) value);
+      }
+      if (isFaceIndices(property)) {
+        addPolygon(polygon->data(), (int) polygon->size(), faces);
       }
     }
-    return glm::vec3(maxX, maxY, maxZ);
+    return true;
+  }
+
+  bool PLYMesh::loadAscii(std::istream& file) {
+    vector<PlyElement> elements;
+    vector<char> body;
+    if (!readHeader(file, &elements) || !readBody(file, &body)) {
+      return false;
+    }
+
+    const char* p= body.data();
+    const char* end= p + body.size();
+    vector<const char*> starts;
+
+    for (const PlyElement& element : elements) {
+      if (element.count == 0) continue;  // valid, e.g. a point cloud with no faces
+
+      int chunks= numChunks(end - p, element.count);
+      if (!splitLines(p, end, element.count, chunks, &starts)) {
+        std::cout << "WARNING: ply " << element.name << " data is truncated" << std::endl;
+        clear();
+        return false;
+      }
+      chunks= (int) starts.size() - 1;
+      int linesPerChunk= (element.count + chunks - 1) / std::max(chunks, 1);
+
+      bool ok= true;
+      if (element.name == "vertex") {
+        // every chunk writes its own range of the pre-sized vectors
+        vector<VertexTarget> targets= vertexTargets(element, 
+          &_positions, &_normals, &_texCoords);
+        ok= parseChunks(chunks, [&](int c) {
+          size_t vertex= (size_t) c * linesPerChunk;
+          for (const char* line= starts[c]; line < starts[c+1]; vertex++) {
+            const char* lineEnd= nextLine(line, starts[c+1]);
+            if (!parseVertexLine(line, lineEnd, element, targets, vertex)) return false;
+            line= lineEnd;
+          }
+          return true;
+        });
+      } else if (element.name == "face") {
+        // every chunk fills its own list, which are joined in order
+        vector<vector<GLuint>> chunkFaces(chunks);
+        ok= parseChunks(chunks, [&](int c) {
+          vector<GLuint> polygon;
+          chunkFaces[c].reserve((size_t) linesPerChunk * 3);
+          for (const char* line= starts[c]; line < starts[c+1];) {
+            const char* lineEnd= nextLine(line, starts[c+1]);
+            if (!parseFaceLine(line, lineEnd, element, &polygon, &chunkFaces[c])) return false;
+            line= lineEnd;
+          }
+          return true;
+        });
+
+        size_t numIndices= 0;
+        for (const vector<GLuint>& faces : chunkFaces) numIndices+= faces.size();
+        this->_faces.reserve(numIndices);
+        for (const vector<GLuint>& faces : chunkFaces) {
+          this->_faces.insert(this->_faces.end(), faces.begin(), faces.end());
+        }
+      }
+
+      if (!ok) {
+        std::cout << "WARNING: ply " << element.name << " line is not a number list" << std::endl;
+        clear();
+        return false;
+      }
+      p= starts.back();
+    }
+
+    return true;
+  }
+
+  // Binary PLY ---------------------------------------------------
+
+  static bool hostIsBigEndian() {
+    uint16_t one= 1;
+    unsigned char first;
+    memcpy(&first, &one, 1);
+    return first == 0;
+  }
+
+  // Reads one value of the given type, swapping the bytes if the file
+  // endianness differs from the host
+  template <typename T>
+  static T readRaw(const char* p, bool swap) {
+    char bytes[sizeof(T)];
+    memcpy(bytes, p, sizeof(T));
+    if (swap) std::reverse(bytes, bytes + sizeof(T));
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+  }
+
+  static double readValue(const char* p, PlyType type, bool swap) {
+    switch (type) {
+      case PLY_CHAR: return readRaw<int8_t>(p, swap);
+      case PLY_UCHAR: return readRaw<uint8_t>(p, swap);
+      case PLY_SHORT: return readRaw<int16_t>(p, swap);
+      case PLY_USHORT: return readRaw<uint16_t>(p, swap);
+      case PLY_INT: return readRaw<int32_t>(p, swap);
+      case PLY_UINT: return readRaw<uint32_t>(p, swap);
+      case PLY_FLOAT: return readRaw<float>(p, swap);
+      case PLY_DOUBLE: return readRaw<double>(p, swap);
+      default: return 0.0;
+    }
+  }
+
+  // Returns the number of bytes used by the property at p, or -1 if the
+  // property runs past the end of the data
+  static int propertySize(const PlyProperty& property, const char* p, 
+    const char* end, bool swap) {
+    if (!property.isList) {
+      return p + plySize(property.type) <= end ? plySize(property.type) : -1;
+    }
+
+    int countSize= plySize(property.countType);
+    if (p + countSize > end) return -1;
+    int count= (int) readValue(p, property.countType, swap);
+    int size= countSize + count * plySize(property.type);
+    return (count >= 0 && p + size <= end) ? size : -1;
+  }
+
+  static bool skipElement(const PlyElement& element, const char** p, 
+    const char* end, bool swap) {
+    for (int i= 0; i < element.count; i++) {
+      for (const PlyProperty& property : element.properties) {
+        int size= propertySize(property, *p, end, swap);
+        if (size < 0) return false;
+        *p+= size;
+      }
+    }
+    return true;
+  }
+
+  bool PLYMesh::loadBinary(std::istream& file, bool bigEndian) {
+    vector<PlyElement> elements;
+    vector<char> body;
+    if (!readHeader(file, &elements) || !readBody(file, &body)) {
+      return false;
+    }
+
+    bool swap= (bigEndian != hostIsBigEndian());
+    const char* p= body.data();
+    const char* end= p + body.size();
+
+    for (const PlyElement& element : elements) {
+      bool ok;
+      if (element.name == "vertex") {
+        ok= readVertices(element, &p, end, swap);
+      } else if (element.name == "face") {
+        ok= readFaces(element, &p, end, swap);
+      } else {
+        ok= skipElement(element, &p, end, swap);
+      }
+
+      if (!ok) {
+        std::cout << "WARNING: ply " << element.name << " data is truncated or invalid" << std::endl;
+        clear();
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool PLYMesh::readVertices(const PlyElement& element, const char** p, 
+    const char* end, bool swap) {
+    vector<VertexTarget> targets= vertexTargets(element, 
+      &_positions, &_normals, &_texCoords);
+
+    int stride= 0;
+    bool fixedStride= true;
+    bool directCopy= !swap;
+    for (int j= 0; j < targets.size(); j++) {
+      const PlyProperty& property= element.properties[j];
+      if (targets[j].dest && (property.isList || property.type != PLY_FLOAT)) {
+        directCopy= false;
+      }
+      if (property.isList) fixedStride= false;
+      stride+= plySize(property.type);
+    }
+
+    if (fixedStride) {
+      if (*p + (size_t) element.count * stride > end) return false;
+
+      // precompute the byte offset of each property inside a vertex
+      vector<int> offsets;
+      int offset= 0;
+      for (const PlyProperty& property : element.properties) {
+        offsets.push_back(offset);
+        offset+= plySize(property.type);
+      }
+
+      for (int i= 0; i < element.count; i++) {
+        const char* row= *p + (size_t) i * stride;
+        for (int j= 0; j < targets.size(); j++) {
+          const VertexTarget& target= targets[j];
+          if (!target.dest) continue;
+          GLfloat* dst= &(*target.dest)[i * target.numComponents + target.component];
+          if (directCopy) {
+            memcpy(dst, row + offsets[j], sizeof(GLfloat));
+          } else {
+            *dst= (GLfloat) readValue(row + offsets[j], element.properties[j].type, swap);
+          }
+        }
+      }
+      *p+= (size_t) element.count * stride;
+      return true;
+    }
+
+    // vertices with list properties have a variable size
+    for (int i= 0; i < element.count; i++) {
+      for (int j= 0; j < targets.size(); j++) {
+        const PlyProperty& property= element.properties[j];
+        int size= propertySize(property, *p, end, swap);
+        if (size < 0) return false;
+        const VertexTarget& target= targets[j];
+        if (target.dest && !property.isList) {
+          (*target.dest)[i * target.numComponents + target.component]= 
+            (GLfloat) readValue(*p, property.type, swap);
+        }
+        *p+= size;
+      }
+    }
+    return true;
+  }
+
+  bool PLYMesh::readFaces(const PlyElement& element, const char** p, 
+    const char* end, bool swap) {
+    this->_faces.reserve(element.count * 3);
+
+    for (int i= 0; i < element.count; i++) {
+      for (const PlyProperty& property : element.properties) {
+        int size= propertySize(property, *p, end, swap);
+        if (size < 0) return false;
+
+        if (isFaceIndices(property)) {
+          int count= (int) readValue(*p, property.countType, swap);
+          int valueSize= plySize(property.type);
+          const char* values= *p + plySize(property.countType);
+
+          // polygons are split into a triangle fan
+          GLuint first= (GLuint) readValue(values, property.type, swap);
+          for (int k= 1; k + 1 < count; k++) {
+            this->_faces.push_back(first);
+            this->_faces.push_back((GLuint) readValue(values + k * valueSize, property.type, swap));
+            this->_faces.push_back((GLuint) readValue(values + (k+1) * valueSize, property.type, swap));
+          }
+        }
+        *p+= size;
+      }
+    }
+    return true;
   }
 
   int PLYMesh::numVertices() const {
-    return _positions.size() / 3;
+    return _initialized ? (int) _nVerts : (int) _positions.size() / 3;
   }
 
   int PLYMesh::numTriangles() const {
-    return _faces.size() / 3;
+    return _initialized ? (int) _nIndices / 3 : (int) _faces.size() / 3;
+  }
+
+  void PLYMesh::releaseCpuData() {
+    if (_residency == KEEP_CPU_DATA) return;
+    vector<GLfloat>().swap(_normals);
+    vector<GLfloat>().swap(_texCoords);
+    vector<GLuint>().swap(_faces);
+    if (_residency == RELEASE_CPU_DATA) vector<GLfloat>().swap(_positions);
+  }
+
+  size_t PLYMesh::cpuBytes() const {
+    return Mesh::cpuBytes() +
+      (_positions.capacity() + _normals.capacity() + _texCoords.capacity()) * sizeof(GLfloat) +
+      _faces.capacity() * sizeof(GLuint);
   }
 
   const std::vector<GLfloat>& PLYMesh::positions() const {
@@ -1,16 +1,20 @@
 //--------------------------------------------------
 // Author: David Dinh
 // Date: March 2 2023
-// Description: Loads PLY files in ASCII format
+// Description: Loads PLY files in ASCII and binary format
 //--------------------------------------------------
 
 #ifndef plymeshmodel_H_
 #define plymeshmodel_H_
 
+#include <istream>
+#include <string>
 #include "agl/aglm.h"
 #include "agl/mesh/triangle_mesh.h"
 
 namespace agl {
+   struct PlyElement;
+
    class PLYMesh : public TriangleMesh
    {
    public:
@@ -25,10 +29,10 @@ namespace agl {
       bool load(const std::string& filename);
 
       // Return the minimum point of the axis-aligned bounding box
-      glm::vec3 minBounds() const;
+      glm::vec3 minBounds() const { return _bounds.min; }
 
       // Return the maximum point of the axis-aligned bounding box
-      glm::vec3 maxBounds() const;
+      glm::vec3 maxBounds() const { return _bounds.max; }
 
       // Return number of vertices in this model
       int numVertices() const;
@@ -48,13 +52,31 @@ namespace agl {
       // face indices in this model
       const std::vector<GLuint>& indices() const;
 
+      // Bytes of vertex data held in main memory
+      virtual size_t cpuBytes() const;
+
    private:
       // Clears the vectors to get ready for the next load
       void clear();
 
+      // Loads the rest of a file in the given format
+      bool loadAscii(std::istream& file);
+      bool loadBinary(std::istream& file, bool bigEndian);
+
+      // Reads the vertex and face elements of a binary file, p is advanced
+      // past the element
+      bool readVertices(const PlyElement& element, const char** p,
+         const char* end, bool swap);
+      bool readFaces(const PlyElement& element, const char** p,
+         const char* end, bool swap);
+
    protected:
       void init();
 
+      // Frees the vectors the residency policy does not keep, afterwards
+      // the counts still come from the uploaded mesh
+      virtual void releaseCpuData();
+
 
    protected:
 
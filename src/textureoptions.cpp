@@ -0,0 +1,28 @@
+//--------------------------------------------------
+// Author: David Dinh
+// Date: May 9 2023
+// Description: How the game loads each of its images
+//--------------------------------------------------
+
+#include "textureoptions.h"
+
+using namespace std;
+
+struct TextureRule {
+	const char* pattern; // matches paths that contain it
+	TextureOptions options;
+};
+
+// Images that are not loaded with the default options
+static const TextureRule RULES[]= {
+	// the pages are text, which block compression blurs
+	{ "/textures/pages/", { true, false } },
+	{ "/textures/dead_grass.png", { false, true } },
+};
+
+TextureOptions textureOptions(const string& path) {
+	for (const TextureRule& rule : RULES) {
+		if (path.find(rule.pattern) != string::npos) return rule.options;
+	}
+	return TextureOptions();
+}
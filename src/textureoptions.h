@@ -0,0 +1,22 @@
+//--------------------------------------------------
+// Author: David Dinh
+// Date: May 9 2023
+// Description: How the game loads each of its images
+//--------------------------------------------------
+
+#ifndef textureoptions_H_
+#define textureoptions_H_
+
+#include <string>
+
+// The game and assetcook both look images up here, so the texture caches
+// that assetcook cooks are the ones the game loads
+struct TextureOptions {
+	bool flip= true; // flipped vertically when decoded
+	bool compress= true; // block compressed, see CachedTexture
+};
+
+// Returns the options for the image at path, e.g. "../textures/grass.png"
+TextureOptions textureOptions(const std::string& path);
+
+#endif